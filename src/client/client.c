@@ -1,4 +1,5 @@
-#define _POSIX_C_SOURCE 200809L
+#define _GNU_SOURCE // memmem
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,7 +9,27 @@
 #include <arpa/inet.h>
 #include <signal.h>
 
+#include "common/protocol.h"
+
 #define BUFFER_SIZE 2048
+// Maior quadro aceito do servidor (o histórico vem em um único quadro)
+#define MAX_SERVER_PAYLOAD (16u * 1024 * 1024)
+#define RECONNECT_MAX_DELAY 30 // Segundos entre tentativas de reconexão
+#define ROOM_NAME_MAX 32
+
+// Conexão atual; trocada pela thread de recebimento ao reconectar
+static int g_sock = -1;
+static pthread_mutex_t g_sock_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static const char* g_nickname;
+static struct sockaddr_in g_server;
+
+// Sala atual e última mensagem pública recebida nela, apresentadas ao
+// reconectar para voltar à sala e receber só o que foi perdido. Usados
+// apenas pela thread de recebimento.
+static char g_room[ROOM_NAME_MAX + 1] = "";
+static uint64_t g_last_seq = 0;
+static int g_joined = 0; // Já entrou no chat ao menos uma vez
 
 void sigint_handler(int sig) {
     (void)sig;
@@ -16,100 +37,227 @@ void sigint_handler(int sig) {
     exit(0);
 }
 
-// Thread para receber mensagens do servidor
-void* receive_handler(void* socket_desc) {
-    int sock = *(int*)socket_desc;
-    char server_reply[BUFFER_SIZE];
-    int read_size;
-
-    // Loop para ler e imprimir mensagens do servidor
-    while ((read_size = read(sock, server_reply, sizeof(server_reply) - 1)) > 0) {
-        server_reply[read_size] = '\0';
-        printf("%s", server_reply);
-        if (strstr(server_reply, "O servidor foi encerrado")) {
-            printf("\n[INFO]: Conexão encerrada pelo servidor.\n");
-            close(sock);
-            exit(0);
+// Escreve todo o buffer, mesmo que o kernel aceite apenas parte por vez
+static int write_all(int sock, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(sock, data, len, MSG_NOSIGNAL);
+        if (n < 0) return -1;
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Conecta e entra no chat: preâmbulo e JOIN (última mensagem vista,
+// nickname e sala) seguem juntos em uma única escrita. Retorna o socket ou -1.
+static int connect_and_join(void) {
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (sock == -1) return -1;
+    if (connect(sock, (struct sockaddr*)&g_server, sizeof(g_server)) < 0) {
+        close(sock);
+        return -1;
+    }
+
+    char join[FRAME_SEQ_SIZE + BUFFER_SIZE + 1 + ROOM_NAME_MAX];
+    size_t nick_len = strnlen(g_nickname, BUFFER_SIZE);
+    size_t join_len = FRAME_SEQ_SIZE + nick_len;
+    frame_put_seq((unsigned char*)join, g_last_seq);
+    memcpy(join + FRAME_SEQ_SIZE, g_nickname, nick_len);
+    if (g_room[0]) {
+        size_t room_len = strlen(g_room);
+        join[join_len++] = '\0';
+        memcpy(join + join_len, g_room, room_len);
+        join_len += room_len;
+    }
+
+    char hello[PROTO_PREAMBLE_SIZE + FRAME_HEADER_SIZE + sizeof(join)];
+    memcpy(hello, PROTO_PREAMBLE, PROTO_PREAMBLE_SIZE);
+    size_t hello_len = PROTO_PREAMBLE_SIZE + frame_encode(hello + PROTO_PREAMBLE_SIZE, FRAME_JOIN, join, join_len);
+    if (write_all(sock, hello, hello_len) < 0) {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Imprime um quadro recebido do servidor. Retorna -1 se a conexão deve ser
+// refeita (o nickname ainda está preso à sessão anterior no servidor).
+static int print_frame(FrameType type, uint64_t seq, const char* text, size_t len) {
+    if (type == FRAME_PUBLIC && seq != 0 && seq <= g_last_seq) {
+        return 0; // Já recebida (reenvio sobreposto à entrega ao vivo)
+    }
+    if (type == FRAME_ROOM) {
+        // Cada sala tem sua numeração; ao voltar para a mesma sala (na
+        // reconexão) a última mensagem vista continua valendo
+        if (len <= ROOM_NAME_MAX && (strlen(g_room) != len || memcmp(g_room, text, len) != 0)) {
+            memcpy(g_room, text, len);
+            g_room[len] = '\0';
+            g_last_seq = 0;
         }
-        fflush(stdout); // Garante que a mensagem seja impressa imediatamente
+        return 0;
+    }
+    if (type == FRAME_GAP) {
+        g_last_seq = 0; // A numeração pode ter recomeçado no servidor
     }
+    if (seq > g_last_seq) g_last_seq = seq;
+    if (type == FRAME_HISTORY) g_joined = 1;
 
-    if (read_size == 0) {
-        printf("\nServidor desconectado. Pressione Enter para sair.\n");
-    } else {
-        perror("recv falhou");
+    printf("%.*s\n", (int)len, text);
+    if (type == FRAME_SYSTEM && memmem(text, len, "O servidor foi encerrado", 24)) {
+        printf("\n[INFO]: Conexão encerrada pelo servidor.\n");
+        exit(0);
+    }
+    static const char name_taken[] = "já está em uso";
+    if (type == FRAME_SYSTEM && memmem(text, len, name_taken, sizeof(name_taken) - 1)) {
+        if (!g_joined) exit(1);
+        return -1;
     }
-    
-    // Sinaliza para a thread principal sair
-    close(sock);
-    exit(0);
-    
     return 0;
 }
 
+// Lê e imprime quadros até a conexão cair. Os quadros podem chegar vários
+// por leitura ou divididos entre leituras; o que sobra de um quadro
+// incompleto fica no início do buffer.
+static void receive_frames(int sock) {
+    size_t cap = BUFFER_SIZE;
+    size_t used = 0;
+    char* buf = (char*)malloc(cap);
+    ssize_t read_size = -1;
+
+    while (buf && read_size != 0) {
+        if (used == cap) {
+            // Só cresce para quadros maiores que o buffer (ex.: histórico)
+            char* grown = (char*)realloc(buf, cap * 2);
+            if (!grown) break;
+            buf = grown;
+            cap *= 2;
+        }
+        if ((read_size = read(sock, buf + used, cap - used)) <= 0) break;
+        used += (size_t)read_size;
+
+        size_t start = 0;
+        for (;;) {
+            FrameType type;
+            const char* payload;
+            size_t len;
+            long n = frame_parse(buf + start, used - start, MAX_SERVER_PAYLOAD, &type, &payload, &len);
+            if (n == 0) break;
+            if (n < 0 || len < FRAME_SEQ_SIZE) {
+                // Servidor sem suporte ao protocolo: o que veio é texto
+                printf("%.*s", (int)(used - start), buf + start);
+                printf("\n[INFO]: Resposta inesperada do servidor.\n");
+                exit(1);
+            }
+            start += (size_t)n;
+            if (print_frame(type, frame_get_seq(payload), payload + FRAME_SEQ_SIZE, len - FRAME_SEQ_SIZE) < 0) {
+                read_size = 0;
+                break;
+            }
+        }
+        fflush(stdout); // Garante que a mensagem seja impressa imediatamente
+
+        memmove(buf, buf + start, used - start);
+        used -= start;
+    }
+    free(buf);
+
+    if (read_size < 0) perror("recv falhou");
+}
+
+// Thread para receber mensagens do servidor. Se a conexão cair, reconecta
+// com espera crescente e informa a última mensagem vista, recebendo só o
+// que perdeu.
+void* receive_handler(void* arg) {
+    (void)arg;
+    for (;;) {
+        receive_frames(g_sock);
+        printf("\n[INFO]: Conexão perdida. Reconectando...\n");
+        fflush(stdout);
+
+        int sock = -1;
+        for (unsigned delay = 1; sock < 0; ) {
+            sleep(delay);
+            if (delay < RECONNECT_MAX_DELAY) delay *= 2;
+            sock = connect_and_join();
+        }
+
+        pthread_mutex_lock(&g_sock_mutex);
+        close(g_sock);
+        g_sock = sock;
+        pthread_mutex_unlock(&g_sock_mutex);
+        printf("[INFO]: Reconectado.\n");
+        fflush(stdout);
+    }
+    return NULL;
+}
+
 int main(int argc, char* argv[]) {
     if (argc < 4) {
         fprintf(stderr, "Uso: %s <seu_nome> <ip_servidor> <porta>\n", argv[0]);
         return 1;
     }
     
-    char* nickname = argv[1];
+    g_nickname = argv[1];
     char* server_ip = argv[2];
     int port = atoi(argv[3]);
 
-    int sock;
-    struct sockaddr_in server;
-
     signal(SIGINT, sigint_handler);
 
+    g_server.sin_addr.s_addr = inet_addr(server_ip);
+    g_server.sin_family = AF_INET;
+    g_server.sin_port = htons(port);
 
-    // 1. Criar Socket
-    sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock == -1) {
-        perror("Não foi possível criar o socket");
-        return 1;
-    }
-
-    server.sin_addr.s_addr = inet_addr(server_ip);
-    server.sin_family = AF_INET;
-    server.sin_port = htons(port);
-
-    // 2. Conectar ao Servidor
-    if (connect(sock, (struct sockaddr*)&server, sizeof(server)) < 0) {
+    // 1-2. Conectar ao servidor e entrar no chat
+    g_sock = connect_and_join();
+    if (g_sock < 0) {
         perror("Conexão falhou");
         return 1;
     }
     printf("Conectado ao servidor! Você pode começar a digitar.\n");
     printf("Aviso: Este chat possui um filtro de palavras e mensagens com conteúdo restrito serão censuradas.\n");
-    printf("Dica: Para enviar uma mensagem privada, use o formato: /msg <nickname> <mensagem>\n\n"); 
-    // Envia o nickname para o servidor como primeira mensagem
-    if (write(sock, nickname, strlen(nickname)) < 0) {
-        perror("Falha ao enviar nickname");
-        return 1;
-    }
+    printf("Dica: Para enviar uma mensagem privada, use o formato: /msg <nickname> <mensagem>\n");
+    printf("Dica: Use /join <sala> para trocar de sala e /part para voltar à sala geral.\n\n"); 
 
     // 3. Criar a thread para receber mensagens
     pthread_t recv_thread;
-    if (pthread_create(&recv_thread, NULL, receive_handler, (void*)&sock) < 0) {
+    if (pthread_create(&recv_thread, NULL, receive_handler, NULL) != 0) {
         perror("Não foi possível criar a thread de recebimento");
         return 1;
     }
 
     // 4. Thread principal lê o input do usuário e envia
     while (1) {
-    char buffer[BUFFER_SIZE]; // Buffer simples para a mensagem crua
+    char buffer[BUFFER_SIZE - FRAME_HEADER_SIZE]; // Conteúdo de um quadro
 
     if (fgets(buffer, sizeof(buffer), stdin) == NULL) {
         break;
     }
+    size_t len = strcspn(buffer, "\n");
+    buffer[len] = '\0';
 
-    // Envia apenas a mensagem digitada, sem formatação extra
-    if (write(sock, buffer, strlen(buffer)) < 0) {
-        perror("Envio falhou");
-        break;
+    // "/msg <nick> <texto>" vira um quadro privado "<nick>\0<texto>";
+    // o resto (mensagens e outros comandos) vai como quadro público.
+    char frame[FRAME_HEADER_SIZE + sizeof(buffer)];
+    size_t frame_len;
+    char* space = NULL;
+    if (strncmp(buffer, "/msg ", 5) == 0 && (space = strchr(buffer + 5, ' ')) && space > buffer + 5) {
+        *space = '\0';
+        frame_len = frame_encode(frame, FRAME_PRIVATE, buffer + 5, len - 5);
+    } else {
+        frame_len = frame_encode(frame, FRAME_PUBLIC, buffer, len);
+    }
+
+    pthread_mutex_lock(&g_sock_mutex);
+    int rc = write_all(g_sock, frame, frame_len);
+    pthread_mutex_unlock(&g_sock_mutex);
+    if (rc < 0) {
+        // A thread de recebimento está reconectando
+        printf("[INFO]: Sem conexão com o servidor; a mensagem não foi enviada.\n");
     }
 }
 
-    close(sock);
+    pthread_mutex_lock(&g_sock_mutex);
+    close(g_sock);
+    pthread_mutex_unlock(&g_sock_mutex);
     return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file
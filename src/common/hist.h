@@ -0,0 +1,59 @@
+#ifndef HIST_H
+#define HIST_H
+
+#include <stdint.h>
+
+/**
+ * @brief Histograma log-linear, compartilhado pelas métricas do servidor e
+ * pelos benchmarks.
+ *
+ * Valores abaixo de 2^sub_bits têm faixa própria; cada potência de 2 acima
+ * disso é dividida em 2^sub_bits faixas iguais, com erro relativo de até
+ * 2^-sub_bits. A partir de 2^max_exp tudo cai na última faixa. Quem usa
+ * escolhe sub_bits e max_exp como constantes e guarda as contagens em um
+ * vetor de HIST_BUCKETS(sub_bits, max_exp) posições.
+ */
+
+#define HIST_BUCKETS(sub_bits, max_exp) (((max_exp) - (sub_bits) + 1) * (1u << (sub_bits)))
+
+// Faixa em que v cai
+static inline unsigned hist_bucket_of(uint64_t v, unsigned sub_bits, unsigned max_exp) {
+    unsigned sub = 1u << sub_bits;
+    if (v < sub) return (unsigned)v;
+    unsigned e = 63u - (unsigned)__builtin_clzll(v);
+    if (e >= max_exp) return HIST_BUCKETS(sub_bits, max_exp) - 1;
+    return (e - sub_bits + 1) * sub + (unsigned)((v >> (e - sub_bits)) & (sub - 1));
+}
+
+// Maior valor que cai na faixa i
+static inline uint64_t hist_bucket_high(unsigned i, unsigned sub_bits) {
+    unsigned sub = 1u << sub_bits;
+    if (i < sub) return i;
+    unsigned group = i / sub;
+    return ((uint64_t)(sub + i % sub + 1) << (group - 1)) - 1;
+}
+
+/**
+ * @brief Percentil q (0 a 1) das contagens em buckets.
+ * @param count Total de valores nas faixas.
+ * @param max Maior valor registrado; limita o topo da faixa encontrada.
+ * @return Topo da faixa que contém o percentil, ou 0 sem valores.
+ */
+static inline uint64_t hist_percentile(const unsigned long long* buckets, unsigned sub_bits,
+                                       unsigned max_exp, unsigned long long count,
+                                       unsigned long long max, double q) {
+    if (count == 0) return 0;
+    unsigned long long rank = (unsigned long long)(q * (double)count + 0.999999);
+    if (rank < 1) rank = 1;
+    unsigned long long seen = 0;
+    for (unsigned i = 0; i < HIST_BUCKETS(sub_bits, max_exp); i++) {
+        seen += buckets[i];
+        if (seen >= rank) {
+            uint64_t high = hist_bucket_high(i, sub_bits);
+            return high < max ? high : max;
+        }
+    }
+    return max;
+}
+
+#endif // HIST_H
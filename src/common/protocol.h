@@ -0,0 +1,107 @@
+#ifndef PROTOCOL_H
+#define PROTOCOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief Protocolo de quadros do chat, compartilhado por servidor e cliente.
+ *
+ * A conexão começa com o preâmbulo de PROTO_PREAMBLE_SIZE bytes enviado
+ * pelo cliente (o primeiro byte é 0x00, que nunca aparece em um nickname,
+ * então clientes de texto continuam funcionando no modo de linhas). Depois
+ * disso, cada mensagem, nos dois sentidos, é um quadro:
+ *
+ *     [tipo: 1 byte][tamanho do conteúdo: 4 bytes big-endian][conteúdo]
+ *
+ * O conteúdo é texto UTF-8 sem o '\n' final. Em FRAME_PRIVATE enviado pelo
+ * cliente, o conteúdo é "<destinatário>\0<texto>".
+ *
+ * Todo quadro enviado pelo servidor começa o conteúdo com o número de
+ * sequência (FRAME_SEQ_SIZE bytes big-endian) da mensagem. As mensagens
+ * públicas são numeradas em ordem crescente; avisos, mensagens privadas e
+ * respostas a /history levam 0. Em FRAME_HISTORY, o número é o da última
+ * mensagem do bloco. Cada sala tem sua própria numeração, e o servidor
+ * envia FRAME_ROOM (conteúdo: o nome da sala) sempre que o cliente entra
+ * em uma. O FRAME_JOIN do cliente é "<seq><nickname>" ou
+ * "<seq><nickname>\0<sala>", em que seq é a última mensagem que ele viu
+ * nessa sala (0 na primeira conexão). Ao reconectar, o cliente recebe só
+ * as mensagens que perdeu ou, se forem muitas, um FRAME_GAP seguido do
+ * histórico completo.
+ */
+
+#define PROTO_VERSION 2
+#define PROTO_PREAMBLE_SIZE 4
+#define PROTO_PREAMBLE "\0CH\2" // Último byte = PROTO_VERSION
+
+#define FRAME_HEADER_SIZE 5
+#define FRAME_SEQ_SIZE 8
+
+typedef enum {
+    FRAME_JOIN = 1,    // Cliente -> servidor: nickname
+    FRAME_PUBLIC = 2,  // Mensagem pública (ou comando, vindo do cliente)
+    FRAME_PRIVATE = 3, // Mensagem privada
+    FRAME_HISTORY = 4, // Servidor -> cliente: bloco do histórico
+    FRAME_SYSTEM = 5,  // Servidor -> cliente: avisos e respostas
+    FRAME_GAP = 6,     // Servidor -> cliente: mensagens perdidas demais para reenviar
+    FRAME_ROOM = 7     // Servidor -> cliente: sala em que o cliente está
+} FrameType;
+
+static inline int frame_type_valid(unsigned type) {
+    return type >= FRAME_JOIN && type <= FRAME_ROOM;
+}
+
+static inline void frame_put_seq(unsigned char* out, uint64_t seq) {
+    for (int i = FRAME_SEQ_SIZE - 1; i >= 0; i--) {
+        out[i] = (unsigned char)seq;
+        seq >>= 8;
+    }
+}
+
+static inline uint64_t frame_get_seq(const char* in) {
+    const unsigned char* p = (const unsigned char*)in;
+    uint64_t seq = 0;
+    for (int i = 0; i < FRAME_SEQ_SIZE; i++) seq = (seq << 8) | p[i];
+    return seq;
+}
+
+static inline void frame_write_header(unsigned char* hdr, FrameType type, uint32_t len) {
+    hdr[0] = (unsigned char)type;
+    hdr[1] = (unsigned char)(len >> 24);
+    hdr[2] = (unsigned char)(len >> 16);
+    hdr[3] = (unsigned char)(len >> 8);
+    hdr[4] = (unsigned char)len;
+}
+
+/**
+ * @brief Decodifica o quadro no início de buf, se já estiver completo.
+ * @param max_payload Maior conteúdo aceito; quadros maiores são inválidos.
+ * @return Bytes ocupados pelo quadro, 0 se ainda incompleto, -1 se inválido.
+ */
+static inline long frame_parse(const char* buf, size_t avail, size_t max_payload,
+                               FrameType* type, const char** payload, size_t* len) {
+    if (avail < FRAME_HEADER_SIZE) return 0;
+
+    const unsigned char* h = (const unsigned char*)buf;
+    uint32_t n = ((uint32_t)h[1] << 24) | ((uint32_t)h[2] << 16) | ((uint32_t)h[3] << 8) | h[4];
+    if (!frame_type_valid(h[0]) || n > max_payload) return -1;
+    if (avail - FRAME_HEADER_SIZE < n) return 0;
+
+    *type = (FrameType)h[0];
+    *payload = buf + FRAME_HEADER_SIZE;
+    *len = n;
+    return (long)(FRAME_HEADER_SIZE + n);
+}
+
+/**
+ * @brief Escreve em out o quadro com o conteúdo dado.
+ * @return Tamanho total do quadro.
+ */
+static inline size_t frame_encode(char* out, FrameType type, const char* payload, size_t len) {
+    frame_write_header((unsigned char*)out, type, (uint32_t)len);
+    memcpy(out + FRAME_HEADER_SIZE, payload, len);
+    return FRAME_HEADER_SIZE + len;
+}
+
+#endif
@@ -1,100 +1,725 @@
-#define _POSIX_C_SOURCE 200809L 
-#include <string.h>             
+#define _GNU_SOURCE // syscall(SYS_gettid), CLOCK_REALTIME_COARSE
+#include <string.h>
 
 #include "tslog.h"
 #include <pthread.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <time.h>
-#include <sys/time.h>  
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
 
-// Estrutura para uma entrada de log na fila
-typedef struct LogEntry {
-    LogLevel level;
-    char* message;
-    struct LogEntry* next;
-} LogEntry;
+// Capacidade do anel (potência de 2) e tamanho de cada posição
+#ifndef TSLOG_RING_SLOTS
+#define TSLOG_RING_SLOTS 4096
+#endif
+#ifndef TSLOG_SLOT_SIZE
+#define TSLOG_SLOT_SIZE 1024
+#endif
 
-// Fila thread-safe para as entradas de log
+// Relógio do horário de cada mensagem, lido por quem a registra. O
+// "coarse" custa uma fração de CLOCK_REALTIME, com resolução de um tick.
+#ifndef TSLOG_CLOCK
+#define TSLOG_CLOCK CLOCK_REALTIME_COARSE
+#endif
+
+#define TSLOG_CACHE_LINE 64
+#define TSLOG_HEADER_SIZE (sizeof(size_t) + 2 * sizeof(uint16_t) + sizeof(uint32_t) + \
+                           sizeof(const char*) + sizeof(int64_t) + sizeof(int32_t))
+#define TSLOG_TEXT_MAX (TSLOG_SLOT_SIZE - TSLOG_HEADER_SIZE)
+#define TSLOG_LINE_MAX 4096 // Maior linha formatada pela thread de escrita
+#ifndef TSLOG_BATCH_SIZE
+#define TSLOG_BATCH_SIZE (64 * 1024) // Buffer de um lote de linhas
+#endif
+#define TSLOG_PREFIX_MAX 64 // "[data hora.ms] [thread] [NÍVEL] "
+
+#define SLOT_TRUNCATED 0x1 // Argumentos de logger_logf() não couberam
+
+#define TSLOG_BIN_SEGMENT_DEFAULT (16u << 20) // Padrão de LogBinaryOptions.segment_bytes
+#define TSLOG_BIN_SEGMENT_MIN (1u << 20)
+
+#define TSLOG_DROP_REPORT_SECS 10 // Intervalo mínimo entre resumos de descartes
+#define TSLOG_ABANDON_GRACE_MS 1000 // Tolerância extra de logger_destroy_timeout()
+#define TSLOG_SPIN_LIMIT 16 // Tentativas com sched_yield() antes de dormir na fila cheia
+
+_Static_assert((TSLOG_RING_SLOTS & (TSLOG_RING_SLOTS - 1)) == 0,
+               "TSLOG_RING_SLOTS deve ser potência de 2");
+
+// Posição do anel com a mensagem guardada inline. seq diz de quem é a vez:
+// igual ao índice de escrita, está livre para um produtor; igual ao índice
+// + 1, contém uma mensagem pronta para o consumidor. Com fmt == NULL, text
+// é o texto pronto; senão, os argumentos de logger_logf() codificados.
 typedef struct {
-    LogEntry *head, *tail;
-    pthread_mutex_t mutex;
-    pthread_cond_t cond;
-} LogQueue;
+    _Alignas(TSLOG_CACHE_LINE) atomic_size_t seq;
+    uint16_t level;
+    uint16_t flags;
+    uint32_t len;
+    const char* fmt;
+    int64_t time_ns; // Horário da chamada (TSLOG_CLOCK)
+    int32_t tid;     // Thread que registrou a mensagem
+    char text[TSLOG_TEXT_MAX];
+} LogSlot;
+
+_Static_assert(sizeof(LogSlot) == TSLOG_SLOT_SIZE, "LogSlot fora do tamanho");
+
+/**
+ * Fila limitada com vários produtores e um consumidor, pré-alocada.
+ *
+ * Um produtor reserva uma posição avançando tail com compare-and-swap,
+ * copia a mensagem e a publica em seq; não há alocação nem lock. O
+ * consumidor retira posições avançando head também com compare-and-swap,
+ * porque com LOG_OVERFLOW_DROP_OLDEST um produtor diante da fila cheia
+ * retira (e descarta) a mais antiga.
+ *
+ * Há um anel compartilhado e, com logger_set_thread_buffers(), um anel
+ * por thread produtora, com um único produtor.
+ *
+ * Um produtor que espera a fila cheia dorme num futex em free_seq depois
+ * de algumas tentativas; ring_release() só o incrementa e acorda quando
+ * waiters indica alguém dormindo.
+ */
+typedef struct {
+    LogSlot* slots;
+    size_t size; // Número de posições (potência de 2)
+    _Alignas(TSLOG_CACHE_LINE) atomic_size_t tail; // Próxima posição a reservar
+    _Alignas(TSLOG_CACHE_LINE) atomic_size_t head; // Próxima a retirar
+    // Só alterados quando a fila está cheia, fora do caminho comum
+    _Alignas(TSLOG_CACHE_LINE) atomic_ullong dropped;
+    atomic_ullong blocked;
+    atomic_size_t high_water; // Maior ocupação observada
+    _Alignas(TSLOG_CACHE_LINE) atomic_uint free_seq; // Palavra do futex
+    atomic_int waiters; // Produtores dormindo em free_seq
+} LogRing;
+
+// Anel de uma thread produtora. Os anéis formam uma lista em que os
+// produtores só inserem no início; a thread de escrita remove e libera os
+// anéis de threads que terminaram, depois de esvaziá-los.
+typedef struct ThreadRing {
+    LogRing ring;
+    struct ThreadRing* next;
+    atomic_int closed; // A thread dona terminou
+} ThreadRing;
 
-// Estrutura principal do logger
+// Formato de logger_logf() já definido no fluxo binário
 typedef struct {
-    LogQueue queue;
+    const char* fmt;
+    uint32_t id;
+} EventId;
+
+// Lote de linhas formatadas, gravado nos destinos de uma só vez. Cada
+// formato tem seu buffer, preenchido só se houver destinos dele.
+typedef struct {
+    char data[TSLOG_BATCH_SIZE];
+    size_t len;
+    char bin[TSLOG_BATCH_SIZE];
+    size_t bin_len;
+    int has_text;
+    int has_binary;
+    EventId* events;          // Tabela aberta, indexada pelo endereço do formato
+    size_t events_cap;        // Potência de 2
+    uint32_t num_events;
+    char scratch[TSLOG_LINE_MAX]; // Texto de eventos sem definição possível
+    struct timespec deadline; // Prazo para gravar (intervalo de flush)
+    time_t cached_sec;        // Segundo de cached_time
+    char cached_time[32];     // "AAAA-MM-DD HH:MM:SS" de cached_sec
+    int32_t tid;              // Da própria thread de escrita
+    unsigned long long reported_dropped; // Descartes já resumidos no log
+    struct timespec next_report;         // Quando o próximo resumo pode sair
+} LogBatch;
+
+/**
+ * Estrutura principal do logger.
+ *
+ * Quando as filas esvaziam, a thread de escrita marca sleeping e dorme;
+ * apenas o produtor que encontrar a marca a acorda, então uma rajada de
+ * mensagens custa um único sinal e é gravada de uma vez.
+ */
+typedef struct {
+    LogRing ring;
+    LogBatch batch; // Usado apenas pela thread de escrita
     pthread_t writer_thread;
-    int running;
+    atomic_int running;
+    _Alignas(TSLOG_CACHE_LINE) atomic_int sleeping;
+    pthread_mutex_t mutex; // Apenas para dormir/acordar a thread de escrita
+    pthread_cond_t cond;
+
+    // Anéis por thread (logger_set_thread_buffers)
+    size_t thread_slots;                 // 0 = todos usam o anel compartilhado
+    pthread_key_t thread_key;            // ThreadRing da thread atual
+    _Atomic(ThreadRing*) threads;        // Lista de anéis por thread
+    pthread_mutex_t threads_mutex;       // Remoção da lista x logger_stats()
+    unsigned long long retired_dropped;  // Contadores de anéis já liberados,
+    unsigned long long retired_blocked;  // protegidos por threads_mutex
+    size_t retired_high_water;
+
+    // Encerramento com prazo (logger_destroy_timeout)
+    int has_drain_deadline;
+    struct timespec drain_deadline;
+    int writer_done;          // Protegido por mutex
+    pthread_cond_t done_cond;
+
+    atomic_ullong written;
 } Logger;
 
 // Instância global estática do logger
 static Logger* g_logger = NULL;
 
-// --- Implementação da Fila ---
-static void queue_init(LogQueue* q) {
-    q->head = q->tail = NULL;
-    pthread_mutex_init(&q->mutex, NULL);
-    pthread_cond_init(&q->cond, NULL);
+// Configuração dos destinos, feita antes de logger_init()
+static LogSink g_sinks[TSLOG_MAX_SINKS];
+static size_t g_num_sinks = 0;
+static unsigned g_flush_ms = 0;
+static size_t g_thread_slots = 0;
+
+// Política de fila cheia; lida pelos produtores só quando a fila enche
+static atomic_int g_overflow = LOG_OVERFLOW_BLOCK;
+static atomic_int g_overflow_level = WARNING;
+
+static int timespec_passed(const struct timespec* now, const struct timespec* t) {
+    return now->tv_sec > t->tv_sec || (now->tv_sec == t->tv_sec && now->tv_nsec >= t->tv_nsec);
 }
 
-static void queue_destroy(LogQueue* q) {
-    LogEntry* current = q->head;
-    while (current != NULL) {
-        LogEntry* next = current->next;
-        free(current->message);
-        free(current);
-        current = next;
+static void timespec_add_ms(struct timespec* t, unsigned ms) {
+    t->tv_sec += ms / 1000;
+    t->tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (t->tv_nsec >= 1000000000L) {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000L;
     }
-    pthread_mutex_destroy(&q->mutex);
-    pthread_cond_destroy(&q->cond);
 }
 
-static void queue_push(LogQueue* q, LogLevel level, const char* message) {
-    LogEntry* new_entry = (LogEntry*)malloc(sizeof(LogEntry));
-    if (!new_entry) {
-        perror("Falha ao alocar LogEntry");
-        return;
+// --- Implementação do Anel ---
+static int ring_init(LogRing* r, size_t size) {
+    void* mem;
+    if (posix_memalign(&mem, TSLOG_CACHE_LINE, size * sizeof(LogSlot)) != 0) {
+        return -1;
+    }
+    r->slots = (LogSlot*)mem;
+    r->size = size;
+    for (size_t i = 0; i < size; i++) {
+        atomic_init(&r->slots[i].seq, i);
     }
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->head, 0);
+    atomic_init(&r->dropped, 0);
+    atomic_init(&r->blocked, 0);
+    atomic_init(&r->high_water, 0);
+    atomic_init(&r->free_seq, 0);
+    atomic_init(&r->waiters, 0);
+    return 0;
+}
 
-    new_entry->message = strdup(message);
-    if (!new_entry->message) {
-        perror("Falha ao duplicar mensagem");
-        free(new_entry);
-        return;
+static void ring_destroy(LogRing* r) {
+    free(r->slots);
+}
+
+static void logger_wake(Logger* lg) {
+    // A barreira casa com a da thread de escrita em logger_wait(): ou ela
+    // vê a mensagem recém-publicada, ou nós vemos sleeping = 1
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&lg->sleeping, memory_order_relaxed) &&
+        atomic_exchange(&lg->sleeping, 0)) {
+        pthread_mutex_lock(&lg->mutex);
+        pthread_cond_signal(&lg->cond);
+        pthread_mutex_unlock(&lg->mutex);
+    }
+}
+
+// Posição da mensagem mais antiga se ela estiver pronta, ou NULL
+static LogSlot* ring_peek(LogRing* r) {
+    size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    LogSlot* slot = &r->slots[pos & (r->size - 1)];
+    return atomic_load_explicit(&slot->seq, memory_order_acquire) == pos + 1 ? slot : NULL;
+}
+
+// Retira a mensagem mais antiga, ou retorna NULL se não houver nenhuma
+// pronta. A posição fica com quem a retirou até ring_release().
+static LogSlot* ring_take(LogRing* r, size_t* pos_out) {
+    size_t pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+    for (;;) {
+        LogSlot* slot = &r->slots[pos & (r->size - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->head, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *pos_out = pos;
+                return slot;
+            }
+        } else if (diff < 0) {
+            return NULL; // Vazia, ou o produtor ainda está escrevendo
+        } else {
+            pos = atomic_load_explicit(&r->head, memory_order_relaxed);
+        }
+    }
+}
+
+// Devolve aos produtores uma posição retirada com ring_take()
+static void ring_release(LogRing* r, LogSlot* slot, size_t pos) {
+    atomic_store_explicit(&slot->seq, pos + r->size, memory_order_release);
+    // Casa com a barreira de ring_wait_free(): ou o produtor vê a posição
+    // livre, ou nós vemos waiters > 0
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&r->waiters, memory_order_relaxed) > 0) {
+        atomic_fetch_add(&r->free_seq, 1);
+        syscall(SYS_futex, &r->free_seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+    }
+}
+
+// Dorme até ring_release() liberar alguma posição, a menos que a posição
+// esperada (slot, livre quando seq == pos) já esteja livre
+static void ring_wait_free(LogRing* r, const LogSlot* slot, size_t pos) {
+    atomic_fetch_add(&r->waiters, 1);
+    unsigned seen = atomic_load(&r->free_seq);
+    atomic_thread_fence(memory_order_seq_cst);
+    if ((intptr_t)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos) < 0) {
+        syscall(SYS_futex, &r->free_seq, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+    }
+    atomic_fetch_sub_explicit(&r->waiters, 1, memory_order_relaxed);
+}
+
+// Reserva a próxima posição livre. Com a fila cheia aplica a política:
+// espera, descarta a mais antiga ou retorna NULL (mensagem descartada).
+// O chamador preenche a posição e a entrega com ring_publish().
+static LogSlot* ring_reserve(Logger* lg, LogRing* r, LogLevel level, size_t* pos_out) {
+    size_t pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    int waited = 0;
+    int spins = 0;
+    for (;;) {
+        LogSlot* slot = &r->slots[pos & (r->size - 1)];
+        size_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&r->tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                *pos_out = pos;
+                return slot;
+            }
+            continue;
+        }
+        if (diff > 0) {
+            pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+            continue;
+        }
+
+        // Fila cheia
+        if (atomic_load_explicit(&r->high_water, memory_order_relaxed) != r->size) {
+            atomic_store_explicit(&r->high_water, r->size, memory_order_relaxed);
+        }
+        int policy = atomic_load_explicit(&g_overflow, memory_order_relaxed);
+        if (policy == LOG_OVERFLOW_DROP_NEWEST ||
+            (policy == LOG_OVERFLOW_DROP_BELOW &&
+             (int)level < atomic_load_explicit(&g_overflow_level, memory_order_relaxed))) {
+            atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+            logger_wake(lg);
+            return NULL;
+        }
+        if (policy == LOG_OVERFLOW_DROP_OLDEST) {
+            // A mais antiga ocupa esta mesma posição, uma volta atrás. Se o
+            // consumidor já a retirou, basta esperar que ele a devolva.
+            size_t oldest = pos - r->size;
+            if (seq == oldest + 1 &&
+                atomic_compare_exchange_strong_explicit(&r->head, &oldest, oldest + 1,
+                                                        memory_order_relaxed,
+                                                        memory_order_relaxed)) {
+                ring_release(r, slot, pos - r->size);
+                atomic_fetch_add_explicit(&r->dropped, 1, memory_order_relaxed);
+                continue;
+            }
+        } else if (!waited) {
+            atomic_fetch_add_explicit(&r->blocked, 1, memory_order_relaxed);
+            waited = 1;
+        }
+        // Espera o consumidor liberar posições: algumas tentativas curtas,
+        // depois dorme até ring_release()
+        logger_wake(lg);
+        if (spins < TSLOG_SPIN_LIMIT) {
+            spins++;
+            sched_yield();
+        } else {
+            ring_wait_free(r, slot, pos);
+        }
+        pos = atomic_load_explicit(&r->tail, memory_order_relaxed);
+    }
+}
+
+// Entrega a posição preenchida, com o horário e a thread da chamada
+static void ring_publish(Logger* lg, LogSlot* slot, size_t pos, int64_t time_ns, int32_t tid) {
+    slot->time_ns = time_ns;
+    slot->tid = tid;
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+    logger_wake(lg);
+}
+
+// --- Anéis por thread ---
+
+static _Thread_local int32_t t_tid; // ID da thread no kernel, como em top -H
+
+static int32_t current_tid(void) {
+    if (t_tid == 0) t_tid = (int32_t)syscall(SYS_gettid);
+    return t_tid;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(TSLOG_CLOCK, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+// Destrutor da chave: a thread terminou e seu anel pode ser liberado
+// assim que a thread de escrita o esvaziar
+static void thread_ring_close(void* arg) {
+    atomic_store_explicit(&((ThreadRing*)arg)->closed, 1, memory_order_release);
+}
+
+// Anel em que a thread atual deve publicar: o seu próprio, criado na
+// primeira mensagem, ou o compartilhado
+static LogRing* producer_ring(Logger* lg) {
+    if (lg->thread_slots == 0) return &lg->ring;
+    ThreadRing* tr = (ThreadRing*)pthread_getspecific(lg->thread_key);
+    if (tr) return &tr->ring;
+
+    tr = (ThreadRing*)calloc(1, sizeof(ThreadRing));
+    if (!tr || ring_init(&tr->ring, lg->thread_slots) != 0) {
+        free(tr);
+        return &lg->ring; // Sem memória: fica no anel compartilhado
     }
+    atomic_init(&tr->closed, 0);
+    if (pthread_setspecific(lg->thread_key, tr) != 0) {
+        ring_destroy(&tr->ring);
+        free(tr);
+        return &lg->ring;
+    }
+    tr->next = atomic_load_explicit(&lg->threads, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&lg->threads, &tr->next, tr,
+                                                  memory_order_release,
+                                                  memory_order_relaxed)) {
+    }
+    return &tr->ring;
+}
 
-    new_entry->level = level;
-    new_entry->next = NULL;
+static void ring_push(Logger* lg, LogLevel level, const char* message, size_t len) {
+    int64_t time_ns = now_ns();
+    size_t pos;
+    LogSlot* slot = ring_reserve(lg, producer_ring(lg), level, &pos);
+    if (!slot) return; // Descartada pela política de fila cheia
 
-    pthread_mutex_lock(&q->mutex);
-    if (q->tail == NULL) {
-        q->head = q->tail = new_entry;
+    if (len > TSLOG_TEXT_MAX) {
+        // Mensagem maior que a posição: trunca e marca com "..."
+        memcpy(slot->text, message, TSLOG_TEXT_MAX - 3);
+        memcpy(slot->text + TSLOG_TEXT_MAX - 3, "...", 3);
+        len = TSLOG_TEXT_MAX;
     } else {
-        q->tail->next = new_entry;
-        q->tail = new_entry;
+        memcpy(slot->text, message, len);
     }
-    pthread_cond_signal(&q->cond);
-    pthread_mutex_unlock(&q->mutex);
+    slot->level = (uint16_t)level;
+    slot->flags = 0;
+    slot->len = (uint32_t)len;
+    slot->fmt = NULL;
+    ring_publish(lg, slot, pos, time_ns, current_tid());
 }
 
-static LogEntry* queue_pop(LogQueue* q) {
-    pthread_mutex_lock(&q->mutex);
-    while (q->head == NULL && g_logger->running) {
-        pthread_cond_wait(&q->cond, &q->mutex);
+// --- Formatação adiada (logger_logf) ---
+
+// Tipo do argumento consumido por uma conversão de printf
+typedef enum {
+    ARG_PERCENT, // "%%": nenhum argumento
+    ARG_INT,     // int (também char e short, promovidos)
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_INTMAX,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_PTR,
+    ARG_STR,
+    ARG_INVALID  // Conversão sem suporte: o resto do formato sai como texto
+} ArgKind;
+
+typedef struct {
+    ArgKind kind;
+    int stars;          // Largura e/ou precisão passadas como argumento (*)
+    int star_precision; // A precisão é um dos '*'
+    long precision;     // Precisão literal, ou -1
+} FmtSpec;
+
+// Interpreta a conversão que começa em p (logo após o '%') e retorna o
+// endereço seguinte a ela. Usada igualmente pelo produtor e pelo consumidor.
+static const char* parse_spec(const char* p, FmtSpec* spec) {
+    spec->stars = 0;
+    spec->star_precision = 0;
+    spec->precision = -1;
+
+    if (*p == '%') {
+        spec->kind = ARG_PERCENT;
+        return p + 1;
+    }
+    while (*p && strchr("-+ #0'", *p)) p++;
+    if (*p == '*') {
+        spec->stars++;
+        p++;
+    } else {
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    if (*p == '.') {
+        p++;
+        if (*p == '*') {
+            spec->stars++;
+            spec->star_precision = 1;
+            p++;
+        } else {
+            spec->precision = 0;
+            while (*p >= '0' && *p <= '9') spec->precision = spec->precision * 10 + (*p++ - '0');
+        }
+    }
+
+    ArgKind int_kind = ARG_INT;
+    ArgKind float_kind = ARG_DOUBLE;
+    if (p[0] == 'h') {
+        p += (p[1] == 'h') ? 2 : 1;
+    } else if (p[0] == 'l' && p[1] == 'l') {
+        int_kind = ARG_LLONG;
+        p += 2;
+    } else if (p[0] == 'l') {
+        int_kind = ARG_LONG;
+        p++;
+    } else if (p[0] == 'z') {
+        int_kind = ARG_SIZE;
+        p++;
+    } else if (p[0] == 'j') {
+        int_kind = ARG_INTMAX;
+        p++;
+    } else if (p[0] == 't') {
+        int_kind = ARG_PTRDIFF;
+        p++;
+    } else if (p[0] == 'L') {
+        float_kind = ARG_LDOUBLE;
+        p++;
     }
 
-    if (q->head == NULL) { // Logger está finalizando e a fila está vazia
-        pthread_mutex_unlock(&q->mutex);
-        return NULL;
+    switch (*p) {
+        case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+            spec->kind = int_kind;
+            break;
+        case 'c':
+            spec->kind = (int_kind == ARG_INT) ? ARG_INT : ARG_INVALID; // %lc sem suporte
+            break;
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            spec->kind = float_kind;
+            break;
+        case 's':
+            spec->kind = (int_kind == ARG_INT) ? ARG_STR : ARG_INVALID; // %ls sem suporte
+            break;
+        case 'p':
+            spec->kind = ARG_PTR;
+            break;
+        default:
+            spec->kind = ARG_INVALID; // %n, posicionais ou erro no formato
+            return p;
     }
+    return p + 1;
+}
+
+// Escritor sequencial dos argumentos na posição do anel
+typedef struct {
+    char* data;
+    size_t len;
+    int full;
+} ArgWriter;
 
-    LogEntry* entry = q->head;
-    q->head = q->head->next;
-    if (q->head == NULL) {
-        q->tail = NULL;
+static int arg_put(ArgWriter* w, const void* value, size_t size) {
+    if (w->full || size > TSLOG_TEXT_MAX - w->len) {
+        w->full = 1;
+        return -1;
     }
-    pthread_mutex_unlock(&q->mutex);
-    return entry;
+    memcpy(w->data + w->len, value, size);
+    w->len += size;
+    return 0;
+}
+
+#define PUT_ARG(w, type, ap) do { type v_ = va_arg(ap, type); arg_put(w, &v_, sizeof(v_)); } while (0)
+
+// Copia os argumentos de fmt para a posição, sem formatá-los
+static void encode_args(ArgWriter* w, const char* fmt, va_list ap) {
+    for (const char* p = fmt; *p && !w->full; ) {
+        if (*p++ != '%') continue;
+        FmtSpec spec;
+        p = parse_spec(p, &spec);
+        if (spec.kind == ARG_INVALID) return;
+
+        long precision = spec.precision;
+        for (int i = 0; i < spec.stars; i++) {
+            int v = va_arg(ap, int);
+            if (spec.star_precision && i == spec.stars - 1) precision = v;
+            arg_put(w, &v, sizeof(v));
+        }
+
+        switch (spec.kind) {
+            case ARG_PERCENT: case ARG_INVALID: break;
+            case ARG_INT:     PUT_ARG(w, int, ap); break;
+            case ARG_LONG:    PUT_ARG(w, long, ap); break;
+            case ARG_LLONG:   PUT_ARG(w, long long, ap); break;
+            case ARG_SIZE:    PUT_ARG(w, size_t, ap); break;
+            case ARG_INTMAX:  PUT_ARG(w, intmax_t, ap); break;
+            case ARG_PTRDIFF: PUT_ARG(w, ptrdiff_t, ap); break;
+            case ARG_DOUBLE:  PUT_ARG(w, double, ap); break;
+            case ARG_LDOUBLE: PUT_ARG(w, long double, ap); break;
+            case ARG_PTR:     PUT_ARG(w, void*, ap); break;
+            case ARG_STR: {
+                // Tamanho (UINT32_MAX para NULL) seguido dos bytes, sem '\0'
+                const char* s = va_arg(ap, const char*);
+                uint32_t n = UINT32_MAX;
+                size_t at = w->len;
+                if (arg_put(w, &n, sizeof(n)) < 0 || !s) break;
+                size_t room = TSLOG_TEXT_MAX - w->len;
+                int limited = precision >= 0 && (size_t)precision <= room;
+                n = (uint32_t)strnlen(s, limited ? (size_t)precision : room);
+                if (!limited && n == room && s[n] != '\0') {
+                    w->full = 1; // Texto cortado: o que vier depois é omitido
+                }
+                memcpy(w->data + at, &n, sizeof(n));
+                memcpy(w->data + w->len, s, n);
+                w->len += n;
+                break;
+            }
+        }
+    }
+}
+
+// Leitor sequencial dos argumentos gravados por encode_args()
+typedef struct {
+    const char* data;
+    size_t len;
+    size_t off;
+} ArgReader;
+
+static int arg_get(ArgReader* r, void* value, size_t size) {
+    if (size > r->len - r->off) return -1;
+    memcpy(value, r->data + r->off, size);
+    r->off += size;
+    return 0;
+}
+
+// Acrescenta a out o resultado de um snprintf, respeitando a capacidade
+static size_t out_append(size_t cap, size_t pos, int written) {
+    if (written < 0) return pos;
+    pos += (size_t)written;
+    return pos < cap ? pos : cap - 1;
+}
+
+#define FORMAT_ARG(type) do {                                                         \
+        type v_;                                                                     \
+        if (arg_get(&rd, &v_, sizeof(v_)) < 0) goto truncated;                       \
+        if (spec.stars == 0)      n = snprintf(out + pos, cap - pos, conv, v_);       \
+        else if (spec.stars == 1) n = snprintf(out + pos, cap - pos, conv, stars[0], v_); \
+        else                      n = snprintf(out + pos, cap - pos, conv, stars[0], stars[1], v_); \
+    } while (0)
+
+// Formata em out (com capacidade cap) uma mensagem de logger_logf() a
+// partir dos argumentos codificados. Retorna o tamanho do texto.
+static size_t format_args(const char* fmt, const char* args, size_t args_len,
+                          int truncated, char* out, size_t cap) {
+    ArgReader rd = { args, args_len, 0 };
+    const char* p = fmt;
+    size_t pos = 0;
+
+    while (*p && pos < cap - 1) {
+        const char* pct = strchr(p, '%');
+        size_t lit = pct ? (size_t)(pct - p) : strlen(p);
+        if (lit > cap - 1 - pos) lit = cap - 1 - pos;
+        memcpy(out + pos, p, lit);
+        pos += lit;
+        if (!pct) break;
+        p = pct;
+
+        FmtSpec spec;
+        const char* end = parse_spec(p + 1, &spec);
+        if (spec.kind == ARG_INVALID) {
+            // Mesma decisão do produtor: o resto é copiado como texto
+            pos = out_append(cap, pos, snprintf(out + pos, cap - pos, "%s", p));
+            break;
+        }
+
+        char conv[64];
+        size_t conv_len = (size_t)(end - p);
+        if (conv_len + 2 >= sizeof(conv)) goto truncated; // Cabe o ".*s" de %s
+        memcpy(conv, p, conv_len);
+        conv[conv_len] = '\0';
+        p = end;
+
+        int stars[2] = { 0, 0 };
+        for (int i = 0; i < spec.stars; i++) {
+            if (arg_get(&rd, &stars[i], sizeof(int)) < 0) goto truncated;
+        }
+
+        int n = 0;
+        switch (spec.kind) {
+            case ARG_PERCENT: out[pos] = '%'; n = 1; break;
+            case ARG_INVALID: break;
+            case ARG_INT:     FORMAT_ARG(int); break;
+            case ARG_LONG:    FORMAT_ARG(long); break;
+            case ARG_LLONG:   FORMAT_ARG(long long); break;
+            case ARG_SIZE:    FORMAT_ARG(size_t); break;
+            case ARG_INTMAX:  FORMAT_ARG(intmax_t); break;
+            case ARG_PTRDIFF: FORMAT_ARG(ptrdiff_t); break;
+            case ARG_DOUBLE:  FORMAT_ARG(double); break;
+            case ARG_LDOUBLE: FORMAT_ARG(long double); break;
+            case ARG_PTR:     FORMAT_ARG(void*); break;
+            case ARG_STR: {
+                uint32_t slen;
+                if (arg_get(&rd, &slen, sizeof(slen)) < 0) goto truncated;
+                if (slen == UINT32_MAX) {
+                    n = snprintf(out + pos, cap - pos, "(null)");
+                    break;
+                }
+                if (slen > rd.len - rd.off) goto truncated;
+                // A conversão é refeita como "%<flags><largura>.*s" sobre os
+                // bytes copiados, que não terminam em '\0'
+                char* dot = strchr(conv, '.');
+                if (dot) {
+                    strcpy(dot, ".*s");
+                } else {
+                    strcpy(conv + conv_len - 1, ".*s");
+                }
+                int width = (spec.stars > (spec.star_precision ? 1 : 0)) ? stars[0] : 0;
+                if (spec.stars > (spec.star_precision ? 1 : 0)) {
+                    n = snprintf(out + pos, cap - pos, conv, width, (int)slen, rd.data + rd.off);
+                } else {
+                    n = snprintf(out + pos, cap - pos, conv, (int)slen, rd.data + rd.off);
+                }
+                rd.off += slen;
+                break;
+            }
+        }
+        pos = out_append(cap, pos, n);
+    }
+
+    if (!truncated) return pos;
+truncated:
+    pos = out_append(cap, pos, snprintf(out + pos, cap - pos, "..."));
+    return pos;
+}
+
+static size_t format_slot(const LogSlot* slot, char* out, size_t cap) {
+    return format_args(slot->fmt, slot->text, slot->len, slot->flags & SLOT_TRUNCATED, out, cap);
+}
+
+size_t logger_format_args(const char* fmt, const void* args, size_t len,
+                          int truncated, char* out, size_t cap) {
+    if (cap == 0) return 0;
+    size_t n = cap > 1 ? format_args(fmt, (const char*)args, len, truncated, out, cap) : 0;
+    out[n] = '\0';
+    return n;
 }
 
 // --- Funções do Logger ---
@@ -103,70 +728,1002 @@ static const char* level_to_string(LogLevel level) {
         case INFO:    return "INFO";
         case WARNING: return "WARNING";
         case ERROR:   return "ERROR";
+        case LOG_OFF: return "OFF";
     }
     return "UNKNOWN";
 }
 
-// Função executada pela thread de escrita
-static void* writer_thread_func(void* arg) {
-    (void)arg; // Evita warning de argumento não usado
-    while (g_logger->running || g_logger->queue.head != NULL) {
-        LogEntry* entry = queue_pop(&g_logger->queue);
-        if (entry == NULL) {
-            continue; // Continua para verificar a condição de parada novamente
+// --- Níveis mínimos ---
+
+// Nível efetivo de cada módulo, lido sem lock pelas macros LOG_*. Zerado,
+// todos começam em INFO.
+atomic_uchar g_tslog_min_level[TSLOG_MAX_MODULES];
+
+// Configuração da qual os níveis efetivos são derivados, protegida por
+// g_levels_mutex (só quem altera os níveis a usa)
+static pthread_mutex_t g_levels_mutex = PTHREAD_MUTEX_INITIALIZER;
+static LogLevel g_global_level = INFO;
+static int g_module_level[TSLOG_MAX_MODULES]; // Nível + 1, ou 0 para seguir o global
+static char g_module_names[TSLOG_MAX_MODULES][16];
+
+static void levels_apply_locked(void) {
+    for (int i = 0; i < TSLOG_MAX_MODULES; i++) {
+        int level = g_module_level[i] ? g_module_level[i] - 1 : (int)g_global_level;
+        atomic_store_explicit(&g_tslog_min_level[i], (unsigned char)level, memory_order_relaxed);
+    }
+}
+
+static int level_from_name(const char* name, size_t len) {
+    static const char* const names[] = { "info", "warning", "error", "off" };
+    for (int i = 0; i < 4; i++) {
+        if (strlen(names[i]) == len && strncmp(names[i], name, len) == 0) return i;
+    }
+    if (len == 4 && strncmp(name, "warn", 4) == 0) return WARNING;
+    return -1;
+}
+
+static int module_from_name(const char* name, size_t len) {
+    for (int i = 0; i < TSLOG_MAX_MODULES; i++) {
+        if (g_module_names[i][0] && strlen(g_module_names[i]) == len &&
+            strncmp(g_module_names[i], name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int logger_name_module(int module, const char* name) {
+    if (module < 0 || module >= TSLOG_MAX_MODULES) return -1;
+    pthread_mutex_lock(&g_levels_mutex);
+    snprintf(g_module_names[module], sizeof(g_module_names[module]), "%s", name);
+    pthread_mutex_unlock(&g_levels_mutex);
+    return 0;
+}
+
+void logger_set_level(LogLevel level) {
+    pthread_mutex_lock(&g_levels_mutex);
+    g_global_level = level;
+    levels_apply_locked();
+    pthread_mutex_unlock(&g_levels_mutex);
+}
+
+int logger_set_module_level(int module, int level) {
+    if (module < 0 || module >= TSLOG_MAX_MODULES || level < -1 || level > LOG_OFF) return -1;
+    pthread_mutex_lock(&g_levels_mutex);
+    g_module_level[module] = level + 1;
+    levels_apply_locked();
+    pthread_mutex_unlock(&g_levels_mutex);
+    return 0;
+}
+
+int logger_set_levels(const char* spec) {
+    int global = -1;
+    int modules[TSLOG_MAX_MODULES];
+    for (int i = 0; i < TSLOG_MAX_MODULES; i++) modules[i] = -2; // Sem alteração
+
+    pthread_mutex_lock(&g_levels_mutex);
+    const char* p = spec;
+    while (*p) {
+        size_t len = strcspn(p, ", \t\r\n");
+        if (len > 0) {
+            const char* eq = memchr(p, '=', len);
+            if (!eq) {
+                global = level_from_name(p, len);
+                if (global < 0) goto invalid;
+            } else {
+                int module = module_from_name(p, (size_t)(eq - p));
+                size_t value_len = len - (size_t)(eq - p) - 1;
+                int is_default = value_len == 7 && strncmp(eq + 1, "default", 7) == 0;
+                int level = is_default ? -1 : level_from_name(eq + 1, value_len);
+                if (module < 0 || (!is_default && level < 0)) goto invalid;
+                modules[module] = level;
+            }
+        }
+        p += len;
+        if (*p) p++;
+    }
+
+    if (global >= 0) g_global_level = (LogLevel)global;
+    for (int i = 0; i < TSLOG_MAX_MODULES; i++) {
+        if (modules[i] != -2) g_module_level[i] = modules[i] + 1;
+    }
+    levels_apply_locked();
+    pthread_mutex_unlock(&g_levels_mutex);
+    return 0;
+
+invalid:
+    pthread_mutex_unlock(&g_levels_mutex);
+    return -1;
+}
+
+size_t logger_format_levels(char* out, size_t cap) {
+    static const char* const names[] = { "info", "warning", "error", "off" };
+    size_t pos = 0;
+    pthread_mutex_lock(&g_levels_mutex);
+    int n = snprintf(out, cap, "global=%s", names[g_global_level]);
+    pos = (n > 0) ? (size_t)n : 0;
+    for (int i = 0; i < TSLOG_MAX_MODULES && pos < cap; i++) {
+        if (!g_module_names[i][0]) continue;
+        int level = g_module_level[i] ? g_module_level[i] - 1 : (int)g_global_level;
+        n = snprintf(out + pos, cap - pos, " %s=%s%s", g_module_names[i], names[level],
+                     g_module_level[i] ? "" : "*");
+        if (n > 0) pos += (size_t)n;
+    }
+    pthread_mutex_unlock(&g_levels_mutex);
+    return pos < cap ? pos : cap - 1;
+}
+
+// --- Destinos ---
+
+// Escreve todo o buffer, mesmo que o kernel aceite apenas parte por vez
+static int write_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        data += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+static int stdout_sink_write(void* ctx, const char* data, size_t len) {
+    (void)ctx;
+    fflush(stdout); // Mantém a ordem com o que a aplicação imprimiu via printf
+    return write_all(STDOUT_FILENO, data, len);
+}
+
+typedef struct {
+    char* path;
+    int fd;
+    size_t size;   // Bytes no arquivo atual
+    time_t opened; // Início do arquivo atual (rotação por tempo)
+    LogFileOptions opts;
+} FileSink;
+
+static int file_sink_open(FileSink* f) {
+    f->fd = open(f->path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (f->fd < 0) return -1;
+    struct stat st;
+    f->size = (fstat(f->fd, &st) == 0) ? (size_t)st.st_size : 0;
+    f->opened = time(NULL);
+    return 0;
+}
+
+// Renomeia path para path.1 e os antigos para o número seguinte, até keep
+static void rotate_names(const char* path, unsigned keep) {
+    char from[4096];
+    char to[4096];
+    if (keep == 0) {
+        unlink(path);
+        return;
+    }
+    for (unsigned i = keep - 1; i >= 1; i--) {
+        snprintf(from, sizeof(from), "%s.%u", path, i);
+        snprintf(to, sizeof(to), "%s.%u", path, i + 1);
+        rename(from, to); // Pode ainda não existir
+    }
+    snprintf(to, sizeof(to), "%s.1", path);
+    rename(path, to);
+}
+
+// Rotaciona os nomes e abre um arquivo novo
+static int file_sink_rotate(FileSink* f) {
+    if (f->fd >= 0) {
+        if (f->opts.fsync != LOG_FSYNC_NEVER) fdatasync(f->fd);
+        close(f->fd);
+        f->fd = -1;
+    }
+    rotate_names(f->path, f->opts.keep);
+    return file_sink_open(f);
+}
+
+static int file_sink_write(void* ctx, const char* data, size_t len) {
+    FileSink* f = (FileSink*)ctx;
+    int by_size = f->opts.rotate_bytes && f->size > 0 && f->size + len > f->opts.rotate_bytes;
+    int by_time = f->opts.rotate_seconds && f->size > 0 &&
+                  time(NULL) - f->opened >= (time_t)f->opts.rotate_seconds;
+    if ((by_size || by_time || f->fd < 0) && file_sink_rotate(f) < 0) {
+        return -1;
+    }
+    if (write_all(f->fd, data, len) < 0) return -1;
+    f->size += len;
+    if (f->opts.fsync == LOG_FSYNC_ALWAYS) fdatasync(f->fd);
+    return 0;
+}
+
+static void file_sink_close(void* ctx) {
+    FileSink* f = (FileSink*)ctx;
+    if (f->fd >= 0) {
+        if (f->opts.fsync != LOG_FSYNC_NEVER) fdatasync(f->fd);
+        close(f->fd);
+    }
+    free(f->path);
+    free(f);
+}
+
+// Destino binário: segmentos pré-alocados, mapeados e preenchidos com memcpy
+typedef struct {
+    char* path;
+    LogBinaryOptions opts;
+    int fd;
+    char* map;   // Segmento atual, ou NULL
+    size_t used;
+    char* defs;  // Definições já vistas, repetidas no início de cada segmento
+    size_t defs_len;
+    size_t defs_cap;
+} BinSink;
+
+// Trunca o segmento ao tamanho usado e o fecha
+static void bin_sink_close_segment(BinSink* f) {
+    if (!f->map) return;
+    if (f->opts.fsync != LOG_FSYNC_NEVER) msync(f->map, f->used, MS_SYNC);
+    munmap(f->map, f->opts.segment_bytes);
+    f->map = NULL;
+    if (ftruncate(f->fd, (off_t)f->used) < 0) {
+        fprintf(stderr, "Aviso: falha ao truncar o segmento de log: %s\n", strerror(errno));
+    }
+    close(f->fd);
+    f->fd = -1;
+}
+
+// Rotaciona os nomes e abre um segmento novo com o cabeçalho e as definições
+static int bin_sink_open_segment(BinSink* f) {
+    if (f->defs_len > f->opts.segment_bytes - TSLOG_BIN_HEADER_SIZE) {
+        errno = EMSGSIZE; // As definições sozinhas não cabem em um segmento
+        return -1;
+    }
+    struct stat st;
+    if (stat(f->path, &st) == 0) rotate_names(f->path, f->opts.keep);
+
+    f->fd = open(f->path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (f->fd < 0) return -1;
+    // Reserva os blocos: escrever em um mapeamento sem espaço em disco
+    // mataria o processo com SIGBUS
+    int err = posix_fallocate(f->fd, 0, (off_t)f->opts.segment_bytes);
+    if (err != 0) { // Sem suporte no sistema de arquivos: fica esparso
+        err = ftruncate(f->fd, (off_t)f->opts.segment_bytes) == 0 ? 0 : errno;
+    }
+    void* map = err ? MAP_FAILED : mmap(NULL, f->opts.segment_bytes, PROT_READ | PROT_WRITE,
+                                        MAP_SHARED, f->fd, 0);
+    if (map == MAP_FAILED) {
+        int saved = err ? err : errno;
+        close(f->fd);
+        f->fd = -1;
+        errno = saved;
+        return -1;
+    }
+    f->map = (char*)map;
+
+    unsigned char* h = (unsigned char*)f->map;
+    uint32_t order = 0x01020304;
+    memcpy(h, TSLOG_BIN_MAGIC, 8);
+    memcpy(h + 8, &order, 4);
+    const unsigned char sizes[] = {
+        sizeof(int), sizeof(long), sizeof(long long), sizeof(size_t), sizeof(intmax_t),
+        sizeof(ptrdiff_t), sizeof(double), sizeof(long double), sizeof(void*)
+    };
+    memcpy(h + 12, sizes, sizeof(sizes));
+    if (f->defs_len > 0) memcpy(f->map + TSLOG_BIN_HEADER_SIZE, f->defs, f->defs_len);
+    f->used = TSLOG_BIN_HEADER_SIZE + f->defs_len;
+    return 0;
+}
+
+// Guarda uma cópia das definições que passam pelo destino
+static void bin_sink_keep_defs(BinSink* f, const char* data, size_t len) {
+    for (size_t off = 0; off + TSLOG_REC_HEADER_SIZE <= len; ) {
+        uint32_t size;
+        memcpy(&size, data + off, 4);
+        if (size < TSLOG_REC_HEADER_SIZE) break;
+        if (data[off + 4] == TSLOG_REC_DEFINE) {
+            if (f->defs_len + size > f->defs_cap) {
+                size_t cap = f->defs_cap ? f->defs_cap * 2 : 4096;
+                while (cap < f->defs_len + size) cap *= 2;
+                char* grown = (char*)realloc(f->defs, cap);
+                if (!grown) break;
+                f->defs = grown;
+                f->defs_cap = cap;
+            }
+            memcpy(f->defs + f->defs_len, data + off, size);
+            f->defs_len += size;
+        }
+        off += size;
+    }
+}
+
+static int bin_sink_write(void* ctx, const char* data, size_t len) {
+    BinSink* f = (BinSink*)ctx;
+    bin_sink_keep_defs(f, data, len);
+    if (!f->map && bin_sink_open_segment(f) < 0) return -1;
+
+    size_t start = f->used;
+    while (len > 0) {
+        // Copia de uma vez os registros inteiros que cabem no segmento
+        size_t run = 0;
+        while (run < len) {
+            uint32_t size;
+            memcpy(&size, data + run, 4);
+            if (f->used + run + size > f->opts.segment_bytes) break;
+            run += size;
+        }
+        memcpy(f->map + f->used, data, run);
+        f->used += run;
+        data += run;
+        len -= run;
+        if (len == 0) break;
+
+        bin_sink_close_segment(f);
+        if (bin_sink_open_segment(f) < 0) return -1;
+        start = 0;
+        uint32_t size;
+        memcpy(&size, data, 4);
+        if (f->used + size > f->opts.segment_bytes) {
+            errno = EMSGSIZE; // Nem um segmento novo comporta o registro
+            return -1;
+        }
+    }
+    if (f->opts.fsync == LOG_FSYNC_ALWAYS) {
+        // msync exige endereço alinhado à página
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t from = start & ~(page - 1);
+        msync(f->map + from, f->used - from, MS_SYNC);
+    }
+    return 0;
+}
+
+static void bin_sink_close(void* ctx) {
+    BinSink* f = (BinSink*)ctx;
+    bin_sink_close_segment(f);
+    free(f->defs);
+    free(f->path);
+    free(f);
+}
+
+int logger_add_sink(const LogSink* sink) {
+    if (g_logger != NULL || g_num_sinks == TSLOG_MAX_SINKS) {
+        errno = EBUSY;
+        return -1;
+    }
+    g_sinks[g_num_sinks++] = *sink;
+    return 0;
+}
+
+int logger_add_stdout_sink(void) {
+    LogSink sink = { stdout_sink_write, NULL, NULL, LOG_FORMAT_TEXT };
+    return logger_add_sink(&sink);
+}
+
+int logger_add_file_sink(const char* path, const LogFileOptions* opts) {
+    FileSink* f = (FileSink*)calloc(1, sizeof(FileSink));
+    if (!f || !(f->path = strdup(path))) {
+        free(f);
+        errno = ENOMEM;
+        return -1;
+    }
+    if (opts) f->opts = *opts;
+    LogSink sink = { file_sink_write, file_sink_close, f, LOG_FORMAT_TEXT };
+    if (file_sink_open(f) < 0 || logger_add_sink(&sink) < 0) {
+        int saved = errno;
+        file_sink_close(f);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+int logger_add_binary_sink(const char* path, const LogBinaryOptions* opts) {
+    BinSink* f = (BinSink*)calloc(1, sizeof(BinSink));
+    if (!f || !(f->path = strdup(path))) {
+        free(f);
+        errno = ENOMEM;
+        return -1;
+    }
+    f->fd = -1;
+    if (opts) f->opts = *opts;
+    if (f->opts.segment_bytes == 0) f->opts.segment_bytes = TSLOG_BIN_SEGMENT_DEFAULT;
+    if (f->opts.segment_bytes < TSLOG_BIN_SEGMENT_MIN) f->opts.segment_bytes = TSLOG_BIN_SEGMENT_MIN;
+    LogSink sink = { bin_sink_write, bin_sink_close, f, LOG_FORMAT_BINARY };
+    if (bin_sink_open_segment(f) < 0 || logger_add_sink(&sink) < 0) {
+        int saved = errno;
+        bin_sink_close(f);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+void logger_set_flush_interval(unsigned ms) {
+    g_flush_ms = ms;
+}
+
+int logger_set_thread_buffers(size_t slots) {
+    if (g_logger != NULL) {
+        errno = EBUSY;
+        return -1;
+    }
+    if (slots == 1 || (slots & (slots - 1)) != 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    g_thread_slots = slots;
+    return 0;
+}
+
+// --- Thread de escrita ---
+
+// Entrega o lote a todos os destinos, uma escrita por destino
+static void batch_flush(LogBatch* b) {
+    for (size_t i = 0; i < g_num_sinks; i++) {
+        int binary = g_sinks[i].format == LOG_FORMAT_BINARY;
+        size_t len = binary ? b->bin_len : b->len;
+        if (len > 0 && g_sinks[i].write(g_sinks[i].ctx, binary ? b->bin : b->data, len) < 0) {
+            fprintf(stderr, "Aviso: falha ao gravar o log: %s\n", strerror(errno));
         }
+    }
+    b->len = 0;
+    b->bin_len = 0;
+}
+
+static int batch_pending(const LogBatch* b) {
+    return b->len > 0 || b->bin_len > 0;
+}
+
+// Grava o lote antes que ele fique sem espaço para a maior linha possível
+// (no formato binário, uma definição e um evento)
+static void batch_make_room(LogBatch* b) {
+    if (b->len + TSLOG_PREFIX_MAX + TSLOG_LINE_MAX + 1 > sizeof(b->data) ||
+        b->bin_len + 2 * (TSLOG_REC_HEADER_SIZE + TSLOG_LINE_MAX) > sizeof(b->bin)) {
+        batch_flush(b);
+    }
+}
+
+// Com intervalo de flush, a primeira linha do lote marca o prazo
+static void batch_start(LogBatch* b) {
+    if (g_flush_ms && !batch_pending(b)) {
+        clock_gettime(CLOCK_MONOTONIC, &b->deadline);
+        timespec_add_ms(&b->deadline, g_flush_ms);
+    }
+}
+
+// Acrescenta ao lote binário um registro com o payload dado
+static void bin_append(LogBatch* b, uint8_t type, LogLevel level, uint16_t flags, uint32_t event,
+                       int32_t tid, int64_t time_ns, const char* payload, size_t len) {
+    char* out = b->bin + b->bin_len;
+    uint32_t size = (uint32_t)(TSLOG_REC_HEADER_SIZE + len);
+    memcpy(out, &size, 4);
+    out[4] = (char)type;
+    out[5] = (char)level;
+    memcpy(out + 6, &flags, 2);
+    memcpy(out + 8, &event, 4);
+    memcpy(out + 12, &tid, 4);
+    memcpy(out + 16, &time_ns, 8);
+    memcpy(out + TSLOG_REC_HEADER_SIZE, payload, len);
+    b->bin_len += size;
+}
+
+static size_t event_slot(const EventId* events, size_t cap, const char* fmt) {
+    size_t i = (size_t)(((uintptr_t)fmt >> 3) * 0x9E3779B97F4A7C15ull) & (cap - 1);
+    while (events[i].fmt && events[i].fmt != fmt) i = (i + 1) & (cap - 1);
+    return i;
+}
+
+// ID do formato no fluxo binário; no primeiro uso, grava sua definição.
+// Retorna 0 se o formato não puder ser definido (grande demais ou sem memória).
+static uint32_t event_id(LogBatch* b, const char* fmt) {
+    if ((b->num_events + 1) * 2 > b->events_cap) {
+        size_t cap = b->events_cap ? b->events_cap * 2 : 64;
+        EventId* grown = (EventId*)calloc(cap, sizeof(EventId));
+        if (!grown) return 0;
+        for (size_t i = 0; i < b->events_cap; i++) {
+            if (b->events[i].fmt) grown[event_slot(grown, cap, b->events[i].fmt)] = b->events[i];
+        }
+        free(b->events);
+        b->events = grown;
+        b->events_cap = cap;
+    }
+    size_t i = event_slot(b->events, b->events_cap, fmt);
+    if (b->events[i].fmt) return b->events[i].id;
 
-        char time_buf[100];
-        struct timeval tv;
-        gettimeofday(&tv, NULL);
+    size_t len = strlen(fmt);
+    if (len > TSLOG_LINE_MAX) return 0;
+    b->events[i].fmt = fmt;
+    b->events[i].id = ++b->num_events;
+    bin_append(b, TSLOG_REC_DEFINE, INFO, 0, b->events[i].id, 0, 0, fmt, len);
+    return b->events[i].id;
+}
+
+// Acrescenta ao lote binário o evento de uma posição do anel, com os
+// argumentos de logger_logf() ainda codificados
+static void bin_append_slot(LogBatch* b, const LogSlot* slot) {
+    if (!slot->fmt) {
+        bin_append(b, TSLOG_REC_EVENT, (LogLevel)slot->level, 0, 0, slot->tid, slot->time_ns,
+                   slot->text, slot->len);
+        return;
+    }
+    uint32_t event = event_id(b, slot->fmt);
+    if (event == 0) {
+        size_t len = format_slot(slot, b->scratch, sizeof(b->scratch));
+        bin_append(b, TSLOG_REC_EVENT, (LogLevel)slot->level, 0, 0, slot->tid, slot->time_ns,
+                   b->scratch, len);
+        return;
+    }
+    uint16_t flags = (slot->flags & SLOT_TRUNCATED) ? TSLOG_REC_TRUNCATED : 0;
+    bin_append(b, TSLOG_REC_EVENT, (LogLevel)slot->level, flags, event, slot->tid, slot->time_ns,
+               slot->text, slot->len);
+}
+
+// Escreve no lote o prefixo "[data hora.ms] [thread] [NÍVEL] " de uma nova
+// linha e retorna seu tamanho. O chamador completa a linha e avança len.
+static size_t batch_prefix(LogBatch* b, LogLevel level, int64_t time_ns, int32_t tid) {
+    // Data e hora só são formatadas quando o segundo muda
+    time_t sec = (time_t)(time_ns / 1000000000);
+    if (sec != b->cached_sec) {
         struct tm tm_info;
-        localtime_r(&tv.tv_sec, &tm_info);
-        strftime(time_buf, sizeof(time_buf) - 1, "%Y-%m-%d %H:%M:%S", &tm_info);
-        
-        // Imprime o log formatado no stdout
-        printf("[%s.%03ld] [%ld] [%s] %s\n",
-               time_buf, tv.tv_usec / 1000,
-               (long)pthread_self(), // ID da thread
-               level_to_string(entry->level),
-               entry->message);
-        fflush(stdout);
-
-        free(entry->message);
-        free(entry);
+        localtime_r(&sec, &tm_info);
+        strftime(b->cached_time, sizeof(b->cached_time), "%Y-%m-%d %H:%M:%S", &tm_info);
+        b->cached_sec = sec;
+    }
+
+    int n = snprintf(b->data + b->len, TSLOG_PREFIX_MAX, "[%s.%03d] [%d] [%s] ",
+                     b->cached_time, (int)(time_ns % 1000000000 / 1000000), (int)tid,
+                     level_to_string(level));
+    return (n > 0 && n < TSLOG_PREFIX_MAX) ? (size_t)n : 0;
+}
+
+// Acrescenta ao lote a linha de uma posição do anel
+static void batch_append(LogBatch* b, const LogSlot* slot) {
+    batch_start(b);
+    if (b->has_binary) bin_append_slot(b, slot);
+    if (!b->has_text) return;
+
+    size_t len = batch_prefix(b, (LogLevel)slot->level, slot->time_ns, slot->tid);
+    char* out = b->data + b->len;
+    if (slot->fmt) {
+        len += format_slot(slot, out + len, TSLOG_LINE_MAX);
+    } else {
+        memcpy(out + len, slot->text, slot->len);
+        len += slot->len;
+    }
+    out[len++] = '\n';
+    b->len += len;
+}
+
+// Acrescenta ao lote uma linha gerada pelo próprio logger
+static void batch_append_text(LogBatch* b, LogLevel level, const char* text, size_t text_len) {
+    batch_make_room(b);
+    batch_start(b);
+    int64_t time_ns = now_ns();
+    if (b->has_binary) {
+        bin_append(b, TSLOG_REC_EVENT, level, 0, 0, b->tid, time_ns, text, text_len);
+    }
+    if (!b->has_text) return;
+
+    size_t len = batch_prefix(b, level, time_ns, b->tid);
+    char* out = b->data + b->len;
+    memcpy(out + len, text, text_len);
+    len += text_len;
+    out[len++] = '\n';
+    b->len += len;
+}
+
+// Soma os contadores de todas as filas. Fora da thread de escrita, exige
+// threads_mutex (que impede a liberação de anéis durante o percurso).
+static void sum_counters(Logger* lg, LogStats* st) {
+    st->dropped = lg->retired_dropped + atomic_load(&lg->ring.dropped);
+    st->blocked = lg->retired_blocked + atomic_load(&lg->ring.blocked);
+    st->high_water = lg->retired_high_water;
+    size_t hw = atomic_load(&lg->ring.high_water);
+    if (hw > st->high_water) st->high_water = hw;
+    ThreadRing* tr = atomic_load_explicit(&lg->threads, memory_order_acquire);
+    for (; tr; tr = tr->next) {
+        st->dropped += atomic_load(&tr->ring.dropped);
+        st->blocked += atomic_load(&tr->ring.blocked);
+        hw = atomic_load(&tr->ring.high_water);
+        if (hw > st->high_water) st->high_water = hw;
+    }
+}
+
+// Resume no log os descartes ainda não informados, no máximo uma vez a
+// cada TSLOG_DROP_REPORT_SECS (ou já, com force)
+static void report_drops(LogBatch* b, unsigned long long dropped, const struct timespec* now, int force) {
+    if (dropped == b->reported_dropped) return;
+    if (!force && !timespec_passed(now, &b->next_report)) return;
+
+    char text[128];
+    int n = snprintf(text, sizeof(text), "%llu mensagens de log descartadas (fila cheia)",
+                     dropped - b->reported_dropped);
+    if (n > 0) batch_append_text(b, WARNING, text, (size_t)n);
+    b->reported_dropped = dropped;
+    b->next_report = *now;
+    timespec_add_ms(&b->next_report, TSLOG_DROP_REPORT_SECS * 1000);
+}
+
+// Registra a maior ocupação da fila vista pelo consumidor
+static void sample_high_water(LogRing* r, size_t taken_pos) {
+    size_t used = atomic_load_explicit(&r->tail, memory_order_relaxed) - taken_pos;
+    if (used > atomic_load_explicit(&r->high_water, memory_order_relaxed)) {
+        atomic_store_explicit(&r->high_water, used, memory_order_relaxed);
+    }
+}
+
+// Filas com mensagens prontas, intercaladas pela thread de escrita
+typedef struct {
+    LogRing** rings;
+    size_t count;
+    size_t cap;
+} MergeSet;
+
+static void merge_add(MergeSet* m, LogRing* r) {
+    if (m->count == m->cap) {
+        size_t cap = m->cap ? m->cap * 2 : 16;
+        LogRing** grown = (LogRing**)realloc(m->rings, cap * sizeof(LogRing*));
+        if (!grown) return; // Fica para a próxima coleta
+        m->rings = grown;
+        m->cap = cap;
+    }
+    m->rings[m->count++] = r;
+}
+
+// Junta em m as filas com mensagens prontas e libera os anéis, já vazios,
+// de threads que terminaram. Só a thread de escrita remove anéis da lista
+// (nunca o primeiro, que os produtores podem estar trocando), então ela a
+// percorre sem lock.
+static void merge_collect(Logger* lg, MergeSet* m) {
+    m->count = 0;
+    if (ring_peek(&lg->ring)) merge_add(m, &lg->ring);
+
+    ThreadRing* prev = NULL;
+    ThreadRing* tr = atomic_load_explicit(&lg->threads, memory_order_acquire);
+    while (tr) {
+        ThreadRing* next = tr->next;
+        if (ring_peek(&tr->ring)) {
+            merge_add(m, &tr->ring);
+        } else if (prev && atomic_load_explicit(&tr->closed, memory_order_acquire) &&
+                   !ring_peek(&tr->ring)) {
+            pthread_mutex_lock(&lg->threads_mutex);
+            prev->next = next;
+            lg->retired_dropped += atomic_load(&tr->ring.dropped);
+            lg->retired_blocked += atomic_load(&tr->ring.blocked);
+            size_t hw = atomic_load(&tr->ring.high_water);
+            if (hw > lg->retired_high_water) lg->retired_high_water = hw;
+            pthread_mutex_unlock(&lg->threads_mutex);
+            ring_destroy(&tr->ring);
+            free(tr);
+            tr = next;
+            continue;
+        }
+        prev = tr;
+        tr = next;
+    }
+}
+
+// Retira, entre as filas de m, a mensagem pronta de menor horário. As
+// filas que esvaziam saem de m.
+static LogSlot* merge_take(MergeSet* m, LogRing** from, size_t* pos) {
+    while (m->count > 0) {
+        size_t best = 0;
+        if (m->count > 1) {
+            int64_t best_ns = 0;
+            best = SIZE_MAX;
+            for (size_t i = 0; i < m->count; ) {
+                LogSlot* slot = ring_peek(m->rings[i]);
+                if (!slot) {
+                    m->rings[i] = m->rings[--m->count];
+                    continue;
+                }
+                if (best == SIZE_MAX || slot->time_ns < best_ns) {
+                    best = i;
+                    best_ns = slot->time_ns;
+                }
+                i++;
+            }
+            if (best == SIZE_MAX) return NULL;
+        }
+        LogSlot* slot = ring_take(m->rings[best], pos);
+        if (slot) {
+            *from = m->rings[best];
+            return slot;
+        }
+        m->rings[best] = m->rings[--m->count];
     }
     return NULL;
 }
 
+// Indica se alguma fila tem mensagem pronta (apenas na thread de escrita)
+static int any_ready(Logger* lg) {
+    if (ring_peek(&lg->ring)) return 1;
+    ThreadRing* tr = atomic_load_explicit(&lg->threads, memory_order_acquire);
+    for (; tr; tr = tr->next) {
+        if (ring_peek(&tr->ring)) return 1;
+    }
+    return 0;
+}
+
+// Dorme até um produtor publicar algo, o logger ser finalizado ou, se
+// deadline não for NULL, o prazo (CLOCK_MONOTONIC) vencer
+static void logger_wait(Logger* lg, const struct timespec* deadline) {
+    atomic_store(&lg->sleeping, 1);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (any_ready(lg) || !atomic_load(&lg->running)) {
+        atomic_store(&lg->sleeping, 0);
+        return;
+    }
+    pthread_mutex_lock(&lg->mutex);
+    while (atomic_load(&lg->sleeping) && atomic_load(&lg->running)) {
+        if (!deadline) {
+            pthread_cond_wait(&lg->cond, &lg->mutex);
+        } else if (pthread_cond_timedwait(&lg->cond, &lg->mutex, deadline) == ETIMEDOUT) {
+            atomic_store(&lg->sleeping, 0);
+            break;
+        }
+    }
+    pthread_mutex_unlock(&lg->mutex);
+}
+
+// No encerramento com prazo vencido, descarta o que restou nas filas
+static int drain_expired(Logger* lg) {
+    if (!lg->has_drain_deadline || atomic_load(&lg->running)) return 0;
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!timespec_passed(&now, &lg->drain_deadline)) return 0;
+
+    MergeSet m = { NULL, 0, 0 };
+    LogRing* from;
+    size_t pos;
+    LogSlot* slot;
+    merge_collect(lg, &m);
+    while ((slot = merge_take(&m, &from, &pos)) != NULL) {
+        ring_release(from, slot, pos);
+        atomic_fetch_add_explicit(&from->dropped, 1, memory_order_relaxed);
+    }
+    free(m.rings);
+    return 1;
+}
+
+// Função executada pela thread de escrita: formata no lote tudo o que
+// estiver nas filas, intercaladas pelo horário das mensagens, e o grava
+// quando elas esvaziam (ou, com intervalo de flush, quando o prazo vence ou
+// o buffer enche), depois volta a dormir
+static void* writer_thread_func(void* arg) {
+    Logger* lg = (Logger*)arg;
+    LogBatch* b = &lg->batch;
+    b->len = 0;
+    b->bin_len = 0;
+    b->has_text = 0;
+    b->has_binary = 0;
+    for (size_t i = 0; i < g_num_sinks; i++) {
+        if (g_sinks[i].format == LOG_FORMAT_BINARY) {
+            b->has_binary = 1;
+        } else {
+            b->has_text = 1;
+        }
+    }
+    b->events = NULL;
+    b->events_cap = 0;
+    b->num_events = 0;
+    b->cached_sec = (time_t)-1;
+    b->tid = current_tid();
+    b->reported_dropped = 0;
+    b->next_report.tv_sec = 0;
+    b->next_report.tv_nsec = 0;
+
+    MergeSet m = { NULL, 0, 0 };
+    unsigned long taken = 0;
+    unsigned since_collect = 0;
+    int woke = 1;
+    for (;;) {
+        batch_make_room(b); // Nenhuma posição fica retida durante a escrita
+        // Refaz o conjunto ao esvaziar e, periodicamente, para que uma
+        // thread muito ativa não atrase as demais
+        if (m.count == 0 || since_collect >= 64) {
+            merge_collect(lg, &m);
+            since_collect = 0;
+        }
+        LogRing* from;
+        size_t pos;
+        LogSlot* slot = merge_take(&m, &from, &pos);
+        if (slot != NULL) {
+            if (woke || (taken & 63) == 0) sample_high_water(from, pos);
+            woke = 0;
+            batch_append(b, slot);
+            ring_release(from, slot, pos);
+            atomic_fetch_add_explicit(&lg->written, 1, memory_order_relaxed);
+            since_collect++;
+            if ((++taken & 63) == 0) drain_expired(lg);
+            continue;
+        }
+        if (since_collect > 0) {
+            since_collect = 64; // Confere as demais filas antes de dormir
+            continue;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        int running = atomic_load(&lg->running);
+        LogStats st;
+        sum_counters(lg, &st);
+        report_drops(b, st.dropped, &now, !running);
+        if (batch_pending(b) && (g_flush_ms == 0 || !running || timespec_passed(&now, &b->deadline))) {
+            batch_flush(b);
+        }
+        if (!running && (!any_ready(lg) || drain_expired(lg))) {
+            break; // Finalizando e as filas estão vazias (ou o prazo venceu)
+        }
+
+        // Acorda pela próxima mensagem ou pelo prazo do lote pendente ou
+        // do próximo resumo de descartes
+        const struct timespec* deadline = batch_pending(b) ? &b->deadline : NULL;
+        if (st.dropped != b->reported_dropped &&
+            (!deadline || !timespec_passed(&b->next_report, deadline))) {
+            deadline = &b->next_report;
+        }
+        logger_wait(lg, deadline);
+        woke = 1;
+    }
+    free(m.rings);
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    LogStats st;
+    sum_counters(lg, &st);
+    report_drops(b, st.dropped, &now, 1); // Inclui o que foi descartado no encerramento
+    batch_flush(b);
+    free(b->events);
+
+    pthread_mutex_lock(&lg->mutex);
+    lg->writer_done = 1;
+    pthread_cond_broadcast(&lg->done_cond);
+    pthread_mutex_unlock(&lg->mutex);
+    return NULL;
+}
+
+void logger_set_overflow(LogOverflow policy, LogLevel min_level) {
+    atomic_store(&g_overflow_level, (int)min_level);
+    atomic_store(&g_overflow, (int)policy);
+}
+
+void logger_stats(LogStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    if (g_logger == NULL) return;
+    pthread_mutex_lock(&g_logger->threads_mutex);
+    sum_counters(g_logger, stats);
+    pthread_mutex_unlock(&g_logger->threads_mutex);
+    stats->written = atomic_load(&g_logger->written);
+    stats->capacity = g_logger->thread_slots ? g_logger->thread_slots : TSLOG_RING_SLOTS;
+}
+
 void logger_init() {
     if (g_logger != NULL) return; // Já inicializado
+    if (g_num_sinks == 0) logger_add_stdout_sink();
 
-    g_logger = (Logger*)malloc(sizeof(Logger));
-    g_logger->running = 1;
-    queue_init(&g_logger->queue);
-    pthread_create(&g_logger->writer_thread, NULL, writer_thread_func, NULL);
+    Logger* lg = (Logger*)calloc(1, sizeof(Logger));
+    if (!lg || ring_init(&lg->ring, TSLOG_RING_SLOTS) != 0 ||
+        (g_thread_slots && pthread_key_create(&lg->thread_key, thread_ring_close) != 0)) {
+        perror("Falha ao alocar o logger");
+        if (lg) free(lg->ring.slots);
+        free(lg);
+        return;
+    }
+    lg->thread_slots = g_thread_slots;
+    atomic_init(&lg->threads, NULL);
+    atomic_init(&lg->running, 1);
+    atomic_init(&lg->sleeping, 0);
+    atomic_init(&lg->written, 0);
+    pthread_mutex_init(&lg->mutex, NULL);
+    pthread_mutex_init(&lg->threads_mutex, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC); // Prazos do flush e do encerramento
+    pthread_cond_init(&lg->cond, &attr);
+    pthread_cond_init(&lg->done_cond, &attr);
+    pthread_condattr_destroy(&attr);
+    g_logger = lg;
+    pthread_create(&lg->writer_thread, NULL, writer_thread_func, lg);
 }
 
 void logger_destroy() {
-    if (g_logger == NULL) return;
+    logger_destroy_timeout(0);
+}
+
+void logger_destroy_timeout(unsigned timeout_ms) {
+    Logger* lg = g_logger;
+    if (lg == NULL || !atomic_load(&lg->running)) return;
+
+    if (timeout_ms) {
+        clock_gettime(CLOCK_MONOTONIC, &lg->drain_deadline);
+        timespec_add_ms(&lg->drain_deadline, timeout_ms);
+        lg->has_drain_deadline = 1; // Publicado pela escrita atômica de running
+    }
+    atomic_store(&lg->running, 0);
 
-    g_logger->running = 0;
-    
     // Acorda a thread de escrita para que ela possa verificar a flag 'running' e sair
-    pthread_mutex_lock(&g_logger->queue.mutex);
-    pthread_cond_broadcast(&g_logger->queue.cond);
-    pthread_mutex_unlock(&g_logger->queue.mutex);
+    pthread_mutex_lock(&lg->mutex);
+    pthread_cond_broadcast(&lg->cond);
+    if (timeout_ms) {
+        struct timespec limit = lg->drain_deadline;
+        timespec_add_ms(&limit, TSLOG_ABANDON_GRACE_MS);
+        while (!lg->writer_done &&
+               pthread_cond_timedwait(&lg->done_cond, &lg->mutex, &limit) != ETIMEDOUT) {
+        }
+    }
+    int done = !timeout_ms || lg->writer_done;
+    pthread_mutex_unlock(&lg->mutex);
+
+    if (!done) {
+        // Presa em um destino bloqueado: fica com seus recursos, e o
+        // logger continua marcado como encerrado
+        fprintf(stderr, "Aviso: o log não terminou de ser gravado no prazo.\n");
+        pthread_detach(lg->writer_thread);
+        return;
+    }
+    pthread_join(lg->writer_thread, NULL);
 
-    pthread_join(g_logger->writer_thread, NULL);
+    for (size_t i = 0; i < g_num_sinks; i++) {
+        if (g_sinks[i].close) g_sinks[i].close(g_sinks[i].ctx);
+    }
+    g_num_sinks = 0;
+    g_flush_ms = 0;
+    g_thread_slots = 0;
 
-    queue_destroy(&g_logger->queue);
-    free(g_logger);
+    // Threads ainda vivas não chamam mais o destrutor da chave
+    if (lg->thread_slots) pthread_key_delete(lg->thread_key);
+    ThreadRing* tr = atomic_load(&lg->threads);
+    while (tr) {
+        ThreadRing* next = tr->next;
+        ring_destroy(&tr->ring);
+        free(tr);
+        tr = next;
+    }
+    pthread_mutex_destroy(&lg->threads_mutex);
+    pthread_mutex_destroy(&lg->mutex);
+    pthread_cond_destroy(&lg->cond);
+    pthread_cond_destroy(&lg->done_cond);
+    ring_destroy(&lg->ring);
+    free(lg);
     g_logger = NULL;
 }
 
 void logger_log(LogLevel level, const char* message) {
-    if (g_logger == NULL || !g_logger->running) {
+    if (g_logger == NULL || !atomic_load_explicit(&g_logger->running, memory_order_relaxed)) {
+        fprintf(stderr, "Aviso: logger_log chamado antes de logger_init ou após logger_destroy.\n");
+        return;
+    }
+    ring_push(g_logger, level, message, strlen(message));
+}
+
+void logger_log_ref(LogLevel level, const char* message, size_t len,
+                    void (*release)(void* ctx), void* ctx) {
+    if (g_logger == NULL || !atomic_load_explicit(&g_logger->running, memory_order_relaxed)) {
+        fprintf(stderr, "Aviso: logger_log chamado antes de logger_init ou após logger_destroy.\n");
+        release(ctx);
+        return;
+    }
+    ring_push(g_logger, level, message, len);
+    release(ctx);
+}
+
+void logger_logf(LogLevel level, const char* fmt, ...) {
+    if (g_logger == NULL || !atomic_load_explicit(&g_logger->running, memory_order_relaxed)) {
         fprintf(stderr, "Aviso: logger_log chamado antes de logger_init ou após logger_destroy.\n");
         return;
     }
-    queue_push(&g_logger->queue, level, message);
-}
\ No newline at end of file
+    int64_t time_ns = now_ns();
+    size_t pos;
+    LogSlot* slot = ring_reserve(g_logger, producer_ring(g_logger), level, &pos);
+    if (!slot) return; // Descartada pela política de fila cheia
+
+    // Os argumentos são gravados direto na posição reservada
+    ArgWriter w = { slot->text, 0, 0 };
+    va_list ap;
+    va_start(ap, fmt);
+    encode_args(&w, fmt, ap);
+    va_end(ap);
+
+    slot->level = (uint16_t)level;
+    slot->flags = w.full ? SLOT_TRUNCATED : 0;
+    slot->len = (uint32_t)w.len;
+    slot->fmt = fmt;
+    ring_publish(g_logger, slot, pos, time_ns, current_tid());
+}
\ No newline at end of file
@@ -3,14 +3,263 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdatomic.h>
 
 // níveis de log
 typedef enum {
     INFO,
     WARNING,
-    ERROR
+    ERROR,
+    LOG_OFF // Apenas como limite: nenhuma mensagem passa
 } LogLevel;
 
+// Nível mínimo compilado: chamadas às macros LOG_* abaixo dele viram código
+// morto, eliminado pelo compilador (ex.: -DTSLOG_MIN_LEVEL=WARNING)
+#ifndef TSLOG_MIN_LEVEL
+#define TSLOG_MIN_LEVEL INFO
+#endif
+
+// Módulo usado pelas macros LOG_* de um arquivo. Para mudá-lo, defina
+// TSLOG_MODULE antes de incluir este cabeçalho.
+#ifndef TSLOG_MODULE
+#define TSLOG_MODULE 0
+#endif
+
+#define TSLOG_MAX_MODULES 16
+
+// Nível mínimo efetivo de cada módulo; use logger_enabled()
+extern atomic_uchar g_tslog_min_level[TSLOG_MAX_MODULES];
+
+/**
+ * @brief Indica se mensagens de level do módulo passam pelo filtro.
+ *
+ * Custa uma única leitura atômica relaxada; as macros LOG_* a fazem antes
+ * de avaliar os argumentos.
+ */
+static inline int logger_enabled(int module, LogLevel level) {
+    return (int)level >= (int)atomic_load_explicit(&g_tslog_min_level[module], memory_order_relaxed);
+}
+
+/**
+ * @brief Dá nome a um módulo (1 a TSLOG_MAX_MODULES - 1; 0 é o padrão),
+ *        para ajustá-lo por logger_set_levels().
+ * @return 0 em sucesso, -1 se module estiver fora do intervalo.
+ */
+int logger_name_module(int module, const char* name);
+
+/**
+ * @brief Define o nível mínimo global, seguido pelos módulos sem nível próprio.
+ *
+ * Pode ser chamada a qualquer momento, de qualquer thread.
+ */
+void logger_set_level(LogLevel level);
+
+/**
+ * @brief Define o nível mínimo de um módulo, ou -1 para seguir o global.
+ * @return 0 em sucesso, -1 se os argumentos forem inválidos.
+ */
+int logger_set_module_level(int module, int level);
+
+/**
+ * @brief Ajusta níveis a partir de um texto como "warning" ou
+ *        "info,net=error,history=default".
+ *
+ * Itens sem '=' definem o nível global; "modulo=nivel" define o de um
+ * módulo nomeado, e "default" o faz voltar a seguir o global. Os níveis são
+ * info, warning, error e off. Nada é alterado se algum item for inválido.
+ * @return 0 em sucesso, -1 em erro.
+ */
+int logger_set_levels(const char* spec);
+
+/**
+ * @brief Descreve os níveis atuais em out, como "global=info chat=info* net=error"
+ *        (com '*', o módulo segue o nível global).
+ * @return O tamanho do texto (truncado em cap - 1).
+ */
+size_t logger_format_levels(char* out, size_t cap);
+
+// Formato entregue a um destino
+typedef enum {
+    LOG_FORMAT_TEXT,  // Linhas "[data hora.ms] [thread] [NÍVEL] mensagem"
+    LOG_FORMAT_BINARY // Registros binários (veja "Formato binário" abaixo)
+} LogFormat;
+
+/**
+ * @brief Destino das linhas de log.
+ *
+ * A thread de escrita junta as linhas prontas em um buffer grande e entrega
+ * cada lote a write() de uma vez, sempre terminando em '\n' (ou, no
+ * formato binário, em um registro completo). As funções são chamadas
+ * apenas pela thread de escrita. Sem nenhum destino de texto, as mensagens
+ * nem chegam a ser formatadas.
+ */
+typedef struct {
+    int (*write)(void* ctx, const char* data, size_t len); // 0 ou -1
+    void (*close)(void* ctx);                             // Opcional
+    void* ctx;
+    LogFormat format;
+} LogSink;
+
+#define TSLOG_MAX_SINKS 4
+
+// Quando os arquivos de log são sincronizados com o disco (fdatasync)
+typedef enum {
+    LOG_FSYNC_NEVER,  // Fica a cargo do sistema operacional
+    LOG_FSYNC_ROTATE, // Ao rotacionar e ao finalizar o logger
+    LOG_FSYNC_ALWAYS  // Após cada lote gravado
+} LogFsync;
+
+typedef struct {
+    size_t rotate_bytes;     // Rotaciona ao passar deste tamanho (0 = nunca)
+    unsigned rotate_seconds; // Rotaciona após este intervalo (0 = nunca)
+    unsigned keep;           // Arquivos antigos mantidos: path.1 ... path.keep
+    LogFsync fsync;
+} LogFileOptions;
+
+/**
+ * @brief Acrescenta um destino para as linhas de log.
+ *
+ * Os destinos devem ser configurados antes de logger_init(); sem nenhum,
+ * o logger escreve no stdout. logger_destroy() chama close() de cada um e
+ * limpa a configuração.
+ * @return 0 em sucesso, -1 se o limite foi atingido ou o logger já está ativo.
+ */
+int logger_add_sink(const LogSink* sink);
+
+/**
+ * @brief Acrescenta o stdout como destino.
+ */
+int logger_add_stdout_sink(void);
+
+/**
+ * @brief Acrescenta um arquivo como destino, aberto para acréscimo.
+ *
+ * A rotação acontece na thread de escrita, antes do lote que ultrapassaria
+ * o limite: path vira path.1, path.1 vira path.2 e assim por diante até
+ * opts->keep (com keep = 0 o arquivo antigo é apagado). Os produtores
+ * nunca esperam por ela. Com opts = NULL não há rotação nem fsync.
+ * @return 0 em sucesso, -1 em erro (errno indica a causa).
+ */
+int logger_add_file_sink(const char* path, const LogFileOptions* opts);
+
+/*
+ * Formato binário
+ *
+ * Um destino LOG_FORMAT_BINARY recebe uma sequência de registros, na ordem
+ * de bytes da máquina:
+ *
+ *   uint32 size    Tamanho do registro, incluindo este campo
+ *   uint8  type    TSLOG_REC_EVENT ou TSLOG_REC_DEFINE
+ *   uint8  level
+ *   uint16 flags   TSLOG_REC_TRUNCATED: faltaram argumentos
+ *   uint32 event   0 = texto pronto; senão, o ID do formato
+ *   int32  tid
+ *   int64  time_ns Nanossegundos desde 1970 (0 em TSLOG_REC_DEFINE)
+ *   ...            Texto, argumentos de logger_logf() ou o formato definido
+ *
+ * Um TSLOG_REC_DEFINE associa um ID ao formato de logger_logf() e vem
+ * antes do primeiro evento que o usa. Os argumentos são gravados como na
+ * fila: os valores na representação da máquina e as strings como um
+ * uint32 de tamanho (UINT32_MAX para NULL) seguido dos bytes.
+ *
+ * Cada segmento de logger_add_binary_sink() começa com um cabeçalho de
+ * TSLOG_BIN_HEADER_SIZE bytes: TSLOG_BIN_MAGIC, o uint32 0x01020304 (ordem
+ * de bytes) e os tamanhos de int, long, long long, size_t, intmax_t,
+ * ptrdiff_t, double, long double e void* (um byte cada), completados com
+ * zeros. Em seguida vêm as definições em uso e os registros; um size 0
+ * marca o fim (resto de um segmento que não foi fechado).
+ */
+#define TSLOG_BIN_MAGIC "TSLOGB1\n"
+#define TSLOG_BIN_HEADER_SIZE 32
+#define TSLOG_REC_HEADER_SIZE 24
+#define TSLOG_REC_EVENT 1
+#define TSLOG_REC_DEFINE 2
+#define TSLOG_REC_TRUNCATED 0x1
+
+typedef struct {
+    size_t segment_bytes; // Tamanho de cada segmento (0 = 16 MB; mínimo 1 MB)
+    unsigned keep;        // Segmentos antigos mantidos: path.1 ... path.keep
+    LogFsync fsync;
+} LogBinaryOptions;
+
+/**
+ * @brief Acrescenta um destino binário gravado em segmentos mapeados em memória.
+ *
+ * O segmento atual é path, pré-alocado com segment_bytes e preenchido com
+ * memcpy; ao encher, é truncado ao tamanho usado e renomeado para path.1
+ * (como na rotação de logger_add_file_sink()). Um arquivo path existente
+ * é rotacionado na abertura. Cada segmento pode ser lido sozinho pelo
+ * tslog_decode. Com opts = NULL, usa 16 MB, nenhum antigo e sem fsync.
+ * @return 0 em sucesso, -1 em erro (errno indica a causa).
+ */
+int logger_add_binary_sink(const char* path, const LogBinaryOptions* opts);
+
+/**
+ * @brief Formata em out, como printf, os argumentos de um evento binário.
+ *
+ * Usada pelo tslog_decode; só vale para registros gravados por um
+ * programa com os mesmos tamanhos de tipos. out termina em '\0'.
+ * @return O tamanho do texto (no máximo cap - 1).
+ */
+size_t logger_format_args(const char* fmt, const void* args, size_t len,
+                          int truncated, char* out, size_t cap);
+
+/**
+ * @brief Define por quanto tempo as linhas podem esperar no buffer.
+ *
+ * Com 0 (padrão), o lote é gravado sempre que a fila esvazia. Com ms > 0,
+ * a thread de escrita acumula linhas até o buffer encher ou até ms
+ * milissegundos após a primeira linha do lote, gravando menos vezes.
+ * Deve ser chamada antes de logger_init().
+ */
+void logger_set_flush_interval(unsigned ms);
+
+/**
+ * @brief Dá a cada thread produtora sua própria fila de slots posições
+ *        (potência de 2), em vez da fila compartilhada.
+ *
+ * A fila de uma thread é criada na sua primeira mensagem e liberada depois
+ * que ela termina, e os produtores não disputam nenhuma linha de cache. A
+ * thread de escrita intercala as filas pelo horário das mensagens. Cada
+ * fila ocupa slots KB, o que pesa com muitas threads de vida curta. Com
+ * 0 (padrão), todas usam a fila compartilhada. Deve ser chamada antes de
+ * logger_init().
+ * @return 0 em sucesso, -1 em erro (errno indica a causa).
+ */
+int logger_set_thread_buffers(size_t slots);
+
+// O que um produtor faz quando a fila de log está cheia
+typedef enum {
+    LOG_OVERFLOW_BLOCK,       // Espera a thread de escrita abrir espaço (padrão)
+    LOG_OVERFLOW_DROP_NEWEST, // Descarta a mensagem nova
+    LOG_OVERFLOW_DROP_OLDEST, // Descarta a mais antiga ainda não gravada
+    LOG_OVERFLOW_DROP_BELOW   // Descarta a nova se o nível for menor que o limite; senão espera
+} LogOverflow;
+
+/**
+ * @brief Escolhe a política de fila cheia. Pode mudar a qualquer momento.
+ * @param min_level Com LOG_OVERFLOW_DROP_BELOW, o menor nível que nunca é
+ *        descartado; ignorado pelas demais políticas.
+ */
+void logger_set_overflow(LogOverflow policy, LogLevel min_level);
+
+// Contadores das filas desde logger_init()
+typedef struct {
+    unsigned long long written; // Linhas entregues aos destinos
+    unsigned long long dropped; // Mensagens descartadas pela política (ou no encerramento)
+    unsigned long long blocked; // Vezes que um produtor esperou por espaço
+    size_t high_water;          // Maior ocupação observada de uma fila
+    size_t capacity;            // Tamanho de cada fila (a compartilhada ou as por thread)
+} LogStats;
+
+/**
+ * @brief Copia os contadores da fila. Com o logger inativo, zera stats.
+ *
+ * Descartes também são resumidos no próprio log ("N mensagens de log
+ * descartadas"), no máximo uma vez a cada 10 segundos.
+ */
+void logger_stats(LogStats* stats);
+
 /**
  * @brief Inicializa o sistema de logging.
  *
@@ -27,17 +276,77 @@ void logger_init();
  */
 void logger_destroy();
 
+/**
+ * @brief Como logger_destroy(), mas gasta no máximo timeout_ms gravando o
+ *        que ainda está na fila; o restante é descartado e contado.
+ *
+ * Se a thread de escrita estiver presa em um destino que não aceita dados
+ * (ex.: um pipe cheio), ela é abandonada após o prazo, sem liberar seus
+ * recursos, para que o encerramento do programa não fique bloqueado.
+ * Com timeout_ms = 0 não há limite.
+ */
+void logger_destroy_timeout(unsigned timeout_ms);
+
 /**
  * @brief Adiciona uma mensagem à fila de log.
  *
- * Esta função é thread-safe e pode ser chamada de múltiplas threads.
+ * Esta função é thread-safe e pode ser chamada de múltiplas threads. Ela
+ * não consulta os níveis mínimos; o filtro fica nas macros LOG_*. A
+ * mensagem é copiada para uma posição livre de um anel pré-alocado usando
+ * apenas operações atômicas, sem alocação nem lock; textos maiores que a
+ * posição (cerca de 1 KB) são truncados. Com o anel cheio, aplica a
+ * política de logger_set_overflow(). A linha gravada traz o horário e o
+ * ID (do kernel) da thread no momento desta chamada.
  * @param level O nível da mensagem de log (INFO, WARNING, ERROR).
  * @param message A mensagem a ser logada.
  */
 void logger_log(LogLevel level, const char* message);
 
-#define LOG_INFO(msg) logger_log(INFO, msg)
-#define LOG_WARN(msg) logger_log(WARNING, msg)
-#define LOG_ERROR(msg) logger_log(ERROR, msg)
+/**
+ * @brief Adiciona à fila os len primeiros bytes de message e chama release(ctx).
+ *
+ * O texto não precisa terminar em '\0'. release(ctx) é chamado antes de
+ * retornar, assim que a mensagem foi copiada para o anel. Útil para
+ * registrar buffers compartilhados com contagem de referências.
+ */
+void logger_log_ref(LogLevel level, const char* message, size_t len,
+                    void (*release)(void* ctx), void* ctx);
+
+#if defined(__GNUC__)
+#define TSLOG_PRINTF(fmt_idx, args_idx) __attribute__((format(printf, fmt_idx, args_idx)))
+#else
+#define TSLOG_PRINTF(fmt_idx, args_idx)
+#endif
+
+/**
+ * @brief Adiciona à fila uma mensagem no formato de printf, formatada depois.
+ *
+ * Só o endereço de fmt e os argumentos brutos vão para o anel; a formatação
+ * é feita pela thread de escrita, fora do caminho de quem chama. Por isso
+ * fmt deve continuar válido até o fim do programa (use uma string literal).
+ * Strings de %s são copiadas, respeitando a precisão (%.20s copia no
+ * máximo 20 bytes). Não há suporte a %n nem a argumentos posicionais (%1$d);
+ * o texto a partir de uma conversão desconhecida é gravado sem formatação.
+ * Argumentos que não couberem na posição do anel são omitidos e a linha
+ * termina em "...".
+ */
+void logger_logf(LogLevel level, const char* fmt, ...) TSLOG_PRINTF(2, 3);
+
+// Verdadeiro se o nível passa pelo filtro de compilação e pelo do módulo
+#define TSLOG_ENABLED(module, level) \
+    ((level) >= TSLOG_MIN_LEVEL && logger_enabled((module), (level)))
+
+#define TSLOG_CALL(module, level, fn, ...) \
+    do { if (TSLOG_ENABLED(module, level)) fn((level), __VA_ARGS__); } while (0)
+
+// Registra no módulo indicado em vez de TSLOG_MODULE (formato de printf)
+#define LOG_AT(module, level, ...) TSLOG_CALL(module, level, logger_logf, __VA_ARGS__)
+
+#define LOG_INFO(msg) TSLOG_CALL(TSLOG_MODULE, INFO, logger_log, msg)
+#define LOG_WARN(msg) TSLOG_CALL(TSLOG_MODULE, WARNING, logger_log, msg)
+#define LOG_ERROR(msg) TSLOG_CALL(TSLOG_MODULE, ERROR, logger_log, msg)
+#define LOG_INFOF(...) TSLOG_CALL(TSLOG_MODULE, INFO, logger_logf, __VA_ARGS__)
+#define LOG_WARNF(...) TSLOG_CALL(TSLOG_MODULE, WARNING, logger_logf, __VA_ARGS__)
+#define LOG_ERRORF(...) TSLOG_CALL(TSLOG_MODULE, ERROR, logger_logf, __VA_ARGS__)
 
 #endif 
\ No newline at end of file
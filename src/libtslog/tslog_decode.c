@@ -0,0 +1,222 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "libtslog/tslog.h"
+
+// Converte os segmentos gravados por logger_add_binary_sink() em texto (o
+// mesmo formato do destino de texto) ou em JSON, um objeto por linha.
+
+#define MSG_MAX 8192
+
+// Formatos definidos no segmento, indexados pelo ID do evento
+typedef struct {
+    char** fmts;
+    size_t cap;
+} EventTable;
+
+static const char* level_name(unsigned level) {
+    switch (level) {
+        case INFO:    return "INFO";
+        case WARNING: return "WARNING";
+        case ERROR:   return "ERROR";
+    }
+    return "UNKNOWN";
+}
+
+static int table_define(EventTable* t, uint32_t id, const char* fmt, size_t len) {
+    if (id >= t->cap) {
+        size_t cap = t->cap ? t->cap : 64;
+        while (cap <= id) cap *= 2;
+        char** grown = (char**)realloc(t->fmts, cap * sizeof(char*));
+        if (!grown) return -1;
+        memset(grown + t->cap, 0, (cap - t->cap) * sizeof(char*));
+        t->fmts = grown;
+        t->cap = cap;
+    }
+    char* copy = (char*)malloc(len + 1);
+    if (!copy) return -1;
+    memcpy(copy, fmt, len);
+    copy[len] = '\0';
+    free(t->fmts[id]);
+    t->fmts[id] = copy;
+    return 0;
+}
+
+static void table_free(EventTable* t) {
+    for (size_t i = 0; i < t->cap; i++) free(t->fmts[i]);
+    free(t->fmts);
+    t->fmts = NULL;
+    t->cap = 0;
+}
+
+static void json_string(const char* s, size_t len) {
+    putchar('"');
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\') {
+            putchar('\\');
+            putchar(c);
+        } else if (c == '\n') {
+            fputs("\\n", stdout);
+        } else if (c == '\t') {
+            fputs("\\t", stdout);
+        } else if (c < 0x20) {
+            printf("\\u%04x", c);
+        } else {
+            putchar(c);
+        }
+    }
+    putchar('"');
+}
+
+static void print_event(int json, int64_t time_ns, unsigned level, int32_t tid, uint32_t event,
+                        const char* fmt, const char* msg, size_t len) {
+    time_t sec = (time_t)(time_ns / 1000000000);
+    int ms = (int)(time_ns % 1000000000 / 1000000);
+    struct tm tm_info;
+    char date[32];
+    if (!json) {
+        localtime_r(&sec, &tm_info);
+        strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", &tm_info);
+        printf("[%s.%03d] [%d] [%s] %.*s\n", date, ms, (int)tid, level_name(level), (int)len, msg);
+        return;
+    }
+    gmtime_r(&sec, &tm_info);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", &tm_info);
+    printf("{\"time\":\"%s.%03dZ\",\"ts_ns\":%lld,\"level\":\"%s\",\"tid\":%d,\"event\":%u,",
+           date, ms, (long long)time_ns, level_name(level), (int)tid, event);
+    if (fmt) {
+        fputs("\"fmt\":", stdout);
+        json_string(fmt, strlen(fmt));
+        putchar(',');
+    }
+    fputs("\"msg\":", stdout);
+    json_string(msg, len);
+    fputs("}\n", stdout);
+}
+
+// Confere o cabeçalho do segmento: os argumentos só podem ser lidos com os
+// mesmos tamanhos de tipos de quem os gravou
+static int check_header(const char* path, const unsigned char* h, size_t size) {
+    uint32_t order = 0;
+    const unsigned char sizes[] = {
+        sizeof(int), sizeof(long), sizeof(long long), sizeof(size_t), sizeof(intmax_t),
+        sizeof(ptrdiff_t), sizeof(double), sizeof(long double), sizeof(void*)
+    };
+    if (size < TSLOG_BIN_HEADER_SIZE || memcmp(h, TSLOG_BIN_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: não é um log binário do tslog\n", path);
+        return -1;
+    }
+    memcpy(&order, h + 8, 4);
+    if (order != 0x01020304 || memcmp(h + 12, sizes, sizeof(sizes)) != 0) {
+        fprintf(stderr, "%s: gravado em uma máquina com outra ordem de bytes ou outros tamanhos de tipos\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+static int decode_file(const char* path, int json) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size == 0) {
+        fprintf(stderr, "%s: arquivo vazio ou ilegível\n", path);
+        close(fd);
+        return -1;
+    }
+    size_t size = (size_t)st.st_size;
+    const char* data = (const char*)mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "%s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    if (check_header(path, (const unsigned char*)data, size) < 0) {
+        munmap((void*)data, size);
+        return -1;
+    }
+
+    EventTable table = { NULL, 0 };
+    char* msg = (char*)malloc(MSG_MAX);
+    int rc = msg ? 0 : -1;
+    size_t off = TSLOG_BIN_HEADER_SIZE;
+    while (rc == 0 && off + 4 <= size) {
+        uint32_t rec_size;
+        memcpy(&rec_size, data + off, 4);
+        if (rec_size == 0) break; // Resto pré-alocado de um segmento não fechado
+        if (rec_size < TSLOG_REC_HEADER_SIZE || rec_size > size - off) {
+            fprintf(stderr, "%s: registro inválido no byte %zu\n", path, off);
+            rc = -1;
+            break;
+        }
+        const char* rec = data + off;
+        const char* payload = rec + TSLOG_REC_HEADER_SIZE;
+        size_t payload_len = rec_size - TSLOG_REC_HEADER_SIZE;
+        uint16_t flags;
+        uint32_t event;
+        int32_t tid;
+        int64_t time_ns;
+        memcpy(&flags, rec + 6, 2);
+        memcpy(&event, rec + 8, 4);
+        memcpy(&tid, rec + 12, 4);
+        memcpy(&time_ns, rec + 16, 8);
+        off += rec_size;
+
+        if (rec[4] == TSLOG_REC_DEFINE) {
+            if (table_define(&table, event, payload, payload_len) < 0) rc = -1;
+        } else if (rec[4] == TSLOG_REC_EVENT) {
+            unsigned level = (unsigned char)rec[5];
+            if (event == 0) {
+                print_event(json, time_ns, level, tid, 0, NULL, payload, payload_len);
+            } else if (event < table.cap && table.fmts[event]) {
+                const char* fmt = table.fmts[event];
+                size_t len = logger_format_args(fmt, payload, payload_len,
+                                                flags & TSLOG_REC_TRUNCATED, msg, MSG_MAX);
+                print_event(json, time_ns, level, tid, event, fmt, msg, len);
+            } else {
+                fprintf(stderr, "%s: evento %u sem definição no byte %zu\n", path, event, off - rec_size);
+            }
+        }
+        // Outros tipos são de versões futuras e são ignorados
+    }
+
+    free(msg);
+    table_free(&table);
+    munmap((void*)data, size);
+    return rc;
+}
+
+int main(int argc, char* argv[]) {
+    int json = 0;
+    int first = 1;
+    if (argc > 1 && strcmp(argv[1], "--json") == 0) {
+        json = 1;
+        first = 2;
+    } else if (argc > 1 && strcmp(argv[1], "--text") == 0) {
+        first = 2;
+    }
+    if (first >= argc) {
+        fprintf(stderr, "Uso: %s [--text|--json] ARQUIVO...\n"
+                        "Os segmentos são lidos na ordem dada (ex.: log.bin.2 log.bin.1 log.bin).\n", argv[0]);
+        return 1;
+    }
+
+    int rc = 0;
+    for (int i = first; i < argc; i++) {
+        if (decode_file(argv[i], json) < 0) rc = 1;
+    }
+    return rc;
+}
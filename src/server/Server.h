@@ -1,6 +1,35 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#define BUFFER_SIZE 2048
+
+// Módulos do log (libtslog/tslog.h), cada um com seu nível mínimo
+enum {
+    LOGMOD_CHAT,       // Mensagens, entradas e saídas (padrão)
+    LOGMOD_NET,        // Conexões e modos de I/O
+    LOGMOD_MODERATION, // Carga e recarga da lista de palavras
+    LOGMOD_HISTORY     // Histórico e log persistente das salas
+};
+
+struct Conn;
+
 void start_server(int port);
 
-#endif
\ No newline at end of file
+/**
+ * @brief Processa os bytes acumulados em c->in_buf.
+ *
+ * Conduz a máquina de estados da conexão. O primeiro byte escolhe o
+ * protocolo: o preâmbulo de common/protocol.h ativa os quadros com tipo e
+ * tamanho; qualquer outro byte mantém o protocolo de linhas, em que o
+ * primeiro trecho (até '\n') é o nickname e cada linha seguinte é uma
+ * mensagem pública ou um comando /msg. Quadros e linhas incompletos
+ * permanecem no buffer até a próxima leitura.
+ */
+void chat_process_input(struct Conn* c);
+
+/**
+ * @brief Notifica a saída do cliente e o remove da lista. Idempotente.
+ */
+void chat_on_disconnect(struct Conn* c);
+
+#endif
@@ -0,0 +1,309 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "server/conn.h"
+#include "server/intern.h"
+#include "server/metrics.h"
+
+// Máximo de mensagens reunidas em um único sendmsg
+#define OUT_IOV_MAX 64
+
+static OutPolicy g_out_policy = OUT_DROP_OLDEST;
+static size_t g_out_limit = 1024;
+
+static atomic_ullong g_dropped_oldest;
+static atomic_ullong g_disconnects;
+static atomic_ullong g_skipped;
+static atomic_ullong g_notices;
+
+void conn_set_out_policy(OutPolicy policy, size_t limit) {
+    g_out_policy = policy;
+    g_out_limit = limit < 2 ? 2 : limit;
+}
+
+void conn_out_stats(ConnOutStats* stats) {
+    stats->dropped_oldest = atomic_load(&g_dropped_oldest);
+    stats->disconnects = atomic_load(&g_disconnects);
+    stats->skipped = atomic_load(&g_skipped);
+    stats->notices = atomic_load(&g_notices);
+}
+
+Conn* conn_create(int fd, int nonblocking) {
+    Conn* c = (Conn*)calloc(1, sizeof(Conn));
+    if (!c) {
+        return NULL;
+    }
+    c->fd = fd;
+    c->nonblocking = nonblocking;
+    c->state = CONN_AWAIT_NICK;
+    c->wake_fd = -1;
+    if (!nonblocking) {
+        c->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (c->wake_fd < 0) {
+            free(c);
+            return NULL;
+        }
+    }
+    pthread_mutex_init(&c->out_mutex, NULL);
+    atomic_init(&c->refs, 1);
+    metrics_add(METRIC_CONN_OPENED, 1);
+    return c;
+}
+
+void conn_ref(Conn* c) {
+    atomic_fetch_add_explicit(&c->refs, 1, memory_order_relaxed);
+}
+
+// --- Fila de saída (todas as funções *_locked requerem out_mutex) ---
+
+static MsgBuf** ring_slot(Conn* c, size_t i) {
+    return &c->out_ring[(c->out_head + i) % g_out_limit];
+}
+
+// Mensagens do início da fila que não podem ser descartadas
+static size_t pinned_locked(const Conn* c) {
+    size_t pinned = c->out_pinned;
+    if (pinned == 0 && c->out_head_off > 0) pinned = 1; // Envio parcial
+    return pinned;
+}
+
+static void pop_head_locked(Conn* c) {
+    msgbuf_unref(*ring_slot(c, 0));
+    c->out_head = (c->out_head + 1) % g_out_limit;
+    c->out_count--;
+    c->out_head_off = 0;
+}
+
+// Remove a mensagem na posição i deslocando as anteriores (i <= OUT_IOV_MAX)
+static void drop_at_locked(Conn* c, size_t i) {
+    msgbuf_unref(*ring_slot(c, i));
+    for (; i > 0; i--) *ring_slot(c, i) = *ring_slot(c, i - 1);
+    c->out_head = (c->out_head + 1) % g_out_limit;
+    c->out_count--;
+}
+
+// Descarta as mensagens a partir da posição keep
+static void truncate_locked(Conn* c, size_t keep) {
+    while (c->out_count > keep) {
+        msgbuf_unref(*ring_slot(c, c->out_count - 1));
+        c->out_count--;
+    }
+    if (c->out_count == 0) c->out_head_off = 0;
+}
+
+// A fila passa a ser dona de uma referência de msg
+static void push_locked(Conn* c, MsgBuf* msg) {
+    *ring_slot(c, c->out_count) = msg;
+    c->out_count++;
+}
+
+// Enfileira aplicando a política de cliente lento. Retorna -1 se faltar memória.
+static int enqueue_locked(Conn* c, MsgBuf* buf) {
+    if (!c->out_ring) {
+        c->out_ring = (MsgBuf**)calloc(g_out_limit, sizeof(MsgBuf*));
+        if (!c->out_ring) return -1;
+    }
+    if (c->out_overflow) return 0; // Já está sendo desconectado
+
+    // Avisa as perdas da política OUT_SKIP_NOTICE assim que houver espaço
+    if (c->out_skipped > 0 && c->out_count + 2 <= g_out_limit) {
+        MsgBuf* msg = msgbuf_printf("[SERVER]: %zu mensagem(ns) não entregue(s): sua conexão está lenta.\n",
+                                    c->out_skipped);
+        if (msg) {
+            push_locked(c, msg);
+            c->out_skipped = 0;
+            atomic_fetch_add(&g_notices, 1);
+        }
+    }
+
+    if (c->out_count == g_out_limit) {
+        switch (g_out_policy) {
+        case OUT_DROP_OLDEST: {
+            size_t pinned = pinned_locked(c);
+            if (pinned >= c->out_count) {
+                // Tudo em envio: descarta a nova, que conta como ignorada
+                atomic_fetch_add(&g_skipped, 1);
+                return 0;
+            }
+            drop_at_locked(c, pinned);
+            atomic_fetch_add(&g_dropped_oldest, 1);
+            break;
+        }
+        case OUT_DISCONNECT:
+            // O fim da leitura conduz o desligamento normal do cliente
+            c->out_overflow = 1;
+            shutdown(c->fd, SHUT_RDWR);
+            atomic_fetch_add(&g_disconnects, 1);
+            return 0;
+        case OUT_SKIP_NOTICE:
+            c->out_skipped++;
+            atomic_fetch_add(&g_skipped, 1);
+            return 0;
+        }
+    }
+
+    msgbuf_ref(buf);
+    push_locked(c, buf);
+    return 0;
+}
+
+// Preenche iov com as mensagens pendentes a partir do início da fila
+static size_t fill_iov_locked(Conn* c, struct iovec* iov, size_t max_iov) {
+    size_t n = c->out_count < max_iov ? c->out_count : max_iov;
+    for (size_t i = 0; i < n; i++) {
+        size_t len;
+        const char* wire = msgbuf_wire(*ring_slot(c, i), c->proto == CONN_PROTO_FRAMES, &len);
+        size_t off = (i == 0) ? c->out_head_off : 0;
+        iov[i].iov_base = (char*)wire + off;
+        iov[i].iov_len = len - off;
+    }
+    return n;
+}
+
+// Remove da fila os bytes já enviados
+static void advance_locked(Conn* c, size_t sent) {
+    while (sent > 0 && c->out_count > 0) {
+        size_t len;
+        msgbuf_wire(*ring_slot(c, 0), c->proto == CONN_PROTO_FRAMES, &len);
+        size_t remaining = len - c->out_head_off;
+        if (sent < remaining) {
+            c->out_head_off += sent;
+            return;
+        }
+        sent -= remaining;
+        pop_head_locked(c);
+    }
+}
+
+// Envia o máximo possível sem bloquear, várias mensagens por chamada
+static int flush_locked(Conn* c) {
+    while (c->out_count > 0) {
+        struct iovec iov[OUT_IOV_MAX];
+        struct msghdr msg = { 0 };
+        msg.msg_iov = iov;
+        msg.msg_iovlen = fill_iov_locked(c, iov, OUT_IOV_MAX);
+
+        ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            return -1;
+        }
+        metrics_add(METRIC_BYTES_OUT, (uint64_t)n);
+        advance_locked(c, (size_t)n);
+    }
+    return 0;
+}
+
+// Acorda a thread dona (modo "threads") para aguardar POLLOUT
+static void wake_owner_locked(Conn* c) {
+    if (c->wake_fd < 0 || c->wake_pending || c->out_count == 0) return;
+    c->wake_pending = 1;
+    uint64_t one = 1;
+    (void)!write(c->wake_fd, &one, sizeof(one));
+}
+
+void conn_unref(Conn* c) {
+    if (atomic_fetch_sub_explicit(&c->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    close(c->fd);
+    if (c->wake_fd >= 0) close(c->wake_fd);
+    intern_release(c->nickname);
+    if (c->out_ring) {
+        truncate_locked(c, 0);
+        free(c->out_ring);
+    }
+    pthread_mutex_destroy(&c->out_mutex);
+    free(c);
+    metrics_add(METRIC_CONN_CLOSED, 1);
+}
+
+int conn_send_buf(Conn* c, MsgBuf* buf) {
+    int rc = 0;
+    pthread_mutex_lock(&c->out_mutex);
+    if (c->state == CONN_CLOSED || enqueue_locked(c, buf) < 0) {
+        rc = -1;
+    } else if (c->flush_hook) {
+        // O worker dono envia tudo o que acumular até processar a conexão.
+        // Em rajadas (fila acima da metade, nenhum SENDMSG em curso) envia
+        // direto para não estourar a fila de clientes rápidos no mesmo lote.
+        if (c->out_pinned == 0 && c->out_count * 2 > g_out_limit) rc = flush_locked(c);
+        if (!c->flush_scheduled && c->out_count > 0) {
+            c->flush_scheduled = 1;
+            c->flush_hook(c);
+        }
+    } else {
+        // Tenta enviar agora; o restante fica com o dono da conexão
+        // (EPOLLOUT no reactor, POLLOUT na thread do cliente).
+        rc = flush_locked(c);
+        wake_owner_locked(c);
+    }
+    pthread_mutex_unlock(&c->out_mutex);
+    return rc;
+}
+
+int conn_send(Conn* c, const char* data, size_t len) {
+    MsgBuf* buf = msgbuf_from(data, len);
+    if (!buf) return -1;
+    int rc = conn_send_buf(c, buf);
+    msgbuf_unref(buf);
+    return rc;
+}
+
+int conn_flush(Conn* c) {
+    pthread_mutex_lock(&c->out_mutex);
+    int rc = (c->state == CONN_CLOSED) ? -1 : flush_locked(c);
+    pthread_mutex_unlock(&c->out_mutex);
+    return rc;
+}
+
+int conn_has_output(Conn* c) {
+    pthread_mutex_lock(&c->out_mutex);
+    int pending = c->out_count > 0;
+    pthread_mutex_unlock(&c->out_mutex);
+    return pending;
+}
+
+void conn_clear_wake(Conn* c) {
+    uint64_t value;
+    pthread_mutex_lock(&c->out_mutex);
+    (void)!read(c->wake_fd, &value, sizeof(value));
+    c->wake_pending = 0;
+    pthread_mutex_unlock(&c->out_mutex);
+}
+
+size_t conn_peek_output(Conn* c, struct iovec* iov, size_t max_iov) {
+    size_t n = 0;
+    pthread_mutex_lock(&c->out_mutex);
+    if (c->state != CONN_CLOSED && c->out_count > 0) {
+        n = fill_iov_locked(c, iov, max_iov);
+        c->out_pinned = n;
+    } else {
+        c->flush_scheduled = 0;
+    }
+    pthread_mutex_unlock(&c->out_mutex);
+    return n;
+}
+
+void conn_consume_output(Conn* c, size_t sent) {
+    metrics_add(METRIC_BYTES_OUT, sent);
+    pthread_mutex_lock(&c->out_mutex);
+    advance_locked(c, sent);
+    c->out_pinned = 0;
+    if (c->state == CONN_CLOSED) truncate_locked(c, 0);
+    pthread_mutex_unlock(&c->out_mutex);
+}
+
+void conn_mark_closed(Conn* c) {
+    pthread_mutex_lock(&c->out_mutex);
+    c->state = CONN_CLOSED;
+    if (c->out_ring) truncate_locked(c, c->out_pinned);
+    pthread_mutex_unlock(&c->out_mutex);
+}
@@ -0,0 +1,178 @@
+#ifndef CONN_H
+#define CONN_H
+
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "server/Server.h"
+#include "server/mpsc.h"
+#include "server/msgbuf.h"
+
+// Estados da máquina de estados de cada conexão
+typedef enum {
+    CONN_AWAIT_NICK, // Aguardando o nickname (handshake)
+    CONN_ACTIVE,     // Participando do chat
+    CONN_CLOSED      // Desconectada; nada mais é enviado
+} ConnState;
+
+// Formato das mensagens na conexão, detectado pelo primeiro byte recebido
+typedef enum {
+    CONN_PROTO_UNKNOWN, // Nada recebido ainda
+    CONN_PROTO_LINES,   // Texto, uma mensagem por linha (clientes antigos, telnet)
+    CONN_PROTO_FRAMES   // Quadros com tipo e tamanho (common/protocol.h)
+} ConnProto;
+
+// Política aplicada quando a fila de saída de um cliente lento está cheia
+typedef enum {
+    OUT_DROP_OLDEST, // Descarta a mensagem mais antiga ainda não enviada
+    OUT_DISCONNECT,  // Desconecta o cliente
+    OUT_SKIP_NOTICE  // Ignora a nova mensagem e avisa quantas foram perdidas
+} OutPolicy;
+
+// Quantas vezes cada política foi acionada desde o início do servidor
+typedef struct {
+    unsigned long long dropped_oldest;
+    unsigned long long disconnects;
+    unsigned long long skipped; // Novas descartadas (OUT_SKIP_NOTICE, ou OUT_DROP_OLDEST com tudo em envio)
+    unsigned long long notices;
+} ConnOutStats;
+
+/**
+ * @brief Estado de uma conexão de cliente, compartilhado pelos modos de I/O.
+ *
+ * Cada conexão tem uma fila de saída limitada de mensagens inteiras. Quem
+ * chama conn_send() apenas enfileira e tenta um envio sem bloquear, que
+ * junta todas as mensagens pendentes em um único sendmsg (writev). O que o
+ * kernel não aceitar é enviado pelo dono da conexão: a thread do cliente
+ * (acordada por wake_fd) no modo "threads", o reactor ao receber EPOLLOUT,
+ * ou o worker io_uring. Assim um cliente lento nunca bloqueia o remetente.
+ * O socket só é fechado quando a última referência é liberada, evitando
+ * que outra thread escreva em um descritor já reutilizado.
+ */
+typedef struct Conn {
+    int fd;
+    int nonblocking;
+    ConnState state;
+    ConnProto proto;   // Definido pelos primeiros bytes recebidos; também
+                       // escolhe o formato de envio
+    int proto_error;   // Erro de protocolo: a entrada restante é descartada
+    const char* nickname; // Nome internado (intern.h); NULL até o handshake
+
+    // Bytes recebidos ainda não processados (linha incompleta)
+    char in_buf[BUFFER_SIZE];
+    size_t in_len;
+
+    // Fila circular de saída (capacidade = limite configurado), protegida
+    // por out_mutex. Cada posição guarda uma referência a um MsgBuf
+    // compartilhado. As out_pinned primeiras mensagens estão em envio e não
+    // podem ser descartadas.
+    pthread_mutex_t out_mutex;
+    MsgBuf** out_ring;
+    size_t out_head;
+    size_t out_count;
+    size_t out_head_off; // Bytes da primeira mensagem já enviados
+    size_t out_pinned;
+    size_t out_skipped;  // Mensagens ignoradas ainda não avisadas (OUT_SKIP_NOTICE)
+    int out_overflow;    // OUT_DISCONNECT já acionada
+    int wake_fd;         // eventfd da thread dona (modo "threads"), ou -1
+    int wake_pending;
+
+    // Envio delegado (backend io_uring): conn_send apenas enfileira e
+    // chama flush_hook uma vez; o worker dono envia de forma assíncrona.
+    void (*flush_hook)(struct Conn* c);
+    int flush_scheduled; // Protegido por out_mutex
+    int send_inflight;   // Acessado apenas pelo worker dono
+    MpscNode flush_node;
+
+    atomic_int refs;
+    struct Room* room; // Sala atual (room.h), com uma referência; NULL fora de sala
+    int room_part;     // Parte (shard) da sala em que está
+    size_t room_slot;  // Posição no vetor de membros dessa parte
+    uint64_t room_seq; // Última mensagem da sala quando entrou (já no histórico)
+    void* owner; // Reactor responsável pela conexão (NULL no modo threads)
+    size_t owner_slot; // Posição na fatia do registro do shard dono
+    size_t reg_slot;   // Posição no registro global de clientes
+} Conn;
+
+/**
+ * @brief Define o tamanho das filas de saída e a política para clientes lentos.
+ *
+ * Deve ser chamada antes de aceitar conexões.
+ * @param limit Máximo de mensagens pendentes por cliente (>= 2).
+ */
+void conn_set_out_policy(OutPolicy policy, size_t limit);
+
+/**
+ * @brief Copia os contadores das políticas de clientes lentos.
+ */
+void conn_out_stats(ConnOutStats* stats);
+
+/**
+ * @brief Cria uma conexão com uma referência, pertencente ao chamador.
+ *
+ * Com nonblocking = 0 (modo "threads") cria também o wake_fd que a thread
+ * do cliente deve observar junto com o socket.
+ */
+Conn* conn_create(int fd, int nonblocking);
+
+void conn_ref(Conn* c);
+
+/**
+ * @brief Libera uma referência; a última fecha o socket e libera a memória.
+ */
+void conn_unref(Conn* c);
+
+/**
+ * @brief Enfileira uma mensagem para o cliente. Thread-safe e nunca bloqueia.
+ *
+ * Com a fila cheia aplica a política configurada.
+ * @return 0 em sucesso (inclusive quando a política descarta mensagens),
+ *         -1 se a conexão estiver fechada ou falhar.
+ */
+int conn_send(Conn* c, const char* data, size_t len);
+
+/**
+ * @brief Como conn_send(), mas enfileira uma referência a buf, sem cópia.
+ */
+int conn_send_buf(Conn* c, MsgBuf* buf);
+
+/**
+ * @brief Envia o que for possível da fila sem bloquear (EPOLLOUT/POLLOUT).
+ * @return 0 em sucesso, -1 se a conexão falhou.
+ */
+int conn_flush(Conn* c);
+
+/**
+ * @brief Indica se há mensagens aguardando envio.
+ */
+int conn_has_output(Conn* c);
+
+/**
+ * @brief Consome o sinal de wake_fd (modo "threads").
+ */
+void conn_clear_wake(Conn* c);
+
+/**
+ * @brief Monta o vetor de envio com as mensagens pendentes (envio delegado).
+ *
+ * As mensagens referenciadas ficam fixadas até conn_consume_output(). Se
+ * não houver nada pendente, retorna 0 e libera um novo agendamento via
+ * flush_hook.
+ * @return Número de entradas preenchidas em iov.
+ */
+size_t conn_peek_output(Conn* c, struct iovec* iov, size_t max_iov);
+
+/**
+ * @brief Conclui um envio delegado de sent bytes e libera as fixações.
+ */
+void conn_consume_output(Conn* c, size_t sent);
+
+/**
+ * @brief Marca a conexão como encerrada e descarta a saída pendente
+ *        (exceto mensagens fixadas por um envio em andamento).
+ */
+void conn_mark_closed(Conn* c);
+
+#endif
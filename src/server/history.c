@@ -0,0 +1,174 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "server/history.h"
+
+static const char history_header[] = "--- Histórico das últimas mensagens ---\n";
+static const char history_footer[] = "--- Fim do histórico ---\n";
+
+struct History {
+    pthread_mutex_t mutex;  // Protege o anel e o cache
+    MsgBuf** ring;
+    size_t capacity;
+    size_t start;
+    size_t count;
+    uint64_t version;       // Incrementada a cada acréscimo
+
+    MsgBuf* snapshot;       // Cache da fotografia (pode estar desatualizado)
+    uint64_t snapshot_version;
+
+    // Serializa as reconstruções: numa avalanche de entradas, só a primeira
+    // thread monta a fotografia e as demais reaproveitam o resultado.
+    pthread_mutex_t build_mutex;
+};
+
+History* history_create(size_t capacity) {
+    if (capacity < 1) capacity = 1;
+    if (capacity > HISTORY_MAX_SIZE) capacity = HISTORY_MAX_SIZE;
+
+    History* h = (History*)calloc(1, sizeof(History));
+    if (!h) return NULL;
+    h->ring = (MsgBuf**)calloc(capacity, sizeof(MsgBuf*));
+    if (!h->ring) {
+        free(h);
+        return NULL;
+    }
+    h->capacity = capacity;
+    pthread_mutex_init(&h->mutex, NULL);
+    pthread_mutex_init(&h->build_mutex, NULL);
+    return h;
+}
+
+void history_destroy(History* h) {
+    if (!h) return;
+    for (size_t i = 0; i < h->count; i++) {
+        msgbuf_unref(h->ring[(h->start + i) % h->capacity]);
+    }
+    msgbuf_unref(h->snapshot);
+    free(h->ring);
+    pthread_mutex_destroy(&h->mutex);
+    pthread_mutex_destroy(&h->build_mutex);
+    free(h);
+}
+
+void history_append(History* h, MsgBuf* msg) {
+    MsgBuf* evicted = NULL;
+    msgbuf_ref(msg);
+
+    pthread_mutex_lock(&h->mutex);
+    if (h->count == h->capacity) {
+        evicted = h->ring[h->start];
+        h->start = (h->start + 1) % h->capacity;
+    } else {
+        h->count++;
+    }
+    h->ring[(h->start + h->count - 1) % h->capacity] = msg;
+    h->version++;
+    pthread_mutex_unlock(&h->mutex);
+
+    msgbuf_unref(evicted);
+}
+
+// Devolve o cache se ainda corresponder à versão atual. Requer h->mutex.
+static MsgBuf* cached_locked(History* h) {
+    if (h->snapshot && h->snapshot_version == h->version) {
+        msgbuf_ref(h->snapshot);
+        return h->snapshot;
+    }
+    return NULL;
+}
+
+// Monta a fotografia da versão atual. As mensagens são emprestadas sob o
+// mutex e copiadas fora dele; o conteúdo delas é imutável.
+static MsgBuf* build_snapshot(History* h, uint64_t* version) {
+    pthread_mutex_lock(&h->mutex);
+    size_t count = h->count;
+    MsgBuf** items = (MsgBuf**)malloc((count ? count : 1) * sizeof(MsgBuf*));
+    if (!items) {
+        pthread_mutex_unlock(&h->mutex);
+        return NULL;
+    }
+    size_t total = sizeof(history_header) - 1 + sizeof(history_footer) - 1;
+    uint64_t last_seq = 0;
+    for (size_t i = 0; i < count; i++) {
+        items[i] = h->ring[(h->start + i) % h->capacity];
+        msgbuf_ref(items[i]);
+        total += items[i]->len;
+        if (items[i]->seq > last_seq) last_seq = items[i]->seq;
+    }
+    *version = h->version;
+    pthread_mutex_unlock(&h->mutex);
+
+    MsgBuf* block = msgbuf_alloc(total);
+    if (block) {
+        char* p = block->data;
+        memcpy(p, history_header, sizeof(history_header) - 1);
+        p += sizeof(history_header) - 1;
+        for (size_t i = 0; i < count; i++) {
+            memcpy(p, items[i]->data, items[i]->len);
+            p += items[i]->len;
+        }
+        memcpy(p, history_footer, sizeof(history_footer) - 1);
+        msgbuf_set_seq(block, last_seq);
+        msgbuf_set_type(block, FRAME_HISTORY);
+    }
+
+    for (size_t i = 0; i < count; i++) msgbuf_unref(items[i]);
+    free(items);
+    return block;
+}
+
+MsgBuf* history_snapshot(History* h) {
+    pthread_mutex_lock(&h->mutex);
+    MsgBuf* snap = cached_locked(h);
+    pthread_mutex_unlock(&h->mutex);
+    if (snap) return snap;
+
+    pthread_mutex_lock(&h->build_mutex);
+    // Outra thread pode ter reconstruído enquanto esperávamos
+    pthread_mutex_lock(&h->mutex);
+    snap = cached_locked(h);
+    pthread_mutex_unlock(&h->mutex);
+
+    if (!snap) {
+        uint64_t version;
+        snap = build_snapshot(h, &version);
+        if (snap) {
+            MsgBuf* old = NULL;
+            msgbuf_ref(snap); // Referência do cache
+            pthread_mutex_lock(&h->mutex);
+            old = h->snapshot;
+            h->snapshot = snap;
+            h->snapshot_version = version;
+            pthread_mutex_unlock(&h->mutex);
+            msgbuf_unref(old);
+        }
+    }
+    pthread_mutex_unlock(&h->build_mutex);
+    return snap;
+}
+
+long history_since(History* h, uint64_t after_seq, MsgBuf** out, size_t max) {
+    pthread_mutex_lock(&h->mutex);
+    size_t first = h->count;
+    for (size_t i = 0; i < h->count; i++) {
+        if (h->ring[(h->start + i) % h->capacity]->seq > after_seq) {
+            first = i;
+            break;
+        }
+    }
+    // A primeira mensagem perdida precisa ainda estar no anel
+    size_t n = h->count - first;
+    if (n > max || (n > 0 && h->ring[(h->start + first) % h->capacity]->seq != after_seq + 1)) {
+        pthread_mutex_unlock(&h->mutex);
+        return -1;
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i] = h->ring[(h->start + first + i) % h->capacity];
+        msgbuf_ref(out[i]);
+    }
+    pthread_mutex_unlock(&h->mutex);
+    return (long)n;
+}
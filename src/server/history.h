@@ -0,0 +1,53 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "server/msgbuf.h"
+
+#define HISTORY_MAX_SIZE 10000
+
+/**
+ * @brief Histórico circular das últimas mensagens públicas.
+ *
+ * Guarda referências aos mesmos MsgBuf enviados aos clientes. A
+ * fotografia enviada a quem entra (um único quadro FRAME_HISTORY contíguo)
+ * fica em cache e só é refeita na primeira entrada depois de um acréscimo:
+ * todos os que entram em seguida compartilham o mesmo buffer, recebido com
+ * um único sendmsg, e o custo de uma entrada não cresce com o tamanho do
+ * histórico.
+ */
+typedef struct History History;
+
+/**
+ * @param capacity Máximo de mensagens guardadas (1..HISTORY_MAX_SIZE).
+ * @return O histórico, ou NULL se faltar memória.
+ */
+History* history_create(size_t capacity);
+
+void history_destroy(History* h);
+
+/**
+ * @brief Acrescenta uma mensagem (obtém sua própria referência).
+ */
+void history_append(History* h, MsgBuf* msg);
+
+/**
+ * @brief Fotografia atual do histórico, com cabeçalho e rodapé.
+ *
+ * O número de sequência do quadro é o da mensagem mais recente incluída.
+ * @return O quadro com uma referência (libere com msgbuf_unref()), ou NULL
+ *         se faltar memória.
+ */
+MsgBuf* history_snapshot(History* h);
+
+/**
+ * @brief Mensagens posteriores a after_seq, em ordem, para quem reconecta.
+ * @param out Recebe até max referências (libere cada uma com msgbuf_unref()).
+ * @return Quantas foram copiadas, ou -1 se o histórico não alcança mais a
+ *         mensagem after_seq + 1 ou se há mais de max mensagens.
+ */
+long history_since(History* h, uint64_t after_seq, MsgBuf** out, size_t max);
+
+#endif
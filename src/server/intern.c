@@ -0,0 +1,118 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "server/intern.h"
+
+#define INTERN_MIN_SLOTS 64
+
+// Cabeçalho alocado junto com o texto do nome
+typedef struct {
+    uint32_t hash;
+    uint32_t refs;
+    size_t len;
+    char str[];
+} InternEntry;
+
+// Endereçamento aberto com sondagem linear; carga máxima de 50%
+static InternEntry** g_slots = NULL;
+static size_t g_num_slots = 0;
+static size_t g_count = 0;
+static pthread_mutex_t g_intern_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+uint32_t intern_hash(const char* name, size_t len) {
+    uint32_t h = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)name[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static int grow_locked(void) {
+    size_t new_num = g_num_slots ? g_num_slots * 2 : INTERN_MIN_SLOTS;
+    InternEntry** fresh = (InternEntry**)calloc(new_num, sizeof(InternEntry*));
+    if (!fresh) return -1;
+
+    for (size_t i = 0; i < g_num_slots; i++) {
+        InternEntry* e = g_slots[i];
+        if (!e) continue;
+        size_t j = e->hash & (new_num - 1);
+        while (fresh[j]) j = (j + 1) & (new_num - 1);
+        fresh[j] = e;
+    }
+    free(g_slots);
+    g_slots = fresh;
+    g_num_slots = new_num;
+    return 0;
+}
+
+const char* intern_acquire(const char* name, size_t len) {
+    uint32_t hash = intern_hash(name, len);
+    const char* result = NULL;
+
+    pthread_mutex_lock(&g_intern_mutex);
+    if ((g_count + 1) * 2 > g_num_slots && grow_locked() < 0) {
+        pthread_mutex_unlock(&g_intern_mutex);
+        return NULL;
+    }
+
+    size_t mask = g_num_slots - 1;
+    size_t i = hash & mask;
+    for (; g_slots[i]; i = (i + 1) & mask) {
+        InternEntry* e = g_slots[i];
+        if (e->hash == hash && e->len == len && memcmp(e->str, name, len) == 0) {
+            e->refs++;
+            result = e->str;
+            break;
+        }
+    }
+
+    if (!result) {
+        InternEntry* e = (InternEntry*)malloc(sizeof(InternEntry) + len + 1);
+        if (e) {
+            e->hash = hash;
+            e->refs = 1;
+            e->len = len;
+            memcpy(e->str, name, len);
+            e->str[len] = '\0';
+            g_slots[i] = e;
+            g_count++;
+            result = e->str;
+        }
+    }
+    pthread_mutex_unlock(&g_intern_mutex);
+    return result;
+}
+
+void intern_release(const char* name) {
+    if (!name) return;
+    InternEntry* e = (InternEntry*)(void*)(name - offsetof(InternEntry, str));
+
+    pthread_mutex_lock(&g_intern_mutex);
+    if (--e->refs > 0) {
+        pthread_mutex_unlock(&g_intern_mutex);
+        return;
+    }
+
+    size_t mask = g_num_slots - 1;
+    size_t i = e->hash & mask;
+    while (g_slots[i] != e) i = (i + 1) & mask;
+
+    // Remoção com deslocamento para trás: mantém as sequências de sondagem
+    // contíguas sem marcadores de remoção.
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; g_slots[j]; j = (j + 1) & mask) {
+        size_t home = g_slots[j]->hash & mask;
+        if (((j - home) & mask) >= ((j - hole) & mask)) {
+            g_slots[hole] = g_slots[j];
+            hole = j;
+        }
+    }
+    g_slots[hole] = NULL;
+    g_count--;
+    pthread_mutex_unlock(&g_intern_mutex);
+    free(e);
+}
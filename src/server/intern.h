@@ -0,0 +1,31 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Tabela global de apelidos internados.
+ *
+ * Cada nome distinto é armazenado uma única vez, com o tamanho exato e um
+ * contador de referências. Conexões e o registro guardam apenas o ponteiro
+ * retornado, que permanece válido até a última liberação.
+ */
+
+/**
+ * @brief Obtém (criando se preciso) o nome interno com os len bytes de name.
+ * @return Ponteiro para a string terminada em '\0', ou NULL se faltar memória.
+ */
+const char* intern_acquire(const char* name, size_t len);
+
+/**
+ * @brief Libera uma referência obtida com intern_acquire().
+ */
+void intern_release(const char* name);
+
+/**
+ * @brief Hash (FNV-1a) usado pela tabela; serve também a outros índices de nomes.
+ */
+uint32_t intern_hash(const char* name, size_t len);
+
+#endif
@@ -0,0 +1,200 @@
+#define _POSIX_C_SOURCE 200809L
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "common/hist.h"
+#include "server/metrics.h"
+
+// Histograma log-linear com 8 faixas por potência de 2 (common/hist.h)
+#define HIST_SUB_BITS 3
+#define HIST_MAX_EXP 34 // A partir de 2^34 ns (~17 s) tudo cai na última faixa
+#define HIST_SLOTS HIST_BUCKETS(HIST_SUB_BITS, HIST_MAX_EXP)
+
+typedef struct {
+    atomic_ullong count;
+    atomic_ullong sum;
+    atomic_ullong max;
+    atomic_ullong buckets[HIST_SLOTS];
+} Histogram;
+
+// Fatia de uma thread (ou de algumas, se houver mais threads que fatias)
+typedef struct {
+    _Alignas(64) atomic_int owners;
+    atomic_ullong counters[METRIC_COUNTERS];
+    Histogram stages[METRIC_STAGES];
+} MetricsShard;
+
+static MetricsShard g_shards[METRICS_SHARDS];
+static atomic_uint g_next_shard;
+static _Thread_local MetricsShard* t_shard;
+
+static pthread_once_t g_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t g_shard_key;
+
+static const char* const g_stage_names[METRIC_STAGES] = {
+    "read", "input", "filter", "history", "fanout", "log"
+};
+
+// Estado de metrics_snapshot(): soma das fatias e valores da fotografia
+// anterior, para as taxas recentes
+static pthread_mutex_t g_snap_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t g_start_ns;
+static uint64_t g_last_ns;
+static unsigned long long g_last[METRIC_COUNTERS];
+static unsigned long long g_sum_buckets[HIST_SLOTS];
+
+// A fatia volta a ficar livre quando a thread termina; os valores ficam
+// e continuam somando com os da próxima dona
+static void shard_release(void* arg) {
+    atomic_fetch_sub_explicit(&((MetricsShard*)arg)->owners, 1, memory_order_relaxed);
+}
+
+static void key_init(void) {
+    pthread_key_create(&g_shard_key, shard_release);
+    g_start_ns = metrics_now();
+    g_last_ns = g_start_ns;
+}
+
+// Primeira gravação da thread: procura uma fatia sem dona; se todas
+// estiverem ocupadas, divide uma com outras threads
+static MetricsShard* shard_claim(void) {
+    metrics_init();
+    MetricsShard* s = NULL;
+    for (size_t i = 0; i < METRICS_SHARDS && !s; i++) {
+        int expected = 0;
+        if (atomic_compare_exchange_strong(&g_shards[i].owners, &expected, 1)) s = &g_shards[i];
+    }
+    if (!s) {
+        s = &g_shards[atomic_fetch_add(&g_next_shard, 1) % METRICS_SHARDS];
+        atomic_fetch_add_explicit(&s->owners, 1, memory_order_relaxed);
+    }
+    pthread_setspecific(g_shard_key, s);
+    t_shard = s;
+    return s;
+}
+
+static inline MetricsShard* my_shard(void) {
+    MetricsShard* s = t_shard;
+    return s ? s : shard_claim();
+}
+
+void metrics_init(void) {
+    pthread_once(&g_key_once, key_init);
+}
+
+void metrics_record(MetricStage stage, uint64_t start_ns) {
+    uint64_t now = metrics_now();
+    uint64_t v = now > start_ns ? now - start_ns : 0;
+    Histogram* h = &my_shard()->stages[stage];
+
+    atomic_fetch_add_explicit(&h->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->sum, v, memory_order_relaxed);
+    atomic_fetch_add_explicit(&h->buckets[hist_bucket_of(v, HIST_SUB_BITS, HIST_MAX_EXP)], 1, memory_order_relaxed);
+    unsigned long long max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    while (v > max && !atomic_compare_exchange_weak_explicit(&h->max, &max, v, memory_order_relaxed,
+                                                             memory_order_relaxed)) {
+    }
+}
+
+void metrics_add(MetricCounter counter, uint64_t n) {
+    atomic_fetch_add_explicit(&my_shard()->counters[counter], n, memory_order_relaxed);
+}
+
+// --- Fotografia ---
+
+// Percentil q (0 a 1) do histograma somado em g_sum_buckets
+static uint64_t sum_percentile(unsigned long long count, unsigned long long max, double q) {
+    return hist_percentile(g_sum_buckets, HIST_SUB_BITS, HIST_MAX_EXP, count, max, q);
+}
+
+// Acrescenta ao texto em out sem passar de cap
+__attribute__((format(printf, 4, 5)))
+static void put(char* out, size_t cap, size_t* len, const char* fmt, ...) {
+    if (*len >= cap) return;
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(out + *len, cap - *len, fmt, args);
+    va_end(args);
+    if (n > 0) *len += (size_t)n < cap - *len ? (size_t)n : cap - *len - 1;
+}
+
+size_t metrics_snapshot(char* out, size_t cap) {
+    if (cap == 0) return 0;
+    out[0] = '\0';
+    metrics_init();
+    pthread_mutex_lock(&g_snap_mutex);
+
+    uint64_t now = metrics_now();
+    double uptime = (double)(now - g_start_ns) / 1e9;
+    double since = (double)(now - g_last_ns) / 1e9;
+    if (uptime <= 0) uptime = 1e-9;
+    if (since <= 0) since = 1e-9;
+
+    unsigned long long total[METRIC_COUNTERS] = { 0 };
+    for (size_t i = 0; i < METRICS_SHARDS; i++) {
+        for (int k = 0; k < METRIC_COUNTERS; k++) {
+            total[k] += atomic_load_explicit(&g_shards[i].counters[k], memory_order_relaxed);
+        }
+    }
+
+    // Taxa média desde o início e desde a fotografia anterior
+    double rate[METRIC_COUNTERS], recent[METRIC_COUNTERS];
+    for (int k = 0; k < METRIC_COUNTERS; k++) {
+        rate[k] = (double)total[k] / uptime;
+        recent[k] = (double)(total[k] - g_last[k]) / since;
+        g_last[k] = total[k];
+    }
+    g_last_ns = now;
+
+    size_t len = 0;
+    unsigned long long opened = total[METRIC_CONN_OPENED], closed = total[METRIC_CONN_CLOSED];
+    put(out, cap, &len, "Estatísticas do servidor (no ar há %.1f s; taxas: média desde o início / últimos %.1f s)\n",
+        uptime, since);
+    put(out, cap, &len, "Conexões: %llu ativas, %llu abertas (%.1f/s / %.1f/s), %llu fechadas\n",
+        opened > closed ? opened - closed : 0, opened, rate[METRIC_CONN_OPENED], recent[METRIC_CONN_OPENED], closed);
+    put(out, cap, &len, "Mensagens: %llu públicas (%.1f/s / %.1f/s), %llu privadas (%.1f/s / %.1f/s), %llu entregas (%.1f/s / %.1f/s)\n",
+        total[METRIC_MSG_PUBLIC], rate[METRIC_MSG_PUBLIC], recent[METRIC_MSG_PUBLIC],
+        total[METRIC_MSG_PRIVATE], rate[METRIC_MSG_PRIVATE], recent[METRIC_MSG_PRIVATE],
+        total[METRIC_MSG_DELIVERED], rate[METRIC_MSG_DELIVERED], recent[METRIC_MSG_DELIVERED]);
+    put(out, cap, &len, "Bytes: %llu recebidos (%.0f/s / %.0f/s), %llu enviados (%.0f/s / %.0f/s)\n",
+        total[METRIC_BYTES_IN], rate[METRIC_BYTES_IN], recent[METRIC_BYTES_IN],
+        total[METRIC_BYTES_OUT], rate[METRIC_BYTES_OUT], recent[METRIC_BYTES_OUT]);
+    put(out, cap, &len, "Etapa      amostras     média       p50       p90       p99     p99.9       máx (µs)\n");
+
+    for (int st = 0; st < METRIC_STAGES; st++) {
+        unsigned long long count = 0, sum = 0, max = 0;
+        memset(g_sum_buckets, 0, sizeof(g_sum_buckets));
+        for (size_t i = 0; i < METRICS_SHARDS; i++) {
+            Histogram* h = &g_shards[i].stages[st];
+            unsigned long long c = atomic_load_explicit(&h->count, memory_order_relaxed);
+            if (c == 0) continue;
+            count += c;
+            sum += atomic_load_explicit(&h->sum, memory_order_relaxed);
+            unsigned long long m = atomic_load_explicit(&h->max, memory_order_relaxed);
+            if (m > max) max = m;
+            for (unsigned b = 0; b < HIST_SLOTS; b++) {
+                g_sum_buckets[b] += atomic_load_explicit(&h->buckets[b], memory_order_relaxed);
+            }
+        }
+        if (count == 0) {
+            put(out, cap, &len, "%-8s %10d         -         -         -         -         -         -\n",
+                g_stage_names[st], 0);
+            continue;
+        }
+        // As faixas e count são lidos em momentos um pouco diferentes; os
+        // percentis usam o total das faixas
+        unsigned long long in_buckets = 0;
+        for (unsigned b = 0; b < HIST_SLOTS; b++) in_buckets += g_sum_buckets[b];
+        put(out, cap, &len, "%-8s %10llu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+            g_stage_names[st], count, (double)sum / (double)count / 1e3,
+            sum_percentile(in_buckets, max, 0.50) / 1e3, sum_percentile(in_buckets, max, 0.90) / 1e3,
+            sum_percentile(in_buckets, max, 0.99) / 1e3, sum_percentile(in_buckets, max, 0.999) / 1e3,
+            max / 1e3);
+    }
+
+    pthread_mutex_unlock(&g_snap_mutex);
+    return len;
+}
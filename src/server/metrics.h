@@ -0,0 +1,86 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+/**
+ * @brief Contadores e histogramas de latência do servidor.
+ *
+ * Cada thread grava em uma fatia própria (escolhida na primeira gravação),
+ * com operações atômicas relaxadas: não há lock nem linha de cache
+ * disputada enquanto houver no máximo METRICS_SHARDS threads gravando.
+ * Acima disso (modo threads com muitas conexões) as threads passam a
+ * dividir fatias, o que continua correto, só um pouco mais caro.
+ *
+ * Os histogramas são log-lineares, como os do HdrHistogram: cada potência
+ * de 2 é dividida em 8 faixas, então qualquer percentil sai com erro
+ * relativo de no máximo 12,5%, com tamanho fixo e gravação em O(1).
+ * metrics_snapshot() soma as fatias sob demanda.
+ */
+
+#define METRICS_SHARDS 64
+#define METRICS_TEXT_MAX 4096 // Espaço suficiente para uma fotografia em texto
+
+// Etapas com histograma de latência
+typedef enum {
+    METRIC_READ,    // read() do socket (modos threads, epoll e shards)
+    METRIC_INPUT,   // Tratamento de uma leitura: quadros/linhas e comandos
+    METRIC_FILTER,  // filter_message()
+    METRIC_HISTORY, // Log em disco e histórico da sala, com a espera pelo lock
+    METRIC_FANOUT,  // Entrega a todos os destinatários
+    METRIC_LOG,     // Enfileiramento da mensagem no logger
+    METRIC_STAGES
+} MetricStage;
+
+// Contadores acumulados desde o início do servidor
+typedef enum {
+    METRIC_CONN_OPENED,
+    METRIC_CONN_CLOSED,
+    METRIC_MSG_PUBLIC,    // Mensagens públicas recebidas
+    METRIC_MSG_PRIVATE,   // Mensagens privadas entregues
+    METRIC_MSG_DELIVERED, // Cópias entregues às filas de saída no fan-out
+    METRIC_BYTES_IN,
+    METRIC_BYTES_OUT,
+    METRIC_COUNTERS
+} MetricCounter;
+
+/**
+ * @brief Relógio das medições, em ns (CLOCK_MONOTONIC, via vDSO).
+ */
+static inline uint64_t metrics_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Marca o início das taxas; chamada uma vez ao iniciar o servidor.
+ *
+ * Opcional: sem ela, o início é a primeira gravação.
+ */
+void metrics_init(void);
+
+/**
+ * @brief Registra no histograma da etapa o tempo decorrido desde start_ns.
+ * @param start_ns Valor de metrics_now() no início da etapa.
+ */
+void metrics_record(MetricStage stage, uint64_t start_ns);
+
+/**
+ * @brief Soma n ao contador.
+ */
+void metrics_add(MetricCounter counter, uint64_t n);
+
+/**
+ * @brief Escreve em out (terminado em '\0') uma fotografia em texto: taxas
+ *        dos contadores e percentis de cada etapa.
+ *
+ * As taxas são médias desde o início e desde a fotografia anterior.
+ * Thread-safe; pode ser chamada de qualquer thread.
+ * @return Número de bytes escritos, sem o '\0'.
+ */
+size_t metrics_snapshot(char* out, size_t cap);
+
+#endif
@@ -0,0 +1,496 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "server/moderation.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define MOD_HAVE_X86 1
+#endif
+
+// Limite de memória das linhas densas da tabela de transições
+#define DENSE_BUDGET_BYTES (4u << 20)
+
+/*
+ * Pré-filtro de rejeição rápida: a grande maioria das mensagens não contém
+ * nenhuma palavra da lista, então antes do autômato procuramos, em blocos de
+ * 16/32 bytes, posições cujo byte inicia alguma palavra. Cada candidata é
+ * confirmada pelo par de bytes inicial (bitmap de 64K pares); só se alguma
+ * sobreviver o autômato percorre a mensagem.
+ */
+typedef struct {
+    ModScan scan;
+    uint8_t first[256];   // Byte (em qualquer caixa) que inicia alguma palavra
+    uint8_t single[256];  // Byte minúsculo que sozinho já é uma palavra
+    uint64_t pairs[1024]; // Pares iniciais minúsculos das palavras com 2+ bytes
+    uint8_t lower[16];    // Bytes iniciais distintos em minúsculas (SSE2)
+    uint32_t num_lower;
+    uint8_t nib_lo[16];   // Máscaras de grupo por nibble (AVX2)
+    uint8_t nib_hi[16];
+} Prefilter;
+
+/*
+ * Layout do autômato:
+ * - Os bytes são agrupados em classes: cada byte (já em minúsculas) que
+ *   aparece em alguma palavra ganha uma classe; todos os demais caem na
+ *   classe 0, que sempre leva de volta à raiz. Isso reduz o alfabeto de 256
+ *   para algumas dezenas de colunas.
+ * - Os estados são numerados em ordem BFS, então os mais rasos (os mais
+ *   visitados em texto comum) vêm primeiro. Os primeiros num_dense estados
+ *   têm uma linha densa com a transição completa (já resolvendo as falhas):
+ *   um único acesso por byte.
+ * - Os estados profundos usam arestas compactas (CSR) ordenadas por classe
+ *   e o link de falha, que sempre termina em um estado denso.
+ */
+struct ModMatcher {
+    uint8_t cls[256];
+    uint32_t num_classes;
+    uint32_t num_states;
+    uint32_t num_dense;
+    uint32_t* dense;      // num_dense * num_classes
+    uint32_t* edge_start; // num_states + 1
+    uint8_t* edge_cls;
+    uint32_t* edge_to;
+    uint32_t* fail;
+    uint16_t* match_len;  // Maior palavra que termina no estado (0 = nenhuma)
+    Prefilter pre;
+};
+
+// Nó da trie usado apenas durante a construção
+typedef struct {
+    uint32_t first_child;
+    uint32_t next_sibling;
+    uint16_t own_len;
+    uint8_t cls;
+} BuildNode;
+
+static unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (unsigned char)(c - 'A' + 'a') : c;
+}
+
+static uint32_t find_edge(const ModMatcher* m, uint32_t s, uint8_t c) {
+    uint32_t lo = m->edge_start[s], hi = m->edge_start[s + 1];
+    while (lo < hi) {
+        uint32_t mid = (lo + hi) / 2;
+        if (m->edge_cls[mid] < c) lo = mid + 1;
+        else hi = mid;
+    }
+    return (lo < m->edge_start[s + 1] && m->edge_cls[lo] == c) ? m->edge_to[lo] : 0;
+}
+
+static inline uint32_t step(const ModMatcher* m, uint32_t s, uint8_t c) {
+    while (s >= m->num_dense) {
+        uint32_t next = find_edge(m, s, c);
+        if (next) return next;
+        s = m->fail[s];
+    }
+    return m->dense[(size_t)s * m->num_classes + c];
+}
+
+static inline int pre_confirm(const Prefilter* p, const unsigned char* t, size_t i, size_t len) {
+    unsigned a = fold(t[i]);
+    if (p->single[a]) return 1;
+    if (i + 1 >= len) return 0;
+    unsigned pair = (a << 8) | fold(t[i + 1]);
+    return (int)((p->pairs[pair >> 6] >> (pair & 63)) & 1);
+}
+
+// Primeira posição confirmada do bloco em base, ou len se nenhuma
+static size_t confirm_bits(const Prefilter* p, const unsigned char* t, size_t base, uint32_t bits, size_t len) {
+    while (bits) {
+        size_t i = base + (size_t)__builtin_ctz(bits);
+        if (pre_confirm(p, t, i, len)) return i;
+        bits &= bits - 1;
+    }
+    return len;
+}
+
+static size_t scan_scalar(const Prefilter* p, const unsigned char* t, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        if (p->first[t[i]] && pre_confirm(p, t, i, len)) return i;
+    }
+    return len;
+}
+
+#if defined(MOD_HAVE_X86) && defined(__SSE2__)
+// Compara o bloco (convertido para minúsculas) com cada byte inicial
+static inline uint32_t block_sse2(const Prefilter* p, const __m128i* needles, const unsigned char* src) {
+    const __m128i bias = _mm_set1_epi8((char)(128 - 'A'));
+    const __m128i limit = _mm_set1_epi8((char)(-128 + 26));
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+
+    __m128i v = _mm_loadu_si128((const __m128i*)src);
+    __m128i upper = _mm_cmplt_epi8(_mm_add_epi8(v, bias), limit);
+    __m128i folded = _mm_or_si128(v, _mm_and_si128(upper, case_bit));
+    __m128i hit = _mm_setzero_si128();
+    for (uint32_t k = 0; k < p->num_lower; k++) {
+        hit = _mm_or_si128(hit, _mm_cmpeq_epi8(folded, needles[k]));
+    }
+    return (uint32_t)_mm_movemask_epi8(hit);
+}
+
+static size_t scan_sse2(const Prefilter* p, const unsigned char* t, size_t len) {
+    __m128i needles[16];
+    for (uint32_t k = 0; k < p->num_lower; k++) needles[k] = _mm_set1_epi8((char)p->lower[k]);
+
+    size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+        size_t found = confirm_bits(p, t, i, block_sse2(p, needles, t + i), len);
+        if (found < len) return found;
+    }
+    if (i < len) {
+        unsigned char tail[16] = {0};
+        memcpy(tail, t + i, len - i);
+        uint32_t bits = block_sse2(p, needles, tail) & ((1u << (len - i)) - 1);
+        return confirm_bits(p, t, i, bits, len);
+    }
+    return len;
+}
+#endif
+
+#ifdef MOD_HAVE_X86
+/*
+ * Classificação por nibbles (vpshufb): cada nibble alto distinto ganha um
+ * grupo de 8 bits; o byte é candidato se nib_lo[lo] & nib_hi[hi] != 0. Com
+ * até 8 nibbles altos distintos (o caso de texto ASCII) o teste é exato;
+ * acima disso pode haver falsos positivos, nunca falsos negativos.
+ */
+__attribute__((target("avx2")))
+static inline uint32_t block_avx2(__m256i lo_tab, __m256i hi_tab, const unsigned char* src) {
+    const __m256i low4 = _mm256_set1_epi8(0x0f);
+    __m256i v = _mm256_loadu_si256((const __m256i*)src);
+    __m256i lo = _mm256_shuffle_epi8(lo_tab, _mm256_and_si256(v, low4));
+    __m256i hi = _mm256_shuffle_epi8(hi_tab, _mm256_and_si256(_mm256_srli_epi16(v, 4), low4));
+    __m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+    return ~(uint32_t)_mm256_movemask_epi8(miss);
+}
+
+/*
+ * Procura o próximo bloco de 32 bytes com candidatas a partir de i. A
+ * confirmação fica fora desta função para que todo retorno passe pelo
+ * vzeroupper do epílogo e o código SSE seguinte não pague a transição.
+ */
+__attribute__((target("avx2")))
+static size_t next_block_avx2(const Prefilter* p, const unsigned char* t, size_t len, size_t i, uint32_t* bits) {
+    __m256i lo_tab = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)p->nib_lo));
+    __m256i hi_tab = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)p->nib_hi));
+
+    for (; i + 32 <= len; i += 32) {
+        *bits = block_avx2(lo_tab, hi_tab, t + i);
+        if (*bits) return i;
+    }
+    if (i < len) {
+        unsigned char tail[32] = {0};
+        memcpy(tail, t + i, len - i);
+        *bits = block_avx2(lo_tab, hi_tab, tail) & ((1u << (len - i)) - 1);
+        if (*bits) return i;
+    }
+    return len;
+}
+
+static size_t scan_avx2(const Prefilter* p, const unsigned char* t, size_t len) {
+    uint32_t bits;
+    for (size_t i = 0; (i = next_block_avx2(p, t, len, i, &bits)) < len; i += 32) {
+        size_t found = confirm_bits(p, t, i, bits, len);
+        if (found < len) return found;
+    }
+    return len;
+}
+#endif
+
+static void prefilter_build(Prefilter* p, const char* const* words, size_t count) {
+    for (size_t w = 0; w < count; w++) {
+        const unsigned char* word = (const unsigned char*)words[w];
+        if (!word[0]) continue;
+
+        unsigned char a = fold(word[0]);
+        if (!p->first[a]) {
+            if (p->num_lower < sizeof(p->lower)) p->lower[p->num_lower] = a;
+            p->num_lower++;
+        }
+        p->first[a] = 1;
+        if (a >= 'a' && a <= 'z') p->first[a - 'a' + 'A'] = 1;
+
+        if (!word[1]) {
+            p->single[a] = 1;
+        } else {
+            unsigned pair = ((unsigned)a << 8) | fold(word[1]);
+            p->pairs[pair >> 6] |= 1ull << (pair & 63);
+        }
+    }
+
+    int group[16];
+    int groups = 0;
+    for (int h = 0; h < 16; h++) group[h] = -1;
+    for (int b = 0; b < 256; b++) {
+        if (!p->first[b]) continue;
+        int h = b >> 4;
+        if (group[h] < 0) group[h] = groups++ % 8;
+        uint8_t bit = (uint8_t)(1u << group[h]);
+        p->nib_hi[h] |= bit;
+        p->nib_lo[b & 15] |= bit;
+    }
+
+    p->scan = MOD_SCAN_SCALAR;
+#if defined(MOD_HAVE_X86) && defined(__SSE2__)
+    if (p->num_lower <= sizeof(p->lower)) p->scan = MOD_SCAN_SSE2;
+#endif
+#ifdef MOD_HAVE_X86
+    if (__builtin_cpu_supports("avx2")) p->scan = MOD_SCAN_AVX2;
+#endif
+}
+
+/*
+ * Retorna a primeira posição onde uma palavra pode começar, ou len se com
+ * certeza nenhuma ocorre. Como nenhuma ocorrência começa antes dela, o
+ * autômato pode partir da raiz a partir desse ponto.
+ */
+static size_t prefilter_first(const Prefilter* p, const unsigned char* t, size_t len) {
+    switch (p->scan) {
+#ifdef MOD_HAVE_X86
+    case MOD_SCAN_AVX2: return scan_avx2(p, t, len);
+#endif
+#if defined(MOD_HAVE_X86) && defined(__SSE2__)
+    case MOD_SCAN_SSE2: return scan_sse2(p, t, len);
+#endif
+    case MOD_SCAN_SCALAR: return scan_scalar(p, t, len);
+    default: return 0;
+    }
+}
+
+ModScan mod_matcher_scan(const ModMatcher* m) {
+    return m ? m->pre.scan : MOD_SCAN_NONE;
+}
+
+int mod_matcher_set_scan(ModMatcher* m, ModScan scan) {
+    switch (scan) {
+    case MOD_SCAN_NONE:
+    case MOD_SCAN_SCALAR:
+        break;
+    case MOD_SCAN_SSE2:
+#if defined(MOD_HAVE_X86) && defined(__SSE2__)
+        if (m->pre.num_lower <= sizeof(m->pre.lower)) break;
+#endif
+        return -1;
+    case MOD_SCAN_AVX2:
+#ifdef MOD_HAVE_X86
+        if (__builtin_cpu_supports("avx2")) break;
+#endif
+        return -1;
+    default:
+        return -1;
+    }
+    m->pre.scan = scan;
+    return 0;
+}
+
+void mod_matcher_free(ModMatcher* m) {
+    if (!m) return;
+    free(m->dense);
+    free(m->edge_start);
+    free(m->edge_cls);
+    free(m->edge_to);
+    free(m->fail);
+    free(m->match_len);
+    free(m);
+}
+
+// Insere a palavra na trie de construção; retorna -1 se faltar memória
+static int trie_insert(BuildNode** nodes, uint32_t* count, uint32_t* cap,
+                       const uint8_t* cls, const char* word, size_t len) {
+    uint32_t s = 0;
+    for (size_t i = 0; i < len; i++) {
+        uint8_t c = cls[fold((unsigned char)word[i])];
+
+        // Filhos mantidos em ordem crescente de classe
+        uint32_t prev = 0, child = (*nodes)[s].first_child;
+        while (child && (*nodes)[child].cls < c) {
+            prev = child;
+            child = (*nodes)[child].next_sibling;
+        }
+        if (child && (*nodes)[child].cls == c) {
+            s = child;
+            continue;
+        }
+
+        if (*count == *cap) {
+            uint32_t new_cap = *cap * 2;
+            BuildNode* grown = (BuildNode*)realloc(*nodes, new_cap * sizeof(BuildNode));
+            if (!grown) return -1;
+            *nodes = grown;
+            *cap = new_cap;
+        }
+        uint32_t id = (*count)++;
+        (*nodes)[id] = (BuildNode){ .first_child = 0, .next_sibling = child, .own_len = 0, .cls = c };
+        if (prev) (*nodes)[prev].next_sibling = id;
+        else (*nodes)[s].first_child = id;
+        s = id;
+    }
+    if (len > (*nodes)[s].own_len) {
+        (*nodes)[s].own_len = (uint16_t)(len > UINT16_MAX ? UINT16_MAX : len);
+    }
+    return 0;
+}
+
+ModMatcher* mod_matcher_build(const char* const* words, size_t count) {
+    ModMatcher* m = (ModMatcher*)calloc(1, sizeof(ModMatcher));
+    if (!m) return NULL;
+
+    // 1. Classes de bytes
+    uint32_t k = 1;
+    for (size_t w = 0; w < count; w++) {
+        for (const unsigned char* p = (const unsigned char*)words[w]; *p; p++) {
+            unsigned char f = fold(*p);
+            if (!m->cls[f] && k < 256) m->cls[f] = (uint8_t)k++;
+        }
+    }
+    for (int c = 'A'; c <= 'Z'; c++) m->cls[c] = m->cls[c - 'A' + 'a'];
+    m->num_classes = k;
+
+    // 2. Trie de construção
+    uint32_t n = 1, cap = 1024;
+    BuildNode* nodes = (BuildNode*)calloc(cap, sizeof(BuildNode));
+    if (!nodes) {
+        mod_matcher_free(m);
+        return NULL;
+    }
+    for (size_t w = 0; w < count; w++) {
+        size_t len = strlen(words[w]);
+        if (len == 0) continue;
+        if (trie_insert(&nodes, &n, &cap, m->cls, words[w], len) < 0) {
+            free(nodes);
+            mod_matcher_free(m);
+            return NULL;
+        }
+    }
+
+    // 3. Renumeração BFS: os filhos de cada estado ficam contíguos
+    uint32_t* order = (uint32_t*)malloc(n * sizeof(uint32_t));
+    m->num_states = n;
+    m->edge_start = (uint32_t*)malloc((n + 1) * sizeof(uint32_t));
+    m->edge_cls = (uint8_t*)malloc(n * sizeof(uint8_t));
+    m->edge_to = (uint32_t*)malloc(n * sizeof(uint32_t));
+    m->fail = (uint32_t*)calloc(n, sizeof(uint32_t));
+    m->match_len = (uint16_t*)calloc(n, sizeof(uint16_t));
+
+    uint64_t rows = DENSE_BUDGET_BYTES / (k * sizeof(uint32_t));
+    m->num_dense = rows < n ? (uint32_t)rows : n;
+    m->dense = (uint32_t*)malloc((size_t)m->num_dense * k * sizeof(uint32_t));
+
+    if (!order || !m->edge_start || !m->edge_cls || !m->edge_to || !m->fail || !m->match_len || !m->dense) {
+        free(order);
+        free(nodes);
+        mod_matcher_free(m);
+        return NULL;
+    }
+
+    uint32_t head = 0, tail = 0, edges = 0;
+    order[tail++] = 0;
+    while (head < tail) {
+        uint32_t old = order[head];
+        m->edge_start[head] = edges;
+        for (uint32_t child = nodes[old].first_child; child; child = nodes[child].next_sibling) {
+            m->edge_cls[edges] = nodes[child].cls;
+            m->edge_to[edges] = tail;
+            m->match_len[tail] = nodes[child].own_len;
+            edges++;
+            order[tail++] = child;
+        }
+        head++;
+    }
+    m->edge_start[n] = edges;
+    free(order);
+    free(nodes);
+
+    // 4. Links de falha, saídas e linhas densas, em ordem BFS
+    for (uint32_t s = 0; s < n; s++) {
+        if (s < m->num_dense) {
+            uint32_t* row = &m->dense[(size_t)s * k];
+            for (uint32_t c = 0; c < k; c++) {
+                uint32_t next = find_edge(m, s, (uint8_t)c);
+                if (!next && s != 0 && c != 0) next = step(m, m->fail[s], (uint8_t)c);
+                row[c] = c == 0 ? 0 : next;
+            }
+        }
+        for (uint32_t e = m->edge_start[s]; e < m->edge_start[s + 1]; e++) {
+            uint32_t u = m->edge_to[e];
+            uint32_t f = (s == 0) ? 0 : step(m, m->fail[s], m->edge_cls[e]);
+            m->fail[u] = f;
+            if (m->match_len[f] > m->match_len[u]) m->match_len[u] = m->match_len[f];
+        }
+    }
+
+    prefilter_build(&m->pre, words, count);
+    return m;
+}
+
+ModMatcher* mod_matcher_load(const char* path, size_t* num_words) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) return NULL;
+
+    char** words = NULL;
+    size_t count = 0, cap = 0;
+    char* line = NULL;
+    size_t line_cap = 0;
+
+    while (getline(&line, &line_cap, file) != -1) {
+        // Ignora linhas de comentário (que começam com #) e linhas vazias
+        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '\0') continue;
+
+        if (count == cap) {
+            cap = cap ? cap * 2 : 64;
+            char** grown = (char**)realloc(words, cap * sizeof(char*));
+            if (!grown) break;
+            words = grown;
+        }
+        words[count] = strdup(line);
+        if (words[count]) count++;
+    }
+    free(line);
+    fclose(file);
+
+    ModMatcher* m = mod_matcher_build((const char* const*)words, count);
+    for (size_t i = 0; i < count; i++) free(words[i]);
+    free(words);
+
+    if (num_words) *num_words = count;
+    return m;
+}
+
+size_t mod_matcher_censor(const ModMatcher* m, char* text) {
+    if (!m) return 0;
+    size_t len = strlen(text);
+    size_t from = prefilter_first(&m->pre, (const unsigned char*)text, len);
+    if (from == len) return 0;
+
+    size_t matches = 0;
+    size_t run_start = 0, run_end = 0; // Trecho contíguo já censurado [início, fim)
+    uint32_t s = 0;
+
+    for (size_t i = from; i < len; i++) {
+        uint8_t c = m->cls[(unsigned char)text[i]];
+        s = c ? step(m, s, c) : 0;
+
+        uint16_t len = m->match_len[s];
+        if (len) {
+            // A maior palavra que termina aqui cobre todas as menores
+            size_t start = i + 1 - len;
+            if (start >= run_start && start <= run_end) {
+                memset(text + run_end, '*', i + 1 - run_end);
+            } else {
+                memset(text + start, '*', i + 1 - start);
+                run_start = start;
+            }
+            run_end = i + 1;
+            matches++;
+        }
+    }
+    return matches;
+}
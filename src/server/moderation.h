@@ -0,0 +1,66 @@
+#ifndef MODERATION_H
+#define MODERATION_H
+
+#include <stddef.h>
+
+/**
+ * @brief Autômato Aho-Corasick imutável com a lista de moderação.
+ *
+ * Construído uma única vez a partir da lista de palavras (comparação sem
+ * distinção de maiúsculas/minúsculas ASCII). Depois de pronto pode ser usado
+ * por várias threads ao mesmo tempo sem sincronização.
+ */
+typedef struct ModMatcher ModMatcher;
+
+/**
+ * @brief Implementação do pré-filtro que descarta mensagens sem candidatas.
+ *
+ * A melhor disponível é escolhida em tempo de execução na construção;
+ * MOD_SCAN_NONE desliga o pré-filtro e sempre executa o autômato.
+ */
+typedef enum {
+    MOD_SCAN_NONE,
+    MOD_SCAN_SCALAR,
+    MOD_SCAN_SSE2,
+    MOD_SCAN_AVX2
+} ModScan;
+
+/**
+ * @brief Constrói o autômato a partir de uma lista de palavras.
+ * @return O autômato, ou NULL se faltar memória.
+ */
+ModMatcher* mod_matcher_build(const char* const* words, size_t count);
+
+/**
+ * @brief Lê o arquivo de moderação e constrói o autômato.
+ *
+ * Linhas vazias e linhas iniciadas por '#' são ignoradas.
+ * @param num_words Recebe o número de palavras carregadas (pode ser NULL).
+ * @return O autômato, ou NULL se o arquivo não puder ser lido.
+ */
+ModMatcher* mod_matcher_load(const char* path, size_t* num_words);
+
+void mod_matcher_free(ModMatcher* m);
+
+ModScan mod_matcher_scan(const ModMatcher* m);
+
+/**
+ * @brief Força uma implementação do pré-filtro (para benchmarks e testes).
+ *
+ * Deve ser chamada antes de o autômato ser compartilhado entre threads.
+ * @return 0 em sucesso, -1 se a implementação não estiver disponível.
+ */
+int mod_matcher_set_scan(ModMatcher* m, ModScan scan);
+
+/**
+ * @brief Substitui por '*' todas as ocorrências das palavras em text.
+ *
+ * Uma única passagem linear, independente do tamanho da lista. Mensagens
+ * sem nenhuma posição candidata são descartadas pelo pré-filtro SIMD sem
+ * passar pelo autômato.
+ * @param m Autômato, ou NULL (filtro desativado: text não é alterado).
+ * @return Número de ocorrências encontradas.
+ */
+size_t mod_matcher_censor(const ModMatcher* m, char* text);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MPSC_H
+#define MPSC_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+
+/**
+ * @brief Fila intrusiva MPSC (múltiplos produtores, um consumidor) sem locks.
+ *
+ * Produtores inserem com um único atomic_exchange; apenas a thread dona
+ * consome. Os nós ficam embutidos nas estruturas enfileiradas, então não há
+ * alocação por operação.
+ */
+typedef struct MpscNode {
+    _Atomic(struct MpscNode*) next;
+} MpscNode;
+
+typedef struct {
+    _Atomic(MpscNode*) head; // Produtores inserem aqui
+    MpscNode* tail;          // Apenas o consumidor acessa
+    MpscNode stub;
+} MpscQueue;
+
+static inline void mpsc_init(MpscQueue* q) {
+    atomic_init(&q->stub.next, NULL);
+    atomic_init(&q->head, &q->stub);
+    q->tail = &q->stub;
+}
+
+static inline void mpsc_push(MpscQueue* q, MpscNode* node) {
+    atomic_store(&node->next, NULL);
+    MpscNode* prev = atomic_exchange(&q->head, node);
+    atomic_store(&prev->next, node);
+}
+
+/**
+ * @brief Remove o nó mais antigo.
+ *
+ * Retorna NULL se a fila estiver vazia ou se um produtor ainda não concluiu
+ * a inserção; nesse caso o produtor deve acordar o consumidor ao terminar.
+ */
+static inline MpscNode* mpsc_pop(MpscQueue* q) {
+    MpscNode* tail = q->tail;
+    MpscNode* next = atomic_load(&tail->next);
+
+    if (tail == &q->stub) {
+        if (next == NULL) return NULL;
+        q->tail = next;
+        tail = next;
+        next = atomic_load(&next->next);
+    }
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+    if (tail != atomic_load(&q->head)) return NULL;
+
+    // Último elemento: recoloca o stub para poder removê-lo
+    mpsc_push(q, &q->stub);
+    next = atomic_load(&tail->next);
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+#endif
@@ -0,0 +1,146 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "server/msgbuf.h"
+
+// O cabeçalho de quadro precisa ficar colado ao texto
+_Static_assert(offsetof(MsgBuf, data) == offsetof(MsgBuf, frame) + sizeof(((MsgBuf*)0)->frame),
+               "MsgBuf.frame deve preceder data sem preenchimento");
+
+// Máximo de buffers livres guardados por classe
+#define POOL_MAX_FREE 4096
+
+// Capacidades das classes (data + '\0'); maiores vão direto ao malloc
+static const size_t g_class_cap[] = { 128, 512, 2048, 8192 };
+#define NUM_CLASSES (sizeof(g_class_cap) / sizeof(g_class_cap[0]))
+
+typedef struct {
+    pthread_mutex_t mutex;
+    MsgBuf* free_list;
+    size_t free_count;
+} PoolClass;
+
+static PoolClass g_pool[NUM_CLASSES] = {
+    { PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+    { PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+    { PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+    { PTHREAD_MUTEX_INITIALIZER, NULL, 0 },
+};
+
+MsgBuf* msgbuf_alloc(size_t len) {
+    MsgBuf* buf = NULL;
+    int size_class = -1;
+    size_t cap = len + 1;
+
+    for (size_t i = 0; i < NUM_CLASSES; i++) {
+        if (cap <= g_class_cap[i]) {
+            size_class = (int)i;
+            cap = g_class_cap[i];
+            break;
+        }
+    }
+
+    if (size_class >= 0) {
+        PoolClass* pc = &g_pool[size_class];
+        pthread_mutex_lock(&pc->mutex);
+        buf = pc->free_list;
+        if (buf) {
+            pc->free_list = buf->next_free;
+            pc->free_count--;
+        }
+        pthread_mutex_unlock(&pc->mutex);
+    }
+    if (!buf) {
+        buf = (MsgBuf*)malloc(sizeof(MsgBuf) + cap);
+        if (!buf) return NULL;
+        buf->size_class = size_class;
+        buf->cap = cap;
+    }
+
+    atomic_init(&buf->refs, 1);
+    buf->len = len;
+    buf->payload_len = len;
+    buf->seq = 0;
+    buf->next_free = NULL;
+    buf->data[len] = '\0';
+    return buf;
+}
+
+MsgBuf* msgbuf_from(const char* data, size_t len) {
+    MsgBuf* buf = msgbuf_alloc(len);
+    if (buf) {
+        memcpy(buf->data, data, len);
+        msgbuf_set_type(buf, FRAME_SYSTEM);
+    }
+    return buf;
+}
+
+void msgbuf_set_type(MsgBuf* buf, FrameType type) {
+    buf->payload_len = buf->len;
+    if (buf->len > 0 && buf->data[buf->len - 1] == '\n') buf->payload_len--;
+    frame_write_header(buf->frame, type, (uint32_t)(FRAME_SEQ_SIZE + buf->payload_len));
+    frame_put_seq(buf->frame + FRAME_HEADER_SIZE, buf->seq);
+}
+
+void msgbuf_set_seq(MsgBuf* buf, uint64_t seq) {
+    buf->seq = seq;
+    frame_put_seq(buf->frame + FRAME_HEADER_SIZE, seq);
+}
+
+MsgBuf* msgbuf_printf(const char* fmt, ...) {
+    // Formata direto em um buffer da classe média; só refaz se não couber
+    MsgBuf* buf = msgbuf_alloc(g_class_cap[1] - 1);
+    if (!buf) return NULL;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf->data, buf->cap, fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        msgbuf_unref(buf);
+        return NULL;
+    }
+
+    if ((size_t)n >= buf->cap) {
+        msgbuf_unref(buf);
+        buf = msgbuf_alloc((size_t)n);
+        if (!buf) return NULL;
+        va_start(ap, fmt);
+        vsnprintf(buf->data, buf->cap, fmt, ap);
+        va_end(ap);
+    }
+    buf->len = (size_t)n;
+    msgbuf_set_type(buf, FRAME_SYSTEM);
+    return buf;
+}
+
+void msgbuf_ref(MsgBuf* buf) {
+    atomic_fetch_add_explicit(&buf->refs, 1, memory_order_relaxed);
+}
+
+void msgbuf_unref(MsgBuf* buf) {
+    if (!buf || atomic_fetch_sub_explicit(&buf->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+
+    if (buf->size_class >= 0) {
+        PoolClass* pc = &g_pool[buf->size_class];
+        pthread_mutex_lock(&pc->mutex);
+        if (pc->free_count < POOL_MAX_FREE) {
+            buf->next_free = pc->free_list;
+            pc->free_list = buf;
+            pc->free_count++;
+            buf = NULL;
+        }
+        pthread_mutex_unlock(&pc->mutex);
+    }
+    free(buf);
+}
+
+void msgbuf_release(void* buf) {
+    msgbuf_unref((MsgBuf*)buf);
+}
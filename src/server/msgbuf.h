@@ -0,0 +1,93 @@
+#ifndef MSGBUF_H
+#define MSGBUF_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common/protocol.h"
+
+/**
+ * @brief Mensagem pronta para envio, compartilhada por contagem de referências.
+ *
+ * Uma linha de chat é formatada e filtrada uma única vez dentro de um
+ * MsgBuf; depois disso o conteúdo é imutável e histórico, filas de saída,
+ * caixas de correio dos shards e o logger guardam apenas referências. Os
+ * buffers vêm de um pool com classes de tamanho fixo, então o custo por
+ * mensagem não cresce com o número de destinatários.
+ *
+ * O cabeçalho de quadro (protocol.h) e o número de sequência ficam
+ * reservados logo antes do texto: clientes do protocolo de quadros recebem
+ * frame + conteúdo, clientes de texto recebem apenas data, e ambos
+ * compartilham o mesmo buffer.
+ */
+typedef struct MsgBuf {
+    atomic_int refs;
+    int size_class;           // Classe do pool, ou -1 se alocado à parte
+    size_t cap;               // Bytes disponíveis em data (inclui o '\0')
+    size_t len;
+    size_t payload_len;       // len sem o '\n' final (texto do quadro)
+    uint64_t seq;             // Número de sequência, ou 0 fora da sequência
+    struct MsgBuf* next_free; // Uso interno do pool
+    unsigned char frame[FRAME_HEADER_SIZE + FRAME_SEQ_SIZE];
+    char data[];              // Sempre terminado em '\0'
+} MsgBuf;
+
+/**
+ * @brief Obtém um buffer com espaço para len bytes (mais o '\0').
+ *
+ * O conteúdo pode ser escrito até a primeira referência ser compartilhada;
+ * o chamador deve ajustar len, manter o terminador e chamar
+ * msgbuf_set_type() antes de compartilhá-lo.
+ * @return O buffer com uma referência, ou NULL se faltar memória.
+ */
+MsgBuf* msgbuf_alloc(size_t len);
+
+/**
+ * @brief Cria um buffer (do tipo FRAME_SYSTEM) com uma cópia dos len bytes de data.
+ */
+MsgBuf* msgbuf_from(const char* data, size_t len);
+
+/**
+ * @brief Formata (como snprintf) direto em um buffer do pool, do tipo FRAME_SYSTEM.
+ */
+MsgBuf* msgbuf_printf(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+/**
+ * @brief Preenche o cabeçalho de quadro com o tipo e o tamanho atual.
+ *
+ * Deve ser chamada de novo se len ou o '\n' final mudarem, sempre antes
+ * de compartilhar o buffer.
+ */
+void msgbuf_set_type(MsgBuf* buf, FrameType type);
+
+/**
+ * @brief Grava o número de sequência no quadro (antes de compartilhar).
+ */
+void msgbuf_set_seq(MsgBuf* buf, uint64_t seq);
+
+/**
+ * @brief Bytes a enviar para um cliente de quadros (framed) ou de texto.
+ */
+static inline const char* msgbuf_wire(const MsgBuf* buf, int framed, size_t* len) {
+    if (framed) {
+        *len = sizeof(buf->frame) + buf->payload_len;
+        return (const char*)buf->frame;
+    }
+    *len = buf->len;
+    return buf->data;
+}
+
+void msgbuf_ref(MsgBuf* buf);
+
+/**
+ * @brief Libera uma referência; a última devolve o buffer ao pool.
+ */
+void msgbuf_unref(MsgBuf* buf);
+
+/**
+ * @brief Adaptador para APIs que recebem void (*)(void*), como o logger.
+ */
+void msgbuf_release(void* buf);
+
+#endif
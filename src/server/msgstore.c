@@ -0,0 +1,510 @@
+#define _DEFAULT_SOURCE // DT_*, pwritev
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#include "server/msgstore.h"
+
+// Cabeçalho de cada registro no segmento, seguido de len bytes de texto
+typedef struct {
+    uint32_t len;
+    uint32_t crc; // CRC-32 de seq, ts_ms e do texto
+    uint64_t seq;
+    int64_t ts_ms;
+} RecordHeader;
+
+// Entrada do índice esparso (também o formato do arquivo .idx)
+typedef struct {
+    uint64_t seq;
+    int64_t ts_ms;
+    uint64_t offset;
+} IndexEntry;
+
+typedef struct {
+    uint64_t first_seq;
+    int fd;          // Aberto apenas no segmento ativo
+    int idx_fd;
+    const char* map; // STORE_SEGMENT_SIZE bytes; só [0, size) é lido
+    size_t size;     // Bytes com registros completos
+    IndexEntry* index;
+    size_t index_count;
+    size_t index_cap;
+    size_t since_index; // Registros após a última entrada do índice
+} Segment;
+
+struct MsgStore {
+    pthread_mutex_t mutex;
+    char* dir;
+    Segment** segs; // Ordenados por first_seq; o último é o ativo
+    size_t num_segs;
+    size_t cap_segs;
+    uint64_t last_seq;
+    int64_t last_ts;
+};
+
+// --- CRC-32 (polinômio refletido 0xEDB88320) ---
+
+static uint32_t g_crc_table[256];
+static pthread_once_t g_crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        g_crc_table[i] = c;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const void* data, size_t len) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) crc = g_crc_table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+static uint32_t record_crc(uint64_t seq, int64_t ts_ms, const char* data, size_t len) {
+    uint32_t crc = 0xFFFFFFFFu;
+    crc = crc_update(crc, &seq, sizeof(seq));
+    crc = crc_update(crc, &ts_ms, sizeof(ts_ms));
+    crc = crc_update(crc, data, len);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+static int64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// --- Segmentos ---
+
+static void segment_path(const MsgStore* st, uint64_t first_seq, const char* ext, char* out, size_t out_size) {
+    snprintf(out, out_size, "%s/seg-%020llu.%s", st->dir, (unsigned long long)first_seq, ext);
+}
+
+static void segment_free(Segment* s) {
+    if (!s) return;
+    if (s->map) munmap((void*)s->map, STORE_SEGMENT_SIZE);
+    if (s->fd >= 0) close(s->fd);
+    if (s->idx_fd >= 0) close(s->idx_fd);
+    free(s->index);
+    free(s);
+}
+
+// Abre (ou cria) o segmento e seu índice e mapeia o arquivo
+static Segment* segment_open(MsgStore* st, uint64_t first_seq) {
+    char path[4096];
+    Segment* s = (Segment*)calloc(1, sizeof(Segment));
+    if (!s) return NULL;
+    s->first_seq = first_seq;
+    s->idx_fd = -1;
+
+    segment_path(st, first_seq, "log", path, sizeof(path));
+    s->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    segment_path(st, first_seq, "idx", path, sizeof(path));
+    if (s->fd >= 0) s->idx_fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (s->fd < 0 || s->idx_fd < 0) {
+        segment_free(s);
+        return NULL;
+    }
+
+    // Mapear além do fim do arquivo é permitido; só as páginas com dados
+    // gravados são lidas, e o cache de páginas é compartilhado com write().
+    void* map = mmap(NULL, STORE_SEGMENT_SIZE, PROT_READ, MAP_SHARED, s->fd, 0);
+    if (map == MAP_FAILED) {
+        segment_free(s);
+        return NULL;
+    }
+    s->map = (const char*)map;
+    return s;
+}
+
+static int index_push(Segment* s, const IndexEntry* e) {
+    if (s->index_count == s->index_cap) {
+        size_t new_cap = s->index_cap ? s->index_cap * 2 : 64;
+        IndexEntry* grown = (IndexEntry*)realloc(s->index, new_cap * sizeof(IndexEntry));
+        if (!grown) return -1;
+        s->index = grown;
+        s->index_cap = new_cap;
+    }
+    s->index[s->index_count++] = *e;
+    return 0;
+}
+
+// Carrega o índice do disco, ignorando entradas incompletas ou fora do arquivo
+static int segment_load_index(Segment* s, size_t file_size) {
+    struct stat sb;
+    if (fstat(s->idx_fd, &sb) < 0) return -1;
+    size_t n = (size_t)sb.st_size / sizeof(IndexEntry);
+    if (n == 0) return 0;
+
+    IndexEntry* entries = (IndexEntry*)malloc(n * sizeof(IndexEntry));
+    if (!entries) return -1;
+    if (pread(s->idx_fd, entries, n * sizeof(IndexEntry), 0) != (ssize_t)(n * sizeof(IndexEntry))) {
+        free(entries);
+        return -1;
+    }
+    while (n > 0 && entries[n - 1].offset + sizeof(RecordHeader) > file_size) n--;
+    s->index = entries;
+    s->index_count = n;
+    s->index_cap = n;
+    return 0;
+}
+
+// Valida o registro em offset; devolve seu tamanho total ou 0 se inválido
+static size_t record_check(const Segment* s, size_t offset, size_t end, uint64_t expected_seq) {
+    RecordHeader h;
+    if (offset + sizeof(h) > end) return 0;
+    memcpy(&h, s->map + offset, sizeof(h));
+    if (h.len > end - offset - sizeof(h) || h.seq != expected_seq) return 0;
+    if (record_crc(h.seq, h.ts_ms, s->map + offset + sizeof(h), h.len) != h.crc) return 0;
+    return sizeof(h) + h.len;
+}
+
+// Recupera o segmento ativo: percorre só o trecho após a última entrada do
+// índice e corta um registro final incompleto (queda durante a gravação).
+static int recover_tail(MsgStore* st, Segment* s, size_t file_size) {
+    size_t offset = 0;
+    uint64_t seq = s->first_seq;
+    if (s->index_count > 0) {
+        offset = s->index[s->index_count - 1].offset;
+        seq = s->index[s->index_count - 1].seq;
+    }
+
+    size_t scanned = 0;
+    size_t rec;
+    while ((rec = record_check(s, offset, file_size, seq)) > 0) {
+        RecordHeader h;
+        memcpy(&h, s->map + offset, sizeof(h));
+        st->last_seq = h.seq;
+        st->last_ts = h.ts_ms;
+        offset += rec;
+        seq++;
+        scanned++;
+    }
+
+    // A entrada final do índice pode apontar para um registro perdido
+    if (s->index_count > 0 && scanned == 0) {
+        s->index_count--;
+        if (s->index_count > 0 || offset > 0) return recover_tail(st, s, offset);
+    }
+    if (offset < file_size && ftruncate(s->fd, (off_t)offset) < 0) return -1;
+    if (ftruncate(s->idx_fd, (off_t)(s->index_count * sizeof(IndexEntry))) < 0) return -1;
+
+    s->size = offset;
+    s->since_index = scanned > 0 ? scanned - 1 : 0;
+    if (s->index_count == 0) s->since_index = STORE_INDEX_INTERVAL; // Próximo registro é indexado
+    if (st->last_seq < s->first_seq) st->last_seq = s->first_seq - 1;
+    return 0;
+}
+
+// Horário do último registro de um segmento selado, a partir da última
+// entrada do índice; 0 se o segmento não tiver registros
+static int64_t sealed_last_ts(const Segment* s) {
+    if (s->index_count == 0) return 0;
+    size_t offset = s->index[s->index_count - 1].offset;
+    uint64_t seq = s->index[s->index_count - 1].seq;
+    int64_t ts = 0;
+    size_t rec;
+    while ((rec = record_check(s, offset, s->size, seq)) > 0) {
+        RecordHeader h;
+        memcpy(&h, s->map + offset, sizeof(h));
+        ts = h.ts_ms;
+        offset += rec;
+        seq++;
+    }
+    return ts;
+}
+
+static int segs_push(MsgStore* st, Segment* s) {
+    if (st->num_segs == st->cap_segs) {
+        size_t new_cap = st->cap_segs ? st->cap_segs * 2 : 16;
+        Segment** grown = (Segment**)realloc(st->segs, new_cap * sizeof(Segment*));
+        if (!grown) return -1;
+        st->segs = grown;
+        st->cap_segs = new_cap;
+    }
+    st->segs[st->num_segs++] = s;
+    return 0;
+}
+
+static int cmp_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Lista os primeiros seqs dos segmentos existentes, em ordem
+static int list_segments(const char* dir, uint64_t** out, size_t* count) {
+    DIR* d = opendir(dir);
+    if (!d) return -1;
+
+    uint64_t* seqs = NULL;
+    size_t n = 0, cap = 0;
+    struct dirent* ent;
+    while ((ent = readdir(d)) != NULL) {
+        unsigned long long seq;
+        char tail;
+        if (sscanf(ent->d_name, "seg-%llu.lo%c", &seq, &tail) != 2 || tail != 'g') continue;
+        if (n == cap) {
+            cap = cap ? cap * 2 : 16;
+            uint64_t* grown = (uint64_t*)realloc(seqs, cap * sizeof(uint64_t));
+            if (!grown) {
+                free(seqs);
+                closedir(d);
+                return -1;
+            }
+            seqs = grown;
+        }
+        seqs[n++] = seq;
+    }
+    closedir(d);
+
+    if (n > 0) qsort(seqs, n, sizeof(uint64_t), cmp_u64);
+    *out = seqs;
+    *count = n;
+    return 0;
+}
+
+MsgStore* store_open(const char* dir) {
+    pthread_once(&g_crc_once, crc_init);
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) return NULL;
+
+    MsgStore* st = (MsgStore*)calloc(1, sizeof(MsgStore));
+    if (!st) return NULL;
+    pthread_mutex_init(&st->mutex, NULL);
+    st->dir = strdup(dir);
+
+    uint64_t* seqs = NULL;
+    size_t count = 0;
+    if (!st->dir || list_segments(dir, &seqs, &count) < 0) {
+        store_close(st);
+        return NULL;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Segment* s = segment_open(st, seqs[i]);
+        struct stat sb;
+        if (!s || fstat(s->fd, &sb) < 0 || segment_load_index(s, (size_t)sb.st_size) < 0 || segs_push(st, s) < 0) {
+            segment_free(s);
+            free(seqs);
+            store_close(st);
+            return NULL;
+        }
+
+        if (i + 1 < count) {
+            // Segmento selado: confia no tamanho do arquivo e no índice, já
+            // carregado; os descritores só servem ao segmento ativo
+            s->size = (size_t)sb.st_size;
+            close(s->fd);
+            s->fd = -1;
+            close(s->idx_fd);
+            s->idx_fd = -1;
+        } else if (recover_tail(st, s, (size_t)sb.st_size) < 0) {
+            free(seqs);
+            store_close(st);
+            return NULL;
+        }
+    }
+    free(seqs);
+
+    // O segmento ativo pode estar vazio (criado por roll_locked antes de uma
+    // gravação que falhou); o último horário vem então dos selados
+    for (size_t i = st->num_segs; i > 1 && st->segs[st->num_segs - 1]->size == 0 && st->last_ts == 0; i--) {
+        st->last_ts = sealed_last_ts(st->segs[i - 2]);
+    }
+    return st;
+}
+
+void store_close(MsgStore* st) {
+    if (!st) return;
+    for (size_t i = 0; i < st->num_segs; i++) segment_free(st->segs[i]);
+    free(st->segs);
+    free(st->dir);
+    pthread_mutex_destroy(&st->mutex);
+    free(st);
+}
+
+// Sela o segmento ativo e abre um novo começando em first_seq. Requer o mutex.
+static Segment* roll_locked(MsgStore* st, uint64_t first_seq) {
+    Segment* s = segment_open(st, first_seq);
+    if (!s || segs_push(st, s) < 0) {
+        segment_free(s);
+        return NULL;
+    }
+    s->since_index = STORE_INDEX_INTERVAL;
+    if (st->num_segs > 1) {
+        Segment* sealed = st->segs[st->num_segs - 2];
+        close(sealed->fd);
+        sealed->fd = -1;
+        close(sealed->idx_fd);
+        sealed->idx_fd = -1;
+    }
+    return s;
+}
+
+uint64_t store_append(MsgStore* st, const char* data, size_t len, int64_t* ts_ms) {
+    RecordHeader h;
+    size_t rec_size = sizeof(h) + len;
+    if (rec_size > STORE_SEGMENT_SIZE) return 0;
+
+    pthread_mutex_lock(&st->mutex);
+    Segment* s = st->num_segs ? st->segs[st->num_segs - 1] : NULL;
+    uint64_t seq = st->last_seq + 1;
+    if (!s || s->size + rec_size > STORE_SEGMENT_SIZE) {
+        s = roll_locked(st, seq);
+        if (!s) {
+            pthread_mutex_unlock(&st->mutex);
+            return 0;
+        }
+    }
+
+    // Horários nunca retrocedem, para a busca binária por horário
+    int64_t ts = now_ms();
+    if (ts < st->last_ts) ts = st->last_ts;
+
+    h.len = (uint32_t)len;
+    h.seq = seq;
+    h.ts_ms = ts;
+    h.crc = record_crc(seq, ts, data, len);
+
+    struct iovec iov[2] = {
+        { .iov_base = &h, .iov_len = sizeof(h) },
+        { .iov_base = (void*)data, .iov_len = len },
+    };
+    ssize_t n = pwritev(s->fd, iov, 2, (off_t)s->size);
+    if (n != (ssize_t)rec_size) {
+        if (n > 0 && ftruncate(s->fd, (off_t)s->size) < 0) {
+            // O próximo registro sobrescreve o trecho parcial de qualquer forma
+        }
+        pthread_mutex_unlock(&st->mutex);
+        return 0;
+    }
+
+    if (s->since_index >= STORE_INDEX_INTERVAL - 1) {
+        IndexEntry e = { .seq = seq, .ts_ms = ts, .offset = s->size };
+        if (index_push(s, &e) == 0 && write(s->idx_fd, &e, sizeof(e)) == (ssize_t)sizeof(e)) {
+            s->since_index = 0;
+        } else if (s->index_count > 0 && s->index[s->index_count - 1].seq == seq) {
+            s->index_count--; // Mantém memória e disco coerentes
+        }
+    } else {
+        s->since_index++;
+    }
+
+    s->size += rec_size;
+    st->last_seq = seq;
+    st->last_ts = ts;
+    pthread_mutex_unlock(&st->mutex);
+
+    if (ts_ms) *ts_ms = ts;
+    return seq;
+}
+
+uint64_t store_last_seq(MsgStore* st) {
+    pthread_mutex_lock(&st->mutex);
+    uint64_t seq = st->last_seq;
+    pthread_mutex_unlock(&st->mutex);
+    return seq;
+}
+
+// --- Consultas ---
+
+// Última entrada do índice com chave <= alvo (seq) ou < alvo (horário)
+static size_t index_floor(const Segment* s, uint64_t seq, int64_t ts_ms, int by_time) {
+    size_t lo = 0, hi = s->index_count; // Resposta em [lo, hi)
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        int before = by_time ? s->index[mid].ts_ms < ts_ms : s->index[mid].seq <= seq;
+        if (before) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * Percorre os registros a partir do segmento seg_i/offset, pulando os
+ * anteriores a min_seq/min_ts. O tamanho de cada segmento é lido sob o
+ * mutex e a leitura do mmap acontece fora dele: registros já gravados são
+ * imutáveis e segmentos nunca são removidos enquanto o log está aberto.
+ */
+static size_t scan_from(MsgStore* st, size_t seg_i, size_t offset, uint64_t min_seq, int64_t min_ts,
+                        size_t max, StoreVisitor visit, void* ctx) {
+    size_t visited = 0;
+    for (; visited < max; seg_i++, offset = 0) {
+        pthread_mutex_lock(&st->mutex);
+        Segment* s = seg_i < st->num_segs ? st->segs[seg_i] : NULL;
+        size_t end = s ? s->size : 0;
+        pthread_mutex_unlock(&st->mutex);
+        if (!s) break;
+
+        while (visited < max && offset + sizeof(RecordHeader) <= end) {
+            RecordHeader h;
+            memcpy(&h, s->map + offset, sizeof(h));
+            // Cabeçalho corrompido num segmento selado: não lê além do mapa
+            if (h.len > end - offset - sizeof(h)) return visited;
+            const char* text = s->map + offset + sizeof(h);
+            offset += sizeof(h) + h.len;
+            if (h.seq < min_seq || h.ts_ms < min_ts) continue;
+            visited++;
+            if (visit(ctx, h.seq, h.ts_ms, text, h.len) != 0) return visited;
+        }
+    }
+    return visited;
+}
+
+size_t store_scan_seq(MsgStore* st, uint64_t first_seq, size_t max, StoreVisitor visit, void* ctx) {
+    pthread_mutex_lock(&st->mutex);
+    if (st->num_segs == 0 || first_seq > st->last_seq) {
+        pthread_mutex_unlock(&st->mutex);
+        return 0;
+    }
+    // Último segmento que começa em first_seq ou antes
+    size_t lo = 0, hi = st->num_segs;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (st->segs[mid]->first_seq <= first_seq) lo = mid;
+        else hi = mid;
+    }
+    Segment* s = st->segs[lo];
+    size_t offset = 0;
+    if (s->index_count > 0 && s->index[0].seq <= first_seq) {
+        offset = s->index[index_floor(s, first_seq, 0, 0)].offset;
+    }
+    pthread_mutex_unlock(&st->mutex);
+
+    return scan_from(st, lo, offset, first_seq, INT64_MIN, max, visit, ctx);
+}
+
+size_t store_scan_since(MsgStore* st, int64_t since_ms, size_t max, StoreVisitor visit, void* ctx) {
+    pthread_mutex_lock(&st->mutex);
+    if (st->num_segs == 0 || since_ms > st->last_ts) {
+        pthread_mutex_unlock(&st->mutex);
+        return 0;
+    }
+    // Último segmento cujo primeiro registro é anterior a since_ms
+    size_t lo = 0, hi = st->num_segs;
+    while (hi - lo > 1) {
+        size_t mid = lo + (hi - lo) / 2;
+        const Segment* m = st->segs[mid];
+        if (m->index_count > 0 && m->index[0].ts_ms < since_ms) lo = mid;
+        else hi = mid;
+    }
+    Segment* s = st->segs[lo];
+    size_t offset = 0;
+    if (s->index_count > 0 && s->index[0].ts_ms < since_ms) {
+        offset = s->index[index_floor(s, 0, since_ms, 1)].offset;
+    }
+    pthread_mutex_unlock(&st->mutex);
+
+    return scan_from(st, lo, offset, 0, since_ms, max, visit, ctx);
+}
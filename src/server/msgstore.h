@@ -0,0 +1,66 @@
+#ifndef MSGSTORE_H
+#define MSGSTORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Log persistente, somente de acréscimo, das mensagens públicas.
+ *
+ * As mensagens ficam em segmentos "seg-<primeiro seq>.log" de até
+ * STORE_SEGMENT_SIZE bytes, lidos por mmap. Cada registro leva número de
+ * sequência, horário (ms desde a época) e CRC. Um índice esparso
+ * ("seg-<seq>.idx", uma entrada a cada STORE_INDEX_INTERVAL registros)
+ * localiza um seq ou horário por busca binária sem ler os segmentos.
+ *
+ * A recuperação na abertura lê apenas os índices e o trecho final do
+ * último segmento (após a última entrada do índice), descartando um
+ * registro final incompleto; por isso leva milissegundos mesmo com
+ * gigabytes de segmentos.
+ */
+typedef struct MsgStore MsgStore;
+
+#ifndef STORE_SEGMENT_SIZE
+#define STORE_SEGMENT_SIZE (64u * 1024 * 1024)
+#endif
+#define STORE_INDEX_INTERVAL 64
+
+/**
+ * @brief Chamado para cada registro de uma consulta.
+ * @return 0 para continuar, outro valor para parar.
+ */
+typedef int (*StoreVisitor)(void* ctx, uint64_t seq, int64_t ts_ms, const char* data, size_t len);
+
+/**
+ * @brief Abre (criando se preciso) o diretório dir e recupera o estado.
+ * @return O log, ou NULL em erro (errno indica a causa).
+ */
+MsgStore* store_open(const char* dir);
+
+void store_close(MsgStore* st);
+
+/**
+ * @brief Acrescenta uma mensagem. Thread-safe.
+ * @param ts_ms Recebe o horário gravado (pode ser NULL).
+ * @return O número de sequência (>= 1), ou 0 em erro.
+ */
+uint64_t store_append(MsgStore* st, const char* data, size_t len, int64_t* ts_ms);
+
+/**
+ * @brief Número de sequência da última mensagem (0 se vazio).
+ */
+uint64_t store_last_seq(MsgStore* st);
+
+/**
+ * @brief Percorre até max registros a partir do seq first_seq.
+ * @return Número de registros visitados.
+ */
+size_t store_scan_seq(MsgStore* st, uint64_t first_seq, size_t max, StoreVisitor visit, void* ctx);
+
+/**
+ * @brief Percorre até max registros com horário >= since_ms.
+ * @return Número de registros visitados.
+ */
+size_t store_scan_since(MsgStore* st, int64_t since_ms, size_t max, StoreVisitor visit, void* ctx);
+
+#endif
@@ -0,0 +1,54 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "server/rcu.h"
+
+// Faixas de contadores: threads diferentes raramente disputam a mesma linha
+#define RCU_STRIPES 64
+
+/*
+ * Cada faixa conta os leitores ativos por paridade de época. O leitor
+ * incrementa o contador da paridade atual antes de ler o ponteiro. O
+ * escritor alterna a época e espera a paridade antiga zerar, duas vezes:
+ * um leitor que leu a época antes de uma troca anterior fica registrado na
+ * outra paridade e é coberto pela segunda fase.
+ */
+typedef struct {
+    _Alignas(64) atomic_long readers[2];
+} RcuStripe;
+
+static RcuStripe g_stripes[RCU_STRIPES];
+static atomic_uint g_epoch;
+static atomic_uint g_next_stripe;
+static _Thread_local int tl_stripe = -1;
+static pthread_mutex_t g_sync_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+unsigned rcu_read_lock(void) {
+    if (tl_stripe < 0) {
+        tl_stripe = (int)(atomic_fetch_add(&g_next_stripe, 1) % RCU_STRIPES);
+    }
+    unsigned parity = atomic_load(&g_epoch) & 1;
+    atomic_fetch_add(&g_stripes[tl_stripe].readers[parity], 1);
+    return ((unsigned)tl_stripe << 1) | parity;
+}
+
+void rcu_read_unlock(unsigned token) {
+    atomic_fetch_sub(&g_stripes[token >> 1].readers[token & 1], 1);
+}
+
+void rcu_synchronize(void) {
+    const struct timespec pause = { 0, 100 * 1000 };
+
+    pthread_mutex_lock(&g_sync_mutex);
+    for (int phase = 0; phase < 2; phase++) {
+        unsigned parity = atomic_fetch_xor(&g_epoch, 1) & 1;
+        for (int i = 0; i < RCU_STRIPES; i++) {
+            while (atomic_load(&g_stripes[i].readers[parity]) != 0) {
+                nanosleep(&pause, NULL);
+            }
+        }
+    }
+    pthread_mutex_unlock(&g_sync_mutex);
+}
@@ -0,0 +1,29 @@
+#ifndef RCU_H
+#define RCU_H
+
+/**
+ * @brief Recuperação adiada no estilo RCU para dados publicados por ponteiro.
+ *
+ * Leitores envolvem o acesso ao ponteiro publicado com rcu_read_lock() e
+ * rcu_read_unlock(), sem locks: apenas um incremento em um contador da sua
+ * faixa. O escritor troca o ponteiro atomicamente, chama rcu_synchronize()
+ * e só então libera a versão antiga, pois nenhum leitor ainda pode vê-la.
+ */
+
+/**
+ * @brief Inicia uma seção de leitura.
+ * @return Token que deve ser passado para rcu_read_unlock().
+ */
+unsigned rcu_read_lock(void);
+
+void rcu_read_unlock(unsigned token);
+
+/**
+ * @brief Aguarda o término de todas as seções de leitura já iniciadas.
+ *
+ * Pode bloquear por algumas centenas de microssegundos; deve ser chamada
+ * fora do caminho crítico (ex.: na thread de recarga).
+ */
+void rcu_synchronize(void);
+
+#endif
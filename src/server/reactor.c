@@ -0,0 +1,480 @@
+#define _GNU_SOURCE // pthread_setaffinity_np
+#define TSLOG_MODULE LOGMOD_NET
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "libtslog/tslog.h"
+#include "server/conn.h"
+#include "server/metrics.h"
+#include "server/mpsc.h"
+#include "server/reactor.h"
+#include "server/room.h"
+
+#define MAX_EVENTS 256
+
+// --- Caixa de correio entre shards (fila MPSC sem locks) ---
+
+struct BroadcastMsg;
+
+typedef struct {
+    MpscNode node; // Deve ser o primeiro campo
+    struct BroadcastMsg* msg;
+} MailboxNode;
+
+// Um envelope por broadcast, compartilhado por todos os shards: cada shard
+// recebe um dos nós embutidos em nodes[] (o do seu índice). O texto não é
+// copiado; o envelope guarda uma referência ao MsgBuf e, nas mensagens de
+// sala, uma à sala.
+typedef struct BroadcastMsg {
+    atomic_int refs;
+    MsgBuf* buf;
+    Room* room; // NULL: todos os clientes do shard
+    MailboxNode nodes[];
+} BroadcastMsg;
+
+typedef struct {
+    MpscQueue queue;
+    atomic_int wake_pending; // Evita um write() no eventfd por mensagem
+} Mailbox;
+
+typedef struct {
+    int index;
+    int epoll_fd;
+    int wake_fd;   // eventfd usado para acordar a thread (encerramento/correio)
+    int listen_fd; // Socket de escuta próprio (apenas no modo shards)
+    pthread_t thread;
+
+    // Fatia do registro de clientes: acessada apenas pela thread do shard
+    Conn** local;
+    size_t local_count;
+    size_t local_cap;
+
+    Mailbox mailbox;
+} Reactor;
+
+static Reactor* g_reactors = NULL;
+static int g_num_reactors = 0;
+static int g_sharded = 0;
+static atomic_uint g_next_reactor;
+static atomic_int g_reactor_running;
+static _Thread_local Reactor* tl_reactor = NULL;
+
+static void mailbox_init(Mailbox* mb) {
+    mpsc_init(&mb->queue);
+    atomic_init(&mb->wake_pending, 0);
+}
+
+static void broadcast_msg_unref(BroadcastMsg* msg) {
+    if (atomic_fetch_sub_explicit(&msg->refs, 1, memory_order_acq_rel) == 1) {
+        msgbuf_unref(msg->buf);
+        room_release(msg->room);
+        free(msg);
+    }
+}
+
+static void reactor_wake(Reactor* r) {
+    uint64_t one = 1;
+    (void)!write(r->wake_fd, &one, sizeof(one));
+}
+
+// --- Registro local do shard ---
+
+static int local_add(Reactor* r, Conn* c) {
+    if (r->local_count == r->local_cap) {
+        size_t new_cap = r->local_cap ? r->local_cap * 2 : 64;
+        Conn** grown = (Conn**)realloc(r->local, new_cap * sizeof(Conn*));
+        if (!grown) return -1;
+        r->local = grown;
+        r->local_cap = new_cap;
+    }
+    c->owner_slot = r->local_count;
+    r->local[r->local_count++] = c;
+    return 0;
+}
+
+static void local_remove(Reactor* r, Conn* c) {
+    size_t slot = c->owner_slot;
+    Conn* last = r->local[--r->local_count];
+    r->local[slot] = last;
+    last->owner_slot = slot;
+}
+
+// Entrega a mensagem a todos os clientes ativos deste shard, exceto o remetente
+static void local_deliver(Reactor* r, MsgBuf* buf, const Conn* sender) {
+    for (size_t i = 0; i < r->local_count; i++) {
+        Conn* c = r->local[i];
+        if (c == sender || c->state != CONN_ACTIVE) continue;
+        if (conn_send_buf(c, buf) < 0) {
+            LOG_ERROR("Falha ao enviar mensagem broadcast.");
+        }
+    }
+}
+
+static void reactor_drain_mailbox(Reactor* r) {
+    atomic_store(&r->mailbox.wake_pending, 0);
+
+    MpscNode* node;
+    while ((node = mpsc_pop(&r->mailbox.queue)) != NULL) {
+        BroadcastMsg* msg = ((MailboxNode*)node)->msg;
+        if (msg->room) {
+            room_deliver_local(msg->room, r->index, msg->buf, NULL);
+        } else {
+            local_deliver(r, msg->buf, NULL);
+        }
+        broadcast_msg_unref(msg);
+    }
+}
+
+// --- Laço de eventos ---
+
+// Encerra uma conexão atendida pelo reactor e libera a referência dele
+static void reactor_close_conn(Reactor* r, Conn* c) {
+    chat_on_disconnect(c);
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    if (g_sharded) local_remove(r, c);
+    conn_unref(c);
+}
+
+// Registra um socket aceito no reactor r; a referência inicial fica com ele
+static int reactor_register(Reactor* r, int client_socket) {
+    int flags = fcntl(client_socket, F_GETFL, 0);
+    if (flags < 0 || fcntl(client_socket, F_SETFL, flags | O_NONBLOCK) < 0) {
+        close(client_socket);
+        return -1;
+    }
+
+    Conn* c = conn_create(client_socket, 1);
+    if (!c) {
+        close(client_socket);
+        return -1;
+    }
+    c->owner = r;
+
+    if (g_sharded && local_add(r, c) < 0) {
+        conn_unref(c);
+        return -1;
+    }
+
+    struct epoll_event ev = {
+        .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+        .data.ptr = c
+    };
+    if (epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, client_socket, &ev) < 0) {
+        if (g_sharded) local_remove(r, c);
+        conn_unref(c);
+        return -1;
+    }
+    return 0;
+}
+
+// Aceita todas as conexões pendentes no socket de escuta do shard
+static void reactor_accept(Reactor* r) {
+    for (;;) {
+        struct sockaddr_in client_addr;
+        socklen_t client_len = sizeof(client_addr);
+        int client_socket = accept(r->listen_fd, (struct sockaddr*)&client_addr, &client_len);
+        if (client_socket < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                LOG_ERROR("Accept falhou.");
+            }
+            return;
+        }
+
+        char client_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+        LOG_INFOF("Nova conexão de %s:%d (socket %d, shard %d)",
+                  client_ip, ntohs(client_addr.sin_port), client_socket, r->index);
+
+        if (reactor_register(r, client_socket) < 0) {
+            LOG_ERROR("Falha ao registrar o cliente no reactor.");
+        }
+    }
+}
+
+// Lê tudo o que estiver disponível (edge-triggered exige ler até EAGAIN)
+static int reactor_handle_readable(Conn* c) {
+    for (;;) {
+        size_t space = sizeof(c->in_buf) - 1 - c->in_len;
+        uint64_t start = metrics_now();
+        ssize_t n = read(c->fd, c->in_buf + c->in_len, space);
+        if (n > 0) {
+            metrics_record(METRIC_READ, start);
+            metrics_add(METRIC_BYTES_IN, (uint64_t)n);
+            c->in_len += (size_t)n;
+            chat_process_input(c);
+            continue;
+        }
+        if (n == 0) return -1; // Cliente fechou a conexão
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) return 0;
+        return -1;
+    }
+}
+
+static void* reactor_thread_func(void* arg) {
+    Reactor* r = (Reactor*)arg;
+    struct epoll_event events[MAX_EVENTS];
+    tl_reactor = r;
+
+    while (atomic_load(&g_reactor_running)) {
+        int n = epoll_wait(r->epoll_fd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            LOG_ERROR("epoll_wait falhou.");
+            break;
+        }
+
+        for (int i = 0; i < n; i++) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == &r->wake_fd) {
+                uint64_t value;
+                (void)!read(r->wake_fd, &value, sizeof(value));
+                if (g_sharded) reactor_drain_mailbox(r);
+                continue;
+            }
+            if (ptr == &r->listen_fd) {
+                reactor_accept(r);
+                continue;
+            }
+
+            Conn* c = (Conn*)ptr;
+            uint32_t ev = events[i].events;
+
+            if (ev & (EPOLLERR | EPOLLHUP)) {
+                reactor_close_conn(r, c);
+                continue;
+            }
+            if ((ev & EPOLLOUT) && conn_flush(c) < 0) {
+                reactor_close_conn(r, c);
+                continue;
+            }
+            if ((ev & (EPOLLIN | EPOLLRDHUP)) && reactor_handle_readable(c) < 0) {
+                reactor_close_conn(r, c);
+            }
+        }
+    }
+
+    // Encerramento: libera as conexões que ainda pertencem a este shard
+    if (g_sharded) {
+        reactor_drain_mailbox(r);
+        while (r->local_count > 0) {
+            Conn* c = r->local[r->local_count - 1];
+            shutdown(c->fd, SHUT_RDWR);
+            reactor_close_conn(r, c);
+        }
+        // Envelopes que chegaram enquanto as conexões eram fechadas
+        reactor_drain_mailbox(r);
+    }
+    return NULL;
+}
+
+// Cria o socket de escuta de um shard; o kernel distribui as conexões
+// entre os sockets que compartilham a porta via SO_REUSEPORT.
+static int open_shard_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void reactor_close_fds(Reactor* r) {
+    if (r->epoll_fd >= 0) close(r->epoll_fd);
+    if (r->wake_fd >= 0) close(r->wake_fd);
+    if (r->listen_fd >= 0) close(r->listen_fd);
+}
+
+static int reactor_setup(Reactor* r, int index, int listen_port) {
+    r->index = index;
+    r->listen_fd = -1;
+    r->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    r->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    mailbox_init(&r->mailbox);
+    if (r->epoll_fd < 0 || r->wake_fd < 0) {
+        LOG_ERROR("Falha ao criar a instância epoll do reactor.");
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = &r->wake_fd };
+    epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->wake_fd, &ev);
+
+    if (listen_port > 0) {
+        r->listen_fd = open_shard_listener(listen_port);
+        if (r->listen_fd < 0) {
+            LOG_ERROR("Falha ao abrir o socket de escuta do shard (SO_REUSEPORT).");
+            return -1;
+        }
+        struct epoll_event lev = { .events = EPOLLIN | EPOLLET, .data.ptr = &r->listen_fd };
+        epoll_ctl(r->epoll_fd, EPOLL_CTL_ADD, r->listen_fd, &lev);
+    }
+    return 0;
+}
+
+int reactor_start(int num_threads, int listen_port) {
+    if (num_threads < 1) num_threads = 1;
+
+    g_reactors = (Reactor*)calloc((size_t)num_threads, sizeof(Reactor));
+    if (!g_reactors) return -1;
+
+    g_sharded = listen_port > 0;
+    atomic_store(&g_reactor_running, 1);
+    atomic_store(&g_next_reactor, 0);
+
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus < 1) num_cpus = 1;
+
+    // Os sinais ficam com a thread principal, que trata o SIGINT
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    int rc = 0;
+    for (int i = 0; i < num_threads; i++) {
+        Reactor* r = &g_reactors[i];
+        if (reactor_setup(r, i, listen_port) < 0 ||
+            pthread_create(&r->thread, NULL, reactor_thread_func, r) != 0) {
+            LOG_ERROR("Falha ao criar a thread do reactor.");
+            reactor_close_fds(r);
+            rc = -1;
+            break;
+        }
+        g_num_reactors = i + 1;
+
+        if (g_sharded) {
+            // Um shard por núcleo
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(i % num_cpus, &cpus);
+            pthread_setaffinity_np(r->thread, sizeof(cpus), &cpus);
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (rc < 0) reactor_stop();
+    return rc;
+}
+
+int reactor_is_sharded(void) {
+    return g_sharded;
+}
+
+int reactor_add(int client_socket) {
+    unsigned idx = atomic_fetch_add(&g_next_reactor, 1) % (unsigned)g_num_reactors;
+    return reactor_register(&g_reactors[idx], client_socket);
+}
+
+int reactor_num_shards(void) {
+    return g_sharded ? g_num_reactors : 0;
+}
+
+int reactor_shard_index(void) {
+    return (g_sharded && tl_reactor) ? tl_reactor->index : -1;
+}
+
+// Envia um envelope aos count shards listados (todos, com shards NULL),
+// exceto o da thread chamadora
+static void post_to_shards(MsgBuf* buf, Room* room, const int* shards, int count) {
+    Reactor* self = tl_reactor;
+    int remote = 0;
+    for (int i = 0; i < count; i++) {
+        if (&g_reactors[shards ? shards[i] : i] != self) remote++;
+    }
+    if (remote == 0) return;
+
+    size_t nodes_size = (size_t)g_num_reactors * sizeof(MailboxNode);
+    BroadcastMsg* msg = (BroadcastMsg*)malloc(sizeof(BroadcastMsg) + nodes_size);
+    if (!msg) {
+        LOG_ERROR("Falha ao alocar mensagem de broadcast entre shards.");
+        return;
+    }
+    msgbuf_ref(buf);
+    msg->buf = buf;
+    msg->room = room;
+    if (room) room_ref(room);
+    atomic_init(&msg->refs, remote);
+
+    for (int i = 0; i < count; i++) {
+        Reactor* r = &g_reactors[shards ? shards[i] : i];
+        if (r == self) continue;
+        msg->nodes[r->index].msg = msg;
+        mpsc_push(&r->mailbox.queue, &msg->nodes[r->index].node);
+        if (atomic_exchange(&r->mailbox.wake_pending, 1) == 0) {
+            reactor_wake(r);
+        }
+    }
+}
+
+void reactor_broadcast(MsgBuf* buf, const Conn* sender) {
+    Reactor* self = tl_reactor;
+
+    // Os clientes do próprio shard recebem direto, sem passar pelo correio,
+    // mas só depois das mensagens mais antigas que já estão nele
+    if (self) {
+        reactor_drain_mailbox(self);
+        local_deliver(self, buf, sender);
+    }
+
+    post_to_shards(buf, NULL, NULL, g_num_reactors);
+}
+
+void reactor_room_broadcast(Room* room, MsgBuf* buf, const Conn* sender, const int* shards, int count) {
+    Reactor* self = tl_reactor;
+    if (self) {
+        reactor_drain_mailbox(self);
+        for (int i = 0; i < count; i++) {
+            if (shards[i] == self->index) room_deliver_local(room, self->index, buf, sender);
+        }
+    }
+    post_to_shards(buf, room, shards, count);
+}
+
+void reactor_stop(void) {
+    if (!g_reactors) return;
+
+    atomic_store(&g_reactor_running, 0);
+    for (int i = 0; i < g_num_reactors; i++) {
+        reactor_wake(&g_reactors[i]);
+    }
+    for (int i = 0; i < g_num_reactors; i++) {
+        pthread_join(g_reactors[i].thread, NULL);
+        reactor_close_fds(&g_reactors[i]);
+        free(g_reactors[i].local);
+    }
+
+    free(g_reactors);
+    g_reactors = NULL;
+    g_num_reactors = 0;
+    g_sharded = 0;
+}
@@ -0,0 +1,78 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stddef.h>
+
+#include "server/msgbuf.h"
+
+struct Conn;
+struct Room;
+
+/**
+ * @brief Inicia o modo epoll com um pool fixo de threads reactor.
+ *
+ * Cada thread possui sua própria instância epoll (edge-triggered) e atende
+ * milhares de sockets não bloqueantes, no lugar de uma thread por cliente.
+ *
+ * Com listen_port > 0 os reactors viram shards independentes: cada um abre
+ * seu próprio socket de escuta com SO_REUSEPORT, fica fixo em um núcleo,
+ * mantém sua fatia de clientes e recebe os broadcasts dos demais shards por
+ * uma caixa de correio sem locks.
+ * @param num_threads Número de threads reactor (>= 1).
+ * @param listen_port Porta dos shards, ou 0 para receber sockets via reactor_add().
+ * @return 0 em sucesso, -1 em falha.
+ */
+int reactor_start(int num_threads, int listen_port);
+
+/**
+ * @brief Entrega um socket recém-aceito a um dos reactors (round-robin).
+ * @return 0 em sucesso, -1 em falha (o socket é fechado).
+ */
+int reactor_add(int client_socket);
+
+/**
+ * @brief Indica se o servidor está no modo shards.
+ */
+int reactor_is_sharded(void);
+
+/**
+ * @brief Envia uma mensagem a todos os clientes ativos de todos os shards.
+ *
+ * Os clientes do shard da thread chamadora recebem diretamente (depois do
+ * que já estava na caixa de correio dele); os demais shards recebem, pela
+ * caixa de correio, referências ao mesmo buffer. Chamadas serializadas
+ * pelo chamador chegam a todos os clientes na mesma ordem.
+ * @param buf Mensagem já filtrada; a função obtém as referências de que precisar.
+ * @param sender Conexão que não deve receber a mensagem (pode ser NULL).
+ */
+void reactor_broadcast(MsgBuf* buf, const struct Conn* sender);
+
+/**
+ * @brief Número de shards, ou 0 fora do modo shards.
+ */
+int reactor_num_shards(void);
+
+/**
+ * @brief Índice do shard da thread chamadora, ou -1 se ela não for um shard.
+ */
+int reactor_shard_index(void);
+
+/**
+ * @brief Entrega uma mensagem de sala aos shards que têm membros dela.
+ *
+ * Como reactor_broadcast(): o shard da thread chamadora entrega direto
+ * (depois do que já estava na sua caixa de correio) e os demais recebem
+ * uma referência ao mesmo buffer e à sala; cada shard chama
+ * room_deliver_local() para os seus membros. Deve ser chamada com o
+ * sequenciador da sala, para que todos recebam na mesma ordem.
+ * @param shards Índices dos count shards com membros na sala.
+ */
+void reactor_room_broadcast(struct Room* room, MsgBuf* buf, const struct Conn* sender, const int* shards,
+                            int count);
+
+/**
+ * @brief Sinaliza as threads reactor para encerrarem e aguarda o término.
+ */
+void reactor_stop(void);
+
+#endif
@@ -0,0 +1,229 @@
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "server/conn.h"
+#include "server/intern.h"
+#include "server/registry.h"
+
+// Faixas independentes do índice de nomes (potência de 2)
+#define NICK_STRIPES 64
+#define NICK_STRIPE_BITS 6
+
+// Conexões ativas em um vetor denso; cada Conn guarda sua posição em
+// reg_slot, então inserção e remoção custam O(1).
+static Conn** g_members = NULL;
+static size_t g_count = 0;
+static size_t g_cap = 0;
+static uint64_t g_epoch = 1;
+static ClientSnapshot* g_snapshot = NULL; // Última fotografia publicada
+static pthread_mutex_t g_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * Índice nickname -> conexão. Os bits altos do hash escolhem a faixa, cada
+ * uma com seu mutex e sua tabela de endereçamento aberto (carga <= 50%), de
+ * modo que entradas, saídas e /msg de nomes diferentes raramente disputam o
+ * mesmo lock. Os nomes são os ponteiros internados das próprias conexões.
+ */
+typedef struct {
+    const char* name;
+    uint32_t hash;
+    Conn* conn;
+} NickEntry;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    NickEntry* slots;
+    size_t num_slots;
+    size_t count;
+} NickStripe;
+
+static NickStripe g_nicks[NICK_STRIPES];
+static pthread_once_t g_nicks_once = PTHREAD_ONCE_INIT;
+
+static void nicks_init(void) {
+    for (int i = 0; i < NICK_STRIPES; i++) pthread_mutex_init(&g_nicks[i].mutex, NULL);
+}
+
+static NickStripe* nick_stripe(uint32_t hash) {
+    pthread_once(&g_nicks_once, nicks_init);
+    return &g_nicks[hash >> (32 - NICK_STRIPE_BITS)];
+}
+
+// Posição do nome na faixa, ou da primeira vaga livre. Requer o mutex.
+static size_t nick_probe(const NickStripe* st, const char* name, uint32_t hash) {
+    size_t mask = st->num_slots - 1;
+    size_t i = hash & mask;
+    while (st->slots[i].name) {
+        if (st->slots[i].hash == hash && strcmp(st->slots[i].name, name) == 0) break;
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+static int nick_grow(NickStripe* st) {
+    size_t new_num = st->num_slots ? st->num_slots * 2 : 16;
+    NickEntry* fresh = (NickEntry*)calloc(new_num, sizeof(NickEntry));
+    if (!fresh) return -1;
+
+    for (size_t i = 0; i < st->num_slots; i++) {
+        if (!st->slots[i].name) continue;
+        size_t j = st->slots[i].hash & (new_num - 1);
+        while (fresh[j].name) j = (j + 1) & (new_num - 1);
+        fresh[j] = st->slots[i];
+    }
+    free(st->slots);
+    st->slots = fresh;
+    st->num_slots = new_num;
+    return 0;
+}
+
+static int nick_claim(Conn* c) {
+    uint32_t hash = intern_hash(c->nickname, strlen(c->nickname));
+    NickStripe* st = nick_stripe(hash);
+    int rc = 0;
+
+    pthread_mutex_lock(&st->mutex);
+    if ((st->count + 1) * 2 > st->num_slots && nick_grow(st) < 0) {
+        rc = -1;
+    } else {
+        size_t i = nick_probe(st, c->nickname, hash);
+        if (st->slots[i].name) {
+            rc = REGISTRY_NAME_TAKEN;
+        } else {
+            st->slots[i] = (NickEntry){ .name = c->nickname, .hash = hash, .conn = c };
+            st->count++;
+        }
+    }
+    pthread_mutex_unlock(&st->mutex);
+    return rc;
+}
+
+static void nick_unclaim(Conn* c) {
+    uint32_t hash = intern_hash(c->nickname, strlen(c->nickname));
+    NickStripe* st = nick_stripe(hash);
+
+    pthread_mutex_lock(&st->mutex);
+    if (st->num_slots) {
+        size_t mask = st->num_slots - 1;
+        size_t hole = nick_probe(st, c->nickname, hash);
+        if (st->slots[hole].conn == c) {
+            // Remoção com deslocamento para trás (sem marcadores de remoção)
+            for (size_t j = (hole + 1) & mask; st->slots[j].name; j = (j + 1) & mask) {
+                size_t home = st->slots[j].hash & mask;
+                if (((j - home) & mask) >= ((j - hole) & mask)) {
+                    st->slots[hole] = st->slots[j];
+                    hole = j;
+                }
+            }
+            st->slots[hole] = (NickEntry){ 0 };
+            st->count--;
+        }
+    }
+    pthread_mutex_unlock(&st->mutex);
+}
+
+Conn* registry_find(const char* nickname) {
+    uint32_t hash = intern_hash(nickname, strlen(nickname));
+    NickStripe* st = nick_stripe(hash);
+    Conn* found = NULL;
+
+    pthread_mutex_lock(&st->mutex);
+    if (st->num_slots) {
+        size_t i = nick_probe(st, nickname, hash);
+        found = st->slots[i].conn;
+        if (found) conn_ref(found);
+    }
+    pthread_mutex_unlock(&st->mutex);
+    return found;
+}
+
+int registry_add(Conn* c) {
+    int rc = nick_claim(c);
+    if (rc != 0) return rc;
+
+    pthread_mutex_lock(&g_registry_mutex);
+    if (g_count == g_cap) {
+        size_t new_cap = g_cap ? g_cap * 2 : 64;
+        Conn** grown = (Conn**)realloc(g_members, new_cap * sizeof(Conn*));
+        if (!grown) {
+            pthread_mutex_unlock(&g_registry_mutex);
+            nick_unclaim(c);
+            return -1;
+        }
+        g_members = grown;
+        g_cap = new_cap;
+    }
+    conn_ref(c);
+    c->reg_slot = g_count;
+    g_members[g_count++] = c;
+    g_epoch++;
+    pthread_mutex_unlock(&g_registry_mutex);
+    return 0;
+}
+
+void registry_remove(Conn* c) {
+    int removed = 0;
+    ClientSnapshot* retired = NULL;
+
+    if (c->nickname) nick_unclaim(c);
+
+    pthread_mutex_lock(&g_registry_mutex);
+    size_t slot = c->reg_slot;
+    if (slot < g_count && g_members[slot] == c) {
+        Conn* last = g_members[--g_count];
+        g_members[slot] = last;
+        last->reg_slot = slot;
+        g_epoch++;
+        removed = 1;
+        // A fotografia publicada ainda segura a conexão; descartá-la agora
+        // permite fechar o socket assim que os empréstimos em curso acabarem.
+        retired = g_snapshot;
+        g_snapshot = NULL;
+    }
+    pthread_mutex_unlock(&g_registry_mutex);
+
+    registry_release(retired);
+    if (removed) conn_unref(c);
+}
+
+// Copia o vetor denso (apenas ponteiros) para uma nova fotografia
+static ClientSnapshot* build_snapshot_locked(void) {
+    ClientSnapshot* snap = (ClientSnapshot*)malloc(sizeof(ClientSnapshot) + g_count * sizeof(Conn*));
+    if (!snap) return NULL;
+
+    atomic_init(&snap->refs, 1); // Referência do registro
+    snap->epoch = g_epoch;
+    snap->count = g_count;
+    memcpy(snap->conns, g_members, g_count * sizeof(Conn*));
+    for (size_t i = 0; i < g_count; i++) conn_ref(snap->conns[i]);
+    return snap;
+}
+
+ClientSnapshot* registry_acquire(void) {
+    ClientSnapshot* retired = NULL;
+
+    pthread_mutex_lock(&g_registry_mutex);
+    if (!g_snapshot || g_snapshot->epoch != g_epoch) {
+        ClientSnapshot* fresh = build_snapshot_locked();
+        if (fresh) {
+            retired = g_snapshot;
+            g_snapshot = fresh;
+        }
+    }
+    ClientSnapshot* snap = g_snapshot;
+    if (snap) atomic_fetch_add_explicit(&snap->refs, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&g_registry_mutex);
+
+    if (retired) registry_release(retired);
+    return snap;
+}
+
+void registry_release(ClientSnapshot* snap) {
+    if (!snap || atomic_fetch_sub_explicit(&snap->refs, 1, memory_order_acq_rel) != 1) {
+        return;
+    }
+    for (size_t i = 0; i < snap->count; i++) conn_unref(snap->conns[i]);
+    free(snap);
+}
@@ -0,0 +1,57 @@
+#ifndef REGISTRY_H
+#define REGISTRY_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct Conn;
+
+/**
+ * @brief Fotografia imutável dos clientes ativos.
+ *
+ * Cada alteração do registro incrementa a época; a fotografia é refeita
+ * apenas quando alguém a pede e a época mudou. Enquanto isso, todos os
+ * broadcasts compartilham a mesma fotografia sem copiá-la. Ela mantém uma
+ * referência de cada conexão, então continua válida mesmo que os clientes
+ * saiam durante o uso.
+ */
+typedef struct ClientSnapshot {
+    atomic_int refs;
+    uint64_t epoch;
+    size_t count;
+    struct Conn* conns[];
+} ClientSnapshot;
+
+#define REGISTRY_NAME_TAKEN (-2)
+
+/**
+ * @brief Insere uma conexão ativa no registro (sem limite de clientes).
+ *
+ * Reserva c->nickname no índice de nomes; a reserva e a verificação de
+ * unicidade são atômicas.
+ * @return 0 em sucesso, -1 se faltar memória ou REGISTRY_NAME_TAKEN se o
+ *         nickname já pertencer a outro cliente.
+ */
+int registry_add(struct Conn* c);
+
+/**
+ * @brief Remove a conexão do registro e libera seu nickname, se presente.
+ */
+void registry_remove(struct Conn* c);
+
+/**
+ * @brief Busca o cliente ativo com o nickname dado em tempo O(1).
+ * @return A conexão com uma referência (libere com conn_unref()), ou NULL.
+ */
+struct Conn* registry_find(const char* nickname);
+
+/**
+ * @brief Empresta a fotografia atual; devolva com registry_release().
+ * @return A fotografia, ou NULL se faltar memória.
+ */
+ClientSnapshot* registry_acquire(void);
+
+void registry_release(ClientSnapshot* snap);
+
+#endif
@@ -0,0 +1,489 @@
+#define _POSIX_C_SOURCE 200809L
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "libtslog/tslog.h"
+#include "server/conn.h"
+#include "server/history.h"
+#include "server/intern.h"
+#include "server/metrics.h"
+#include "server/msgstore.h"
+#include "server/reactor.h"
+#include "server/room.h"
+
+#define ROOM_BUCKETS 256 // Potência de 2
+#define QUERY_CHUNK_SIZE (32 * 1024) // Tamanho de cada quadro de uma consulta
+#define RESUME_MAX_MESSAGES 5000 // Maior diferença reenviada a quem reconecta
+
+// Membros atendidos por um shard (ou todos, fora do modo shards)
+typedef struct {
+    Conn** members;
+    size_t count;
+    size_t cap;
+} RoomPart;
+
+struct Room {
+    char name[ROOM_NAME_MAX + 1];
+    uint32_t hash;
+    Room* next; // Encadeamento no balde da tabela
+    // Membros, entregas pendentes nos shards e usos em andamento. Só chega
+    // a 0 sob g_rooms_mutex (ver room_release)
+    atomic_int refs;
+
+    // Sequenciador e conjunto de membros. Os membros ficam em vetores
+    // densos, um por shard: cada parte só é alterada pela thread do seu
+    // shard (sob o mutex), que também a percorre sem lock ao entregar as
+    // mensagens da sua caixa de correio. Cada Conn guarda a parte e a
+    // posição (remoção O(1)). As partes são criadas na primeira entrada,
+    // quando o número de shards já é conhecido.
+    pthread_mutex_t mutex;
+    RoomPart* parts;
+    int num_parts;
+    int* targets; // Rascunho de deliver_locked: partes com membros
+    uint64_t last_seq;
+
+    History* history;
+    MsgStore* store; // NULL sem log persistente
+};
+
+static Room* g_buckets[ROOM_BUCKETS];
+static pthread_mutex_t g_rooms_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Room* g_default_room = NULL;
+static size_t g_history_size = 1;
+static char* g_store_dir = NULL;
+
+// --- Consultas ao log persistente ---
+
+// Resposta de uma consulta, enviada em quadros de até QUERY_CHUNK_SIZE
+// bytes: nunca há mais de um bloco por vez em memória.
+typedef struct {
+    Conn* conn;
+    MsgBuf* chunk;
+    size_t used;
+    size_t count;
+    int64_t last_ts;
+    uint64_t last_seq;
+    int sequenced; // Reenvio a quem reconecta: o quadro leva o último seq
+} HistoryQuery;
+
+static void history_query_flush(HistoryQuery* q) {
+    if (!q->chunk) return;
+    q->chunk->len = q->used;
+    q->chunk->data[q->used] = '\0';
+    if (q->sequenced) msgbuf_set_seq(q->chunk, q->last_seq);
+    msgbuf_set_type(q->chunk, FRAME_HISTORY);
+    conn_send_buf(q->conn, q->chunk);
+    msgbuf_unref(q->chunk);
+    q->chunk = NULL;
+}
+
+static int history_query_append(HistoryQuery* q, const char* text, size_t len) {
+    if (q->chunk && q->used + len > q->chunk->cap - 1) history_query_flush(q);
+    if (!q->chunk) {
+        size_t size = len > QUERY_CHUNK_SIZE ? len : QUERY_CHUNK_SIZE;
+        q->chunk = msgbuf_alloc(size);
+        if (!q->chunk) return -1;
+        q->used = 0;
+    }
+    memcpy(q->chunk->data + q->used, text, len);
+    q->used += len;
+    return 0;
+}
+
+// Visitante do log: cada registro vira "[AAAA-MM-DD HH:MM:SS] <linha>\n"
+static int history_query_visit(void* ctx, uint64_t seq, int64_t ts_ms, const char* data, size_t len) {
+    HistoryQuery* q = (HistoryQuery*)ctx;
+    char stamp[32];
+    time_t secs = (time_t)(ts_ms / 1000);
+    struct tm tm;
+    localtime_r(&secs, &tm);
+    size_t n = strftime(stamp, sizeof(stamp), "[%Y-%m-%d %H:%M:%S] ", &tm);
+
+    if (history_query_append(q, stamp, n) < 0 || history_query_append(q, data, len) < 0 ||
+        history_query_append(q, "\n", 1) < 0) {
+        return -1;
+    }
+    q->count++;
+    q->last_ts = ts_ms;
+    q->last_seq = seq;
+    return 0;
+}
+
+int room_query_last(Room* r, Conn* c, size_t n, RoomQuery* out) {
+    if (!r->store) return -1;
+    HistoryQuery q = { .conn = c };
+    uint64_t last = store_last_seq(r->store);
+    uint64_t first = last > n ? last - n + 1 : 1;
+    out->visited = store_scan_seq(r->store, first, n, history_query_visit, &q);
+    history_query_flush(&q);
+    out->sent = q.count;
+    out->last_ts = q.last_ts;
+    return 0;
+}
+
+int room_query_since(Room* r, Conn* c, int64_t since_ms, size_t max, RoomQuery* out) {
+    if (!r->store) return -1;
+    HistoryQuery q = { .conn = c };
+    out->visited = store_scan_since(r->store, since_ms, max, history_query_visit, &q);
+    history_query_flush(&q);
+    out->sent = q.count;
+    out->last_ts = q.last_ts;
+    return 0;
+}
+
+// --- Criação e remoção de salas ---
+
+// Carrega as últimas mensagens do log no histórico em memória
+static int prime_history_visit(void* ctx, uint64_t seq, int64_t ts_ms, const char* data, size_t len) {
+    (void)ts_ms;
+    History* history = (History*)ctx;
+    MsgBuf* buf = msgbuf_alloc(len + 1);
+    if (!buf) return -1;
+    memcpy(buf->data, data, len);
+    buf->data[len] = '\n';
+    buf->data[len + 1] = '\0';
+    msgbuf_set_seq(buf, seq);
+    msgbuf_set_type(buf, FRAME_PUBLIC);
+    history_append(history, buf);
+    msgbuf_unref(buf);
+    return 0;
+}
+
+static void room_destroy(Room* r) {
+    if (!r) return;
+    for (int p = 0; p < r->num_parts; p++) {
+        for (size_t i = 0; i < r->parts[p].count; i++) conn_unref(r->parts[p].members[i]);
+        free(r->parts[p].members);
+    }
+    free(r->parts);
+    free(r->targets);
+    history_destroy(r->history);
+    store_close(r->store);
+    pthread_mutex_destroy(&r->mutex);
+    free(r);
+}
+
+// A sala padrão usa a raiz do log; as demais, um subdiretório com o nome
+static Room* room_create(const char* name, uint32_t hash) {
+    Room* r = (Room*)calloc(1, sizeof(Room));
+    if (!r) return NULL;
+    snprintf(r->name, sizeof(r->name), "%s", name);
+    r->hash = hash;
+    pthread_mutex_init(&r->mutex, NULL);
+
+    r->history = history_create(g_history_size);
+    if (!r->history) {
+        room_destroy(r);
+        return NULL;
+    }
+
+    if (g_store_dir) {
+        char path[4096];
+        if (strcmp(name, ROOM_DEFAULT) == 0) {
+            snprintf(path, sizeof(path), "%s", g_store_dir);
+        } else {
+            snprintf(path, sizeof(path), "%s/%s", g_store_dir, name);
+        }
+        r->store = store_open(path);
+        if (!r->store) {
+            room_destroy(r);
+            return NULL;
+        }
+        r->last_seq = store_last_seq(r->store);
+        if (r->last_seq > 0) {
+            uint64_t first = r->last_seq > g_history_size ? r->last_seq - g_history_size + 1 : 1;
+            store_scan_seq(r->store, first, g_history_size, prime_history_visit, r->history);
+        }
+    }
+    return r;
+}
+
+int room_name_valid(const char* name) {
+    size_t len = strlen(name);
+    if (len == 0 || len > ROOM_NAME_MAX) return 0;
+    for (size_t i = 0; i < len; i++) {
+        char ch = name[i];
+        int ok = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+                 ch == '_' || ch == '-';
+        if (!ok) return 0;
+    }
+    return 1;
+}
+
+Room* room_acquire(const char* name) {
+    if (!room_name_valid(name)) return NULL;
+    uint32_t hash = intern_hash(name, strlen(name));
+    Room** bucket = &g_buckets[hash & (ROOM_BUCKETS - 1)];
+
+    pthread_mutex_lock(&g_rooms_mutex);
+    Room* r = *bucket;
+    while (r && (r->hash != hash || strcmp(r->name, name) != 0)) r = r->next;
+    if (!r) {
+        // Criar abre o log e recarrega o histórico; raro o bastante para
+        // acontecer sob o lock da tabela
+        r = room_create(name, hash);
+        if (r) {
+            r->next = *bucket;
+            *bucket = r;
+        }
+    }
+    if (r) atomic_fetch_add(&r->refs, 1);
+    pthread_mutex_unlock(&g_rooms_mutex);
+    return r;
+}
+
+void room_ref(Room* r) {
+    atomic_fetch_add(&r->refs, 1);
+}
+
+void room_release(Room* r) {
+    if (!r) return;
+    // Sem chegar a 0 não há o que remover: dispensa o lock da tabela. A
+    // última referência só é liberada sob o lock, então room_acquire nunca
+    // encontra uma sala que está sendo removida.
+    int refs = atomic_load(&r->refs);
+    while (refs > 1) {
+        if (atomic_compare_exchange_weak(&r->refs, &refs, refs - 1)) return;
+    }
+
+    pthread_mutex_lock(&g_rooms_mutex);
+    int unlinked = 0;
+    if (atomic_fetch_sub(&r->refs, 1) == 1) {
+        Room** link = &g_buckets[r->hash & (ROOM_BUCKETS - 1)];
+        while (*link != r) link = &(*link)->next;
+        *link = r->next;
+        unlinked = 1;
+    }
+    pthread_mutex_unlock(&g_rooms_mutex);
+    if (unlinked) room_destroy(r);
+}
+
+const char* room_name(const Room* r) {
+    return r->name;
+}
+
+int rooms_init(size_t history_size, const char* store_dir) {
+    g_history_size = history_size;
+    if (store_dir) {
+        g_store_dir = strdup(store_dir);
+        if (!g_store_dir) return -1;
+    }
+    // A referência da própria tabela mantém a sala padrão sempre viva
+    g_default_room = room_acquire(ROOM_DEFAULT);
+    return g_default_room ? 0 : -1;
+}
+
+void rooms_shutdown(void) {
+    pthread_mutex_lock(&g_rooms_mutex);
+    for (size_t i = 0; i < ROOM_BUCKETS; i++) {
+        Room* r = g_buckets[i];
+        while (r) {
+            Room* next = r->next;
+            room_destroy(r);
+            r = next;
+        }
+        g_buckets[i] = NULL;
+    }
+    g_default_room = NULL;
+    pthread_mutex_unlock(&g_rooms_mutex);
+    free(g_store_dir);
+    g_store_dir = NULL;
+}
+
+// --- Membros e entrega ---
+
+void room_deliver_local(Room* r, int part, MsgBuf* buf, const Conn* sender) {
+    RoomPart* p = &r->parts[part];
+    size_t delivered = 0;
+    for (size_t i = 0; i < p->count; i++) {
+        Conn* c = p->members[i];
+        // Quem entrou depois da publicação já a recebeu no histórico
+        if (c == sender || (buf->seq != 0 && buf->seq <= c->room_seq)) continue;
+        if (conn_send_buf(c, buf) < 0) {
+            LOG_ERROR("Falha ao enviar mensagem à sala.");
+        } else {
+            delivered++;
+        }
+    }
+    metrics_add(METRIC_MSG_DELIVERED, delivered);
+}
+
+// Envia a todos os membros, exceto sender: direto, ou pelas caixas de
+// correio dos shards que têm membros da sala. Requer r->mutex.
+static void deliver_locked(Room* r, MsgBuf* buf, const Conn* sender) {
+    uint64_t start = metrics_now();
+    if (r->num_parts == 1) {
+        room_deliver_local(r, 0, buf, sender);
+    } else if (r->num_parts > 1) {
+        int n = 0;
+        for (int p = 0; p < r->num_parts; p++) {
+            if (r->parts[p].count > 0) r->targets[n++] = p;
+        }
+        if (n > 0) reactor_room_broadcast(r, buf, sender, r->targets, n);
+    }
+    metrics_record(METRIC_FANOUT, start);
+}
+
+// Garante espaço para mais um membro na parte
+static int part_reserve(RoomPart* p) {
+    if (p->count < p->cap) return 0;
+    size_t new_cap = p->cap ? p->cap * 2 : 16;
+    Conn** grown = (Conn**)realloc(p->members, new_cap * sizeof(Conn*));
+    if (!grown) return -1;
+    p->members = grown;
+    p->cap = new_cap;
+    return 0;
+}
+
+// Cria as partes: uma por shard, ou uma só fora do modo shards. Requer r->mutex.
+static int parts_init_locked(Room* r) {
+    int n = reactor_num_shards();
+    if (n < 1) n = 1;
+    r->parts = (RoomPart*)calloc((size_t)n, sizeof(RoomPart));
+    r->targets = (int*)calloc((size_t)n, sizeof(int));
+    if (!r->parts || !r->targets) {
+        free(r->parts);
+        free(r->targets);
+        r->parts = NULL;
+        r->targets = NULL;
+        return -1;
+    }
+    r->num_parts = n;
+    return 0;
+}
+
+// Envia as mensagens posteriores a after_seq: do histórico em memória (as
+// próprias referências) ou, se ele não alcança, do log em disco.
+// Requer r->mutex. Retorna -1 se a diferença não puder ser reenviada.
+static int send_missed_locked(Room* r, Conn* c, uint64_t after_seq) {
+    uint64_t missed = r->last_seq - after_seq;
+    if (missed > RESUME_MAX_MESSAGES) return -1;
+
+    MsgBuf** items = (MsgBuf**)malloc((size_t)missed * sizeof(MsgBuf*));
+    long n = items ? history_since(r->history, after_seq, items, (size_t)missed) : -1;
+    if (n >= 0) {
+        for (long i = 0; i < n; i++) {
+            conn_send_buf(c, items[i]);
+            msgbuf_unref(items[i]);
+        }
+        free(items);
+        return 0;
+    }
+    free(items);
+
+    if (!r->store) return -1;
+    HistoryQuery q = { .conn = c, .sequenced = 1 };
+    store_scan_seq(r->store, after_seq + 1, (size_t)missed, history_query_visit, &q);
+    history_query_flush(&q);
+    return q.count == missed ? 0 : -1;
+}
+
+// Na primeira entrada (after_seq == 0) vai a fotografia, um único buffer
+// compartilhado por todos que entram até a próxima mensagem; quem reconecta
+// recebe só o que perdeu ou, se não der, um aviso FRAME_GAP seguido da
+// fotografia. Requer r->mutex.
+static void send_history_locked(Room* r, Conn* c, uint64_t after_seq) {
+    if (after_seq > 0) {
+        if (after_seq == r->last_seq) return;
+        // Um seq maior que o atual vem de antes de um reinício sem --store
+        if (after_seq < r->last_seq && send_missed_locked(r, c, after_seq) == 0) return;
+
+        MsgBuf* gap = msgbuf_printf("--- Não foi possível reenviar as mensagens perdidas; use /history para ver mais ---\n");
+        if (gap) {
+            msgbuf_set_type(gap, FRAME_GAP);
+            conn_send_buf(c, gap);
+            msgbuf_unref(gap);
+        }
+    }
+
+    MsgBuf* snap = history_snapshot(r->history);
+    if (!snap) {
+        LOG_AT(LOGMOD_HISTORY, ERROR, "Falha ao montar o histórico.");
+        return;
+    }
+    conn_send_buf(c, snap);
+    msgbuf_unref(snap);
+}
+
+void room_enter(Room* r, Conn* c, uint64_t after_seq) {
+    pthread_mutex_lock(&r->mutex);
+    int part = -1;
+    if (r->parts || parts_init_locked(r) == 0) {
+        // No modo shards a conexão fica na parte do shard que a atende (a
+        // thread chamadora)
+        part = reactor_shard_index();
+        if (part < 0 || part >= r->num_parts) part = 0;
+        if (part_reserve(&r->parts[part]) < 0) part = -1;
+    }
+    if (part < 0) {
+        // Sem memória: o cliente fica sem sala (não recebe mensagens)
+        pthread_mutex_unlock(&r->mutex);
+        LOG_ERROR("Falha ao adicionar o cliente à sala (memória insuficiente).");
+        room_release(r);
+        return;
+    }
+    RoomPart* p = &r->parts[part];
+    conn_ref(c);
+    c->room = r;
+    c->room_part = part;
+    c->room_slot = p->count;
+    c->room_seq = r->last_seq;
+    p->members[p->count++] = c;
+
+    // Clientes de quadros são avisados da sala, que informam ao reconectar
+    if (c->proto == CONN_PROTO_FRAMES) {
+        MsgBuf* info = msgbuf_from(r->name, strlen(r->name));
+        if (info) {
+            msgbuf_set_type(info, FRAME_ROOM);
+            conn_send_buf(c, info);
+            msgbuf_unref(info);
+        }
+    }
+    // Sob o sequenciador: nenhuma mensagem fica entre o fim do histórico e
+    // a primeira recebida ao vivo, nem chega duas vezes
+    send_history_locked(r, c, after_seq);
+    pthread_mutex_unlock(&r->mutex);
+}
+
+void room_leave(Conn* c) {
+    Room* r = c->room;
+    if (!r) return;
+
+    pthread_mutex_lock(&r->mutex);
+    RoomPart* p = &r->parts[c->room_part];
+    size_t slot = c->room_slot;
+    Conn* last = p->members[--p->count];
+    p->members[slot] = last;
+    last->room_slot = slot;
+    c->room = NULL;
+    pthread_mutex_unlock(&r->mutex);
+
+    conn_unref(c);
+    room_release(r);
+}
+
+uint64_t room_publish(Room* r, MsgBuf* buf, const Conn* sender) {
+    uint64_t start = metrics_now();
+    pthread_mutex_lock(&r->mutex);
+    // Com o log em disco, o número é o do registro gravado; se a gravação
+    // falhar, a mensagem segue sem número (não poderá ser reenviada)
+    uint64_t seq = r->store ? store_append(r->store, buf->data, buf->payload_len, NULL) : r->last_seq + 1;
+    if (seq != 0) r->last_seq = seq;
+    msgbuf_set_seq(buf, seq);
+    history_append(r->history, buf);
+    metrics_record(METRIC_HISTORY, start);
+    deliver_locked(r, buf, sender);
+    pthread_mutex_unlock(&r->mutex);
+    return seq;
+}
+
+void room_notify(Room* r, MsgBuf* buf, const Conn* sender) {
+    pthread_mutex_lock(&r->mutex);
+    deliver_locked(r, buf, sender);
+    pthread_mutex_unlock(&r->mutex);
+}
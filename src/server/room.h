@@ -0,0 +1,125 @@
+#ifndef ROOM_H
+#define ROOM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "server/msgbuf.h"
+
+struct Conn;
+
+#define ROOM_DEFAULT "geral" // Sala de quem acabou de entrar
+#define ROOM_NAME_MAX 32
+
+/**
+ * @brief Sala de chat: conjunto de membros, histórico e log próprios.
+ *
+ * Cada conexão está em uma sala por vez. O mutex da sala protege os
+ * membros e serve de sequenciador: numerar, gravar no log, guardar no
+ * histórico e entregar uma mensagem é um único passo, então os membros
+ * recebem os números em ordem. Mensagens de salas diferentes não disputam
+ * nenhum lock, e cada uma percorre apenas os membros da própria sala.
+ * No modo shards o sequenciador não entrega nada a conexões de outros
+ * shards: cada shard com membros na sala recebe a mensagem pela sua caixa
+ * de correio e a entrega aos seus membros (room_deliver_local()).
+ *
+ * A tabela de salas só é consultada em /join, /part, entradas e saídas.
+ * Uma sala vazia (exceto a padrão) é liberada; seu log em disco continua
+ * em "<dir>/<nome>" e recarrega o histórico quando ela for recriada.
+ */
+typedef struct Room Room;
+
+/**
+ * @brief Cria a sala padrão. Deve ser chamada antes de aceitar conexões.
+ * @param history_size Mensagens guardadas em memória por sala.
+ * @param store_dir Diretório do log persistente, ou NULL para desativá-lo.
+ * @return 0 em sucesso, -1 em erro (errno indica a causa).
+ */
+int rooms_init(size_t history_size, const char* store_dir);
+
+/**
+ * @brief Libera todas as salas no encerramento do servidor.
+ */
+void rooms_shutdown(void);
+
+/**
+ * @brief Nomes válidos têm de 1 a ROOM_NAME_MAX caracteres [A-Za-z0-9_-].
+ */
+int room_name_valid(const char* name);
+
+/**
+ * @brief Obtém (criando se preciso) a sala com o nome dado.
+ * @return A sala com uma referência, ou NULL em erro.
+ */
+Room* room_acquire(const char* name);
+
+/**
+ * @brief Obtém mais uma referência a uma sala da qual o chamador já tem uma.
+ */
+void room_ref(Room* r);
+
+/**
+ * @brief Libera uma referência; a última remove a sala (exceto a padrão).
+ */
+void room_release(Room* r);
+
+const char* room_name(const Room* r);
+
+/**
+ * @brief Torna c membro de r e lhe envia o histórico da sala.
+ *
+ * Assume a referência do chamador, que passa a ficar em c->room. Com
+ * after_seq > 0 (cliente que reconecta), envia só as mensagens posteriores
+ * ou, se não for possível, um FRAME_GAP seguido do histórico.
+ */
+void room_enter(Room* r, struct Conn* c, uint64_t after_seq);
+
+/**
+ * @brief Tira c da sua sala e libera a referência em c->room.
+ */
+void room_leave(struct Conn* c);
+
+/**
+ * @brief Numera, grava e entrega uma mensagem pública da sala.
+ * @param buf Mensagem já filtrada e ainda não compartilhada.
+ * @param sender Membro que não a recebe (pode ser NULL).
+ * @return O número de sequência, ou 0 se a gravação no log falhou.
+ */
+uint64_t room_publish(Room* r, MsgBuf* buf, const struct Conn* sender);
+
+/**
+ * @brief Entrega um aviso sem número de sequência aos membros da sala.
+ */
+void room_notify(Room* r, MsgBuf* buf, const struct Conn* sender);
+
+/**
+ * @brief Entrega buf aos membros da sala atendidos pelo shard part.
+ *
+ * Chamada pela thread desse shard (ou com o sequenciador, fora do modo
+ * shards). Membros que entraram depois da mensagem, e portanto já a
+ * receberam no histórico, são pulados.
+ */
+void room_deliver_local(Room* r, int part, MsgBuf* buf, const struct Conn* sender);
+
+/**
+ * @brief Resultado de uma consulta ao log da sala (/history).
+ */
+typedef struct {
+    size_t visited;  // Registros encontrados
+    size_t sent;     // Registros enviados (menor se faltou memória)
+    int64_t last_ts; // Horário do último registro enviado
+} RoomQuery;
+
+/**
+ * @brief Envia a c as últimas n mensagens do log, em blocos FRAME_HISTORY.
+ * @return 0, ou -1 se o log persistente estiver desativado.
+ */
+int room_query_last(Room* r, struct Conn* c, size_t n, RoomQuery* out);
+
+/**
+ * @brief Envia a c até max mensagens do log com horário >= since_ms.
+ * @return 0, ou -1 se o log persistente estiver desativado.
+ */
+int room_query_since(Room* r, struct Conn* c, int64_t since_ms, size_t max, RoomQuery* out);
+
+#endif
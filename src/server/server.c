@@ -1,360 +1,960 @@
 #define _POSIX_C_SOURCE 200809L
-#define MAX_MODERATOR_WORDS 500
+#include <errno.h>
+#include <poll.h>
 #include <signal.h>
-#include <ctype.h>
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/signalfd.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 
+#include "common/protocol.h"
 #include "libtslog/tslog.h"
-
-#define MAX_CLIENTS 100
-#define BUFFER_SIZE 2048
-#define HISTORY_SIZE 15 // Armazena as últimas 15 mensagens
+#include "server/Server.h"
+#include "server/conn.h"
+#include "server/history.h"
+#include "server/intern.h"
+#include "server/metrics.h"
+#include "server/moderation.h"
+#include "server/msgbuf.h"
+#include "server/rcu.h"
+#include "server/reactor.h"
+#include "server/registry.h"
+#include "server/room.h"
+#include "server/uring.h"
+
+#define HISTORY_SIZE 15 // Padrão de --history: as últimas 15 mensagens
+#define MODERATION_FILE "moderador.txt"
+#define STORE_DIR "chatlog" // Padrão de --store
+#define LOG_KEEP_FILES 5 // Padrão de --log-keep
+#define LOG_DRAIN_MS 2000 // Prazo para gravar o log pendente no encerramento
+#define CLIENT_DRAIN_MS 5000 // Prazo para as threads de cliente terminarem no encerramento
+#define HISTORY_QUERY_MAX 5000 // Máximo de mensagens por consulta /history
+// Maior quadro aceito de um cliente: precisa caber inteiro em in_buf
+#define MAX_CLIENT_PAYLOAD (BUFFER_SIZE - 1 - FRAME_HEADER_SIZE)
+
+// Modos de atendimento dos clientes, escolhidos na linha de comando
+typedef enum {
+    MODE_THREADS, // Uma thread bloqueante por cliente (padrão)
+    MODE_EPOLL,   // Pool de reactors epoll com sockets não bloqueantes
+    MODE_SHARDS,  // Um reactor por núcleo, cada um com seu socket SO_REUSEPORT
+    MODE_URING    // Workers io_uring por núcleo (recua para shards sem suporte)
+} ServerMode;
 
 volatile sig_atomic_t g_server_running = 1;
 static int g_server_socket = -1;
 
 
 void filter_message(char* message);
-void send_private_message(const char* message, const char* sender_nickname, const char* target_nickname, int sender_socket);
-
-
-typedef struct {
-    int socket;
-    char nickname[BUFFER_SIZE];
-} Client;
+void send_private_message(const char* message, const char* sender_nickname, const char* target_nickname, Conn* sender);
 
-static Client clients[MAX_CLIENTS];
-static int client_count = 0;
-static pthread_mutex_t clients_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 // OBS: A lista de palavras é apenas um exemplo para a funcionalidade de moderação.
-static char* moderator_words[MAX_MODERATOR_WORDS];
-static int num_moderator_words = 0;
-
-// --- Estruturas para o histórico de mensagens ---
-static char* message_history[HISTORY_SIZE];
-static int history_count = 0;
-static int history_start = 0;
-static pthread_mutex_t history_mutex = PTHREAD_MUTEX_INITIALIZER;
+// Publicada por troca atômica; os filtros a leem dentro de uma seção RCU.
+static _Atomic(ModMatcher*) moderator = NULL;
+
+// Thread que recarrega a lista (SIGHUP ou alteração do arquivo)
+static pthread_t g_watcher_thread;
+static int g_watcher_stop_fd = -1;
+
+// Listener de administração (--admin-port)
+static pthread_t g_admin_thread;
+static int g_admin_socket = -1;
+static int g_admin_stop_fd = -1;
+
+// Modo "threads": as threads de cliente são destacadas; o encerramento as
+// acorda pelo eventfd e espera a contagem zerar antes de liberar salas e
+// filtro, que elas ainda usam ao sair (chat_on_disconnect)
+static int g_client_threads = 0;
+static pthread_mutex_t g_client_threads_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_client_threads_done = PTHREAD_COND_INITIALIZER;
+static int g_client_stop_fd = -1;
 
 // --- Funções de Gerenciamento de Clientes (com proteção de mutex) ---
 
-void add_client(int socket, const char* nickname) {
-    pthread_mutex_lock(&clients_mutex);
-    if (client_count < MAX_CLIENTS) {
-        clients[client_count].socket = socket;
-        strncpy(clients[client_count].nickname, nickname, BUFFER_SIZE - 1);
-        clients[client_count].nickname[BUFFER_SIZE - 1] = '\0';
-        client_count++;
+// O registro (registry.h) não tem limite de clientes e guarda apenas o
+// ponteiro da conexão; o nickname internado fica na própria Conn.
+// Retorna o resultado de registry_add (REGISTRY_NAME_TAKEN se o nome já existe).
+int add_client(Conn* conn) {
+    int rc = registry_add(conn);
+    if (rc == -1) {
+        LOG_ERROR("Falha ao registrar o cliente (memória insuficiente).");
     }
-    pthread_mutex_unlock(&clients_mutex);
+    return rc;
 }
 
-void remove_client(int socket) {
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < client_count; i++) {
-        if (clients[i].socket == socket) {
-            clients[i] = clients[client_count - 1]; 
-            client_count--;
-            break;
-        }
+void remove_client(Conn* conn) {
+    registry_remove(conn);
+}
+
+// --- Consultas ao log persistente (/history) ---
+
+// Converte "AAAA-MM-DD HH:MM", "AAAA-MM-DD", "HH:MM" (hoje) ou segundos
+// Unix (com fração opcional) em milissegundos desde a época.
+// Retorna -1 se o formato for inválido.
+static int parse_since(const char* arg, int64_t* out_ms) {
+    int y, mo, d, h = 0, mi = 0, end = 0;
+    time_t now = time(NULL);
+    struct tm tm;
+    localtime_r(&now, &tm);
+    tm.tm_sec = 0;
+
+    if (sscanf(arg, "%d-%d-%d %d:%d %n", &y, &mo, &d, &h, &mi, &end) == 5 ||
+        (end = 0, sscanf(arg, "%d-%d-%d %n", &y, &mo, &d, &end) == 3)) {
+        tm.tm_year = y - 1900;
+        tm.tm_mon = mo - 1;
+        tm.tm_mday = d;
+    } else if (end = 0, sscanf(arg, "%d:%d %n", &h, &mi, &end) != 2) {
+        // Segundos Unix, com milissegundos opcionais ("1700000000.250")
+        char* rest;
+        long long secs = strtoll(arg, &rest, 10);
+        int ms = 0;
+        if (*rest == '.' && (sscanf(rest + 1, "%3d%n", &ms, &end) != 1 || end != 3)) return -1;
+        if (*rest == '.') rest += 4;
+        if (rest == arg || *rest != '\0' || secs < 0 || ms < 0) return -1;
+        *out_ms = (int64_t)secs * 1000 + ms;
+        return 0;
     }
-    pthread_mutex_unlock(&clients_mutex);
+    if (arg[end] != '\0' || h < 0 || h > 23 || mi < 0 || mi > 59) return -1;
+    tm.tm_hour = h;
+    tm.tm_min = mi;
+    tm.tm_isdst = -1;
+    time_t t = mktime(&tm);
+    if (t == (time_t)-1) return -1;
+    *out_ms = (int64_t)t * 1000;
+    return 0;
 }
 
-// Adiciona uma mensagem ao buffer circular do histórico
-void add_to_history(const char* message) {
-    pthread_mutex_lock(&history_mutex);
-    
-    // Libera a memória da mensagem mais antiga se o buffer estiver cheio
-    if (history_count == HISTORY_SIZE) {
-        free(message_history[history_start]);
-        history_start = (history_start + 1) % HISTORY_SIZE;
+// /history <n> ou /history since <quando>: lê o log da sala em disco sob demanda
+static void chat_on_history(Conn* c, const char* args) {
+    char reply[BUFFER_SIZE];
+    RoomQuery q;
+    int rc;
+    int since_query = strncmp(args, "since ", 6) == 0;
+    if (since_query) {
+        int64_t since_ms;
+        if (parse_since(args + 6, &since_ms) < 0) {
+            const char* msg = "[SERVER]: Horário inválido. Use AAAA-MM-DD HH:MM, AAAA-MM-DD, HH:MM ou segundos Unix.\n";
+            conn_send(c, msg, strlen(msg));
+            return;
+        }
+        rc = room_query_since(c->room, c, since_ms, HISTORY_QUERY_MAX, &q);
     } else {
-        history_count++;
+        char* rest;
+        long n = strtol(args, &rest, 10);
+        if (rest == args || *rest != '\0' || n < 1) {
+            const char* msg = "[SERVER]: Uso: /history <n> ou /history since <AAAA-MM-DD HH:MM | HH:MM | segundos Unix>\n";
+            conn_send(c, msg, strlen(msg));
+            return;
+        }
+        if (n > HISTORY_QUERY_MAX) n = HISTORY_QUERY_MAX;
+        rc = room_query_last(c->room, c, (size_t)n, &q);
     }
 
-    // Calcula o índice para a nova mensagem
-    int new_index = (history_start + history_count - 1) % HISTORY_SIZE;
-    message_history[new_index] = strdup(message);
-
-    pthread_mutex_unlock(&history_mutex);
+    if (rc < 0) {
+        snprintf(reply, sizeof(reply), "[SERVER]: O log persistente está desativado neste servidor.\n");
+    } else if (q.sent < q.visited) {
+        snprintf(reply, sizeof(reply), "[SERVER]: Memória insuficiente; consulta interrompida após %zu mensagens.\n", q.sent);
+    } else if (since_query && q.visited == HISTORY_QUERY_MAX) {
+        snprintf(reply, sizeof(reply), "[SERVER]: %zu mensagens (limite por consulta). Continue com /history since %lld.%03d\n",
+                 q.visited, (long long)((q.last_ts + 1) / 1000), (int)((q.last_ts + 1) % 1000));
+    } else {
+        snprintf(reply, sizeof(reply), "[SERVER]: %zu mensagens encontradas.\n", q.visited);
+    }
+    conn_send(c, reply, strlen(reply));
 }
 
-// Envia o histórico de mensagens para um cliente recém-conectado
-void send_history(int client_socket) {
-    // 1. Criar armazenamento local para a cópia do histórico
-    char* local_history[HISTORY_SIZE];
-    int local_count = 0;
-
-    // Inicializa o array local para evitar ponteiros "lixo"
-    for (int i = 0; i < HISTORY_SIZE; i++) {
-        local_history[i] = NULL;
+// Entrega um buffer já filtrado a todos os clientes, exceto o remetente.
+// Cada fila recebe apenas uma referência ao mesmo buffer.
+void broadcast_buf(MsgBuf* buf, const Conn* sender) {
+    if (reactor_is_sharded()) {
+        reactor_broadcast(buf, sender);
+        return;
     }
 
-    // 2. Iniciar seção crítica para copiar os dados
-    pthread_mutex_lock(&history_mutex);
+    // Fotografia emprestada do registro: nenhuma cópia por mensagem
+    uint64_t start = metrics_now();
+    ClientSnapshot* snap = registry_acquire();
+    if (!snap) return;
 
-    for (int i = 0; i < history_count; i++) {
-        int index = (history_start + i) % HISTORY_SIZE;
-        if (message_history[index] != NULL) {
-            // strdup aloca nova memória e copia o conteúdo da string.
-            // Isso é crucial para evitar que a string original seja liberada por outra thread enquanto estamos usando a cópia.
-            local_history[local_count] = strdup(message_history[index]);
-            
-            // Verifica se strdup teve sucesso antes de incrementar
-            if (local_history[local_count] != NULL) {
-                local_count++;
+    size_t delivered = 0;
+    for (size_t i = 0; i < snap->count; i++) {
+        if (snap->conns[i] != sender) {
+            if (conn_send_buf(snap->conns[i], buf) < 0) {
+                LOG_ERROR("Falha ao enviar mensagem broadcast.");
+            } else {
+                delivered++;
             }
         }
     }
+    registry_release(snap);
+    metrics_add(METRIC_MSG_DELIVERED, delivered);
+    metrics_record(METRIC_FANOUT, start);
+}
 
-    // 3. Encerrar a seção crítica. Agora estamos seguros para fazer I/O.
-    pthread_mutex_unlock(&history_mutex);
+// Filtra uma cópia da mensagem e a envia a todos, exceto o remetente
+void broadcast_message(const char* message, const Conn* sender) {
+    MsgBuf* buf = msgbuf_from(message, strlen(message));
+    if (!buf) {
+        LOG_ERROR("Falha ao alocar mensagem broadcast.");
+        return;
+    }
+    filter_message(buf->data);
+    broadcast_buf(buf, sender);
+    msgbuf_unref(buf);
+}
 
+// Como broadcast_message(), mas apenas para os membros da sala
+static void room_message(Room* r, const char* message, const Conn* sender) {
+    MsgBuf* buf = msgbuf_from(message, strlen(message));
+    if (!buf) {
+        LOG_ERROR("Falha ao alocar aviso da sala.");
+        return;
+    }
+    filter_message(buf->data);
+    room_notify(r, buf, sender);
+    msgbuf_unref(buf);
+}
 
-    // 4. Realizar as operações de I/O de rede (lentas) fora do bloqueio do mutex
-    char history_header[] = "--- Histórico das últimas mensagens ---\n";
-    write(client_socket, history_header, strlen(history_header));
+// Conclui o handshake: registra o cliente, coloca-o na sala (a informada ao
+// reconectar ou a padrão), envia o histórico a partir de after_seq (a
+// última mensagem que ele viu nela) e anuncia a entrada.
+// Se o nickname já estiver em uso, a conexão continua aguardando outro nome.
+static void chat_on_join(Conn* c, uint64_t after_seq, const char* room) {
+    char message[BUFFER_SIZE + 100];
+
+    int rc = add_client(c);
+    if (rc != 0) {
+        if (rc == REGISTRY_NAME_TAKEN) {
+            snprintf(message, sizeof(message), "[SERVER]: O nickname '%s' já está em uso. Digite outro nickname:\n", c->nickname);
+            conn_send(c, message, strlen(message));
+        }
+        intern_release(c->nickname);
+        c->nickname = NULL;
+        return;
+    }
+    c->state = CONN_ACTIVE;
 
-    for (int i = 0; i < local_count; i++) {
-        write(client_socket, local_history[i], strlen(local_history[i]));
+    Room* r = room_acquire(room ? room : ROOM_DEFAULT);
+    if (!r && room) {
+        // Sala informada inválida: a numeração não vale para a padrão
+        r = room_acquire(ROOM_DEFAULT);
+        after_seq = 0;
     }
+    if (!r) {
+        LOG_ERROR("Falha ao abrir a sala do cliente.");
+        return;
+    }
+    room_enter(r, c, after_seq);
 
-    char history_footer[] = "--- Fim do histórico ---\n";
-    write(client_socket, history_footer, strlen(history_footer));
+    snprintf(message, sizeof(message), "[SERVER]: %s entrou no chat.\n", c->nickname);
+    LOG_INFO(message);
+    if (c->room) room_message(c->room, message, c);
+}
 
+// /join <sala> e /part: troca a sala do cliente (uma por vez; /part volta
+// para a sala padrão)
+static void chat_on_switch_room(Conn* c, const char* name) {
+    char message[BUFFER_SIZE + 100];
+    if (*name == '#') name++;
 
-    // 5. Liberar a memória que foi alocada por strdup para evitar vazamentos
-    for (int i = 0; i < local_count; i++) {
-        free(local_history[i]);
+    if (!room_name_valid(name)) {
+        snprintf(message, sizeof(message), "[SERVER]: Nome de sala inválido. Use até %d letras, dígitos, '_' ou '-'.\n", ROOM_NAME_MAX);
+        conn_send(c, message, strlen(message));
+        return;
+    }
+    if (c->room && strcmp(room_name(c->room), name) == 0) {
+        snprintf(message, sizeof(message), "[SERVER]: Você já está na sala #%s.\n", name);
+        conn_send(c, message, strlen(message));
+        return;
+    }
+    Room* next = room_acquire(name);
+    if (!next) {
+        snprintf(message, sizeof(message), "[SERVER]: Não foi possível abrir a sala #%s.\n", name);
+        conn_send(c, message, strlen(message));
+        return;
+    }
+
+    if (c->room) {
+        snprintf(message, sizeof(message), "[SERVER]: %s foi para a sala #%s.\n", c->nickname, name);
+        room_message(c->room, message, c);
+        room_leave(c);
+    }
+    snprintf(message, sizeof(message), "[SERVER]: Você entrou na sala #%s.\n", name);
+    conn_send(c, message, strlen(message));
+    room_enter(next, c, 0);
+    if (c->room) {
+        snprintf(message, sizeof(message), "[SERVER]: %s entrou na sala.\n", c->nickname);
+        room_message(c->room, message, c);
     }
 }
 
-void broadcast_message(const char* message, int sender_socket) {
-    // Faz uma cópia local e filtra essa cópia — envia a cópia filtrada.
-    char filtered_msg[(BUFFER_SIZE * 2)];
-    strncpy(filtered_msg, message, sizeof(filtered_msg) - 1);
-    filtered_msg[sizeof(filtered_msg) - 1] = '\0';
-    filter_message(filtered_msg);
+// Trata uma mensagem privada (comando /msg ou quadro FRAME_PRIVATE)
+static void chat_on_private(Conn* c, const char* target_nickname, const char* content) {
+    LOG_INFOF("Solicitação de mensagem privada: %.20s -> %.20s: %.100s", c->nickname, target_nickname, content);
+    // O filtro é aplicado uma vez, na mensagem completa, antes do envio
+    send_private_message(content, c->nickname, target_nickname, c);
+}
 
-    // Mantendo o padrão de "copiar e depois enviar"
-    Client local_clients[MAX_CLIENTS];
-    int local_client_count;
+// Só clientes conectados pela interface local podem ver as estatísticas
+static int is_local_peer(int fd) {
+    struct sockaddr_storage addr;
+    socklen_t len = sizeof(addr);
+    if (getpeername(fd, (struct sockaddr*)&addr, &len) < 0) return 0;
+    if (addr.ss_family == AF_INET) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)&addr;
+        return (ntohl(in->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (addr.ss_family == AF_INET6) {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*)&addr;
+        return IN6_IS_ADDR_LOOPBACK(&in6->sin6_addr);
+    }
+    return 0;
+}
 
-    pthread_mutex_lock(&clients_mutex);
-    local_client_count = client_count;
-    memcpy(local_clients, clients, sizeof(Client) * client_count);
-    pthread_mutex_unlock(&clients_mutex);
+// /stats: fotografia das métricas (metrics.h) para administradores locais
+static void chat_on_stats(Conn* c) {
+    if (!is_local_peer(c->fd)) {
+        const char* msg = "[SERVER]: /stats só está disponível para conexões locais.\n";
+        conn_send(c, msg, strlen(msg));
+        return;
+    }
+    char text[METRICS_TEXT_MAX];
+    size_t len = metrics_snapshot(text, sizeof(text));
+    conn_send(c, text, len);
+}
 
-    for (int i = 0; i < local_client_count; i++) {
-        if (local_clients[i].socket != sender_socket) {
-            if (write(local_clients[i].socket, filtered_msg, strlen(filtered_msg)) < 0) {
-                LOG_ERROR("Falha ao enviar mensagem broadcast.");
-            }
+// Trata uma linha completa recebida de um cliente ativo
+static void chat_on_line(Conn* c, char* buffer) {
+    const char* nickname = c->nickname;
+
+    if (strncmp(buffer, "/stats", 6) == 0 && strspn(buffer + 6, " \r\n") == strlen(buffer + 6)) {
+        chat_on_stats(c);
+    } else if (!c->room) {
+        const char* msg = "[SERVER]: Você não está em nenhuma sala. Use /join <sala>.\n";
+        if (strncmp(buffer, "/join ", 6) == 0) {
+            char* name = buffer + 6;
+            name[strcspn(name, " \r\n")] = '\0';
+            chat_on_switch_room(c, name);
+        } else {
+            conn_send(c, msg, strlen(msg));
+        }
+    } else if (strncmp(buffer, "/history", 8) == 0 && (buffer[8] == ' ' || buffer[8] == '\n' || buffer[8] == '\0')) {
+        char* args = buffer + 8;
+        while (*args == ' ') args++;
+        args[strcspn(args, "\r\n")] = '\0';
+        chat_on_history(c, args);
+    } else if (strncmp(buffer, "/join ", 6) == 0) {
+        char* name = buffer + 6;
+        while (*name == ' ') name++;
+        name[strcspn(name, " \r\n")] = '\0';
+        chat_on_switch_room(c, name);
+    } else if (strncmp(buffer, "/part", 5) == 0 && strspn(buffer + 5, " \r\n") == strlen(buffer + 5)) {
+        if (strcmp(room_name(c->room), ROOM_DEFAULT) == 0) {
+            const char* msg = "[SERVER]: Você já está na sala padrão (#" ROOM_DEFAULT ").\n";
+            conn_send(c, msg, strlen(msg));
+        } else {
+            chat_on_switch_room(c, ROOM_DEFAULT);
+        }
+    } else if (strncmp(buffer, "/msg ", 5) == 0) {
+        // É uma mensagem privada
+        char target_nickname[BUFFER_SIZE];
+        char private_msg_content[BUFFER_SIZE] = "";
+        
+        if (sscanf(buffer + 5, "%s %[^\n]", target_nickname, private_msg_content) >= 1) {
+            chat_on_private(c, target_nickname, private_msg_content);
+        } else {
+            char* usage_msg = "[SERVER]: Uso incorreto. Use: /msg <nickname> <mensagem>\n";
+            conn_send(c, usage_msg, strlen(usage_msg));
+            LOG_WARNF("Uso incorreto de /msg por %s: %s", nickname, buffer);
+        }
+    } else {
+        // É uma mensagem pública: formatada e filtrada uma única vez em um
+        // buffer compartilhado por histórico, clientes e log.
+        MsgBuf* frame = msgbuf_printf("[%s]: %s", nickname, buffer);
+        if (!frame) {
+            LOG_ERROR("Falha ao alocar mensagem pública.");
+            return;
+        }
+        filter_message(frame->data);
+        msgbuf_set_type(frame, FRAME_PUBLIC);
+        metrics_add(METRIC_MSG_PUBLIC, 1);
+
+        // Só os membros da sala recebem; o log em disco e o histórico são os dela
+        if (room_publish(c->room, frame, c) == 0) {
+            LOG_AT(LOGMOD_HISTORY, ERROR, "Falha ao gravar a mensagem no log persistente.");
+        }
+
+        // O logger recebe a última referência, sem o '\n' final
+        if (TSLOG_ENABLED(LOGMOD_CHAT, INFO)) {
+            uint64_t start = metrics_now();
+            logger_log_ref(INFO, frame->data, frame->payload_len, msgbuf_release, frame);
+            metrics_record(METRIC_LOG, start);
+        } else {
+            msgbuf_unref(frame);
         }
     }
 }
 
-void* handle_client(void* arg) {
-    int client_socket = *(int*)arg;
-    free(arg);
+// Protocolo de linhas: o primeiro trecho (até '\n') é o nickname e cada
+// linha seguinte é uma mensagem ou comando
+static void chat_process_lines(Conn* c) {
+    size_t start = 0;
+
+    while (c->state == CONN_AWAIT_NICK && start < c->in_len) {
+        // O nickname vai até o '\n'; clientes antigos o enviam sem
+        // terminador, então um trecho sem '\n' é usado inteiro.
+        const char* nick = c->in_buf + start;
+        char* nl = memchr(nick, '\n', c->in_len - start);
+        size_t nick_len = nl ? (size_t)(nl - nick) : c->in_len - start;
+        start += nl ? nick_len + 1 : nick_len;
+
+        while (nick_len > 0 && nick[nick_len - 1] == '\r') nick_len--;
+        if (nick_len > 0) {
+            c->nickname = intern_acquire(nick, nick_len);
+            if (c->nickname) chat_on_join(c, 0, NULL);
+        }
+    }
 
-    char nickname[BUFFER_SIZE];
-    char buffer[BUFFER_SIZE];
-    char message[(BUFFER_SIZE * 2) + 100];
-    int read_size;
+    while (c->state == CONN_ACTIVE && start < c->in_len) {
+        char line[BUFFER_SIZE];
+        char* nl = memchr(c->in_buf + start, '\n', c->in_len - start);
+        size_t line_len;
 
-    if ((read_size = read(client_socket, nickname, sizeof(nickname) - 1)) > 0) {
-        nickname[read_size] = '\0';
-    } else {
-        close(client_socket);
-        return NULL;
+        if (nl) {
+            line_len = (size_t)(nl - (c->in_buf + start)) + 1;
+        } else if (start == 0 && c->in_len == sizeof(c->in_buf) - 1) {
+            line_len = c->in_len; // Linha maior que o buffer: processa o que couber
+        } else {
+            break; // Linha incompleta; aguarda mais dados
+        }
+
+        memcpy(line, c->in_buf + start, line_len);
+        line[line_len] = '\0';
+        start += line_len;
+        chat_on_line(c, line);
     }
-    
-    add_client(client_socket, nickname);
 
-    snprintf(message, sizeof(message), "[SERVER]: %s entrou no chat.\n", nickname);
-    LOG_INFO(message);
-    broadcast_message(message, client_socket);
+    memmove(c->in_buf, c->in_buf + start, c->in_len - start);
+    c->in_len -= start;
+}
 
-    send_history(client_socket);
+// Corta a conexão após um erro de protocolo; o fim da leitura conduz o
+// desligamento normal
+static void chat_protocol_error(Conn* c, const char* reason) {
+    char message[200];
+    snprintf(message, sizeof(message), "[SERVER]: Erro de protocolo: %s\n", reason);
+    conn_send(c, message, strlen(message));
+    LOG_AT(LOGMOD_NET, WARNING, "Erro de protocolo (fd %d): %s", c->fd, reason);
+    c->proto_error = 1;
+    c->in_len = 0;
+    shutdown(c->fd, SHUT_RD);
+}
 
-    while ((read_size = read(client_socket, buffer, sizeof(buffer) - 1)) > 0) {
-        buffer[read_size] = '\0';
-        
-        if (strncmp(buffer, "/msg ", 5) == 0) {
-            // É uma mensagem privada
-            char target_nickname[BUFFER_SIZE];
-            char private_msg_content[BUFFER_SIZE];
-            
-            if (sscanf(buffer + 5, "%s %[^\n]", target_nickname, private_msg_content) >= 1) {
-                char log_request[BUFFER_SIZE * 3];
-                snprintf(log_request, sizeof(log_request), "Solicitação de mensagem privada: %.20s -> %.20s: %.100s", nickname, target_nickname, private_msg_content);
-                LOG_INFO(log_request);
-                // Filtra o conteúdo da mensagem privada ANTES de enviá-la.
-                filter_message(private_msg_content);
-                 
-                send_private_message(private_msg_content, nickname, target_nickname, client_socket);
-            } else {
-                char* usage_msg = "[SERVER]: Uso incorreto. Use: /msg <nickname> <mensagem>\n";
-                write(client_socket, usage_msg, strlen(usage_msg));
-                char log_error[BUFFER_SIZE * 3];
-                snprintf(log_error, sizeof(log_error), "Uso incorreto de /msg por %s: %s", nickname, buffer);
-                LOG_WARN(log_error);
+// Trata um quadro completo recebido de um cliente do protocolo de quadros
+static void chat_on_frame(Conn* c, FrameType type, const char* payload, size_t len) {
+    if (c->state == CONN_AWAIT_NICK) {
+        if (type != FRAME_JOIN) {
+            const char* msg = "[SERVER]: Envie seu nickname (JOIN) antes de conversar.\n";
+            conn_send(c, msg, strlen(msg));
+        } else if (len > FRAME_SEQ_SIZE && payload[FRAME_SEQ_SIZE] != '\0') {
+            // [última mensagem vista][nickname] ou [...][nickname]\0[sala]
+            const char* nick = payload + FRAME_SEQ_SIZE;
+            size_t rest = len - FRAME_SEQ_SIZE;
+            const char* sep = memchr(nick, '\0', rest);
+            size_t nick_len = sep ? (size_t)(sep - nick) : rest;
+            char room[ROOM_NAME_MAX + 1] = "";
+            if (sep) {
+                size_t room_len = rest - nick_len - 1;
+                if (room_len > ROOM_NAME_MAX || memchr(sep + 1, '\0', room_len)) {
+                    chat_protocol_error(c, "sala inválida no JOIN");
+                    return;
+                }
+                memcpy(room, sep + 1, room_len);
+                room[room_len] = '\0';
             }
+            c->nickname = intern_acquire(nick, nick_len);
+            if (c->nickname) chat_on_join(c, frame_get_seq(payload), room[0] ? room : NULL);
+        }
+        return;
+    }
+
+    // Conteúdo terminado em '\n', como uma linha do protocolo de texto. Uma
+    // quebra de linha no meio forjaria linhas extras para clientes de texto.
+    if ((type == FRAME_PUBLIC || type == FRAME_PRIVATE) &&
+        (memchr(payload, '\n', len) || memchr(payload, '\r', len))) {
+        chat_protocol_error(c, "quebra de linha no conteúdo do quadro");
+        return;
+    }
+
+    char line[BUFFER_SIZE];
+    switch (type) {
+        case FRAME_PUBLIC:
+            memcpy(line, payload, len);
+            line[len] = '\n';
+            line[len + 1] = '\0';
+            chat_on_line(c, line);
+            break;
+        case FRAME_PRIVATE: {
+            const char* sep = memchr(payload, '\0', len);
+            if (!sep || sep == payload) {
+                chat_protocol_error(c, "quadro privado sem destinatário");
+                break;
+            }
+            size_t text_len = len - (size_t)(sep + 1 - payload);
+            memcpy(line, sep + 1, text_len);
+            line[text_len] = '\0';
+            chat_on_private(c, payload, line);
+            break;
+        }
+        default:
+            chat_protocol_error(c, "tipo de quadro inesperado");
+            break;
+    }
+}
+
+// Protocolo de quadros: vários quadros podem chegar em uma leitura e um
+// quadro pode chegar dividido entre leituras; o resto fica em in_buf.
+static void chat_process_frames(Conn* c) {
+    size_t start = 0;
+
+    while (c->state != CONN_CLOSED && c->in_len > 0) {
+        FrameType type;
+        const char* payload;
+        size_t len;
+        long n = frame_parse(c->in_buf + start, c->in_len - start, MAX_CLIENT_PAYLOAD, &type, &payload, &len);
+        if (n == 0) break;
+        if (n < 0) {
+            chat_protocol_error(c, "quadro inválido ou grande demais");
+            return;
+        }
+        start += (size_t)n;
+        chat_on_frame(c, type, payload, len);
+    }
+
+    if (c->proto_error) return;
+    memmove(c->in_buf, c->in_buf + start, c->in_len - start);
+    c->in_len -= start;
+}
+
+void chat_process_input(Conn* c) {
+    uint64_t start = metrics_now();
+    if (c->state == CONN_CLOSED || c->proto_error) {
+        c->in_len = 0;
+        return;
+    }
+
+    // O primeiro byte escolhe o protocolo: o preâmbulo começa com '\0'
+    if (c->proto == CONN_PROTO_UNKNOWN && c->in_len > 0) {
+        if (c->in_buf[0] != PROTO_PREAMBLE[0]) {
+            c->proto = CONN_PROTO_LINES;
+        } else if (c->in_len < PROTO_PREAMBLE_SIZE) {
+            return; // Preâmbulo incompleto
+        } else if (memcmp(c->in_buf, PROTO_PREAMBLE, PROTO_PREAMBLE_SIZE) != 0) {
+            // A resposta sai em texto, que qualquer cliente lê
+            chat_protocol_error(c, "versão de protocolo não suportada");
+            return;
         } else {
-            // É uma mensagem pública
-            snprintf(message, sizeof(message), "[%s]: %s", nickname, buffer);
-            filter_message(message);
-            
-            char log_msg[(BUFFER_SIZE * 2) + 100];
-            snprintf(log_msg, sizeof(log_msg), "Mensagem recebida de %s: %s", nickname, buffer);
-            LOG_INFO(log_msg);
+            c->proto = CONN_PROTO_FRAMES;
+            memmove(c->in_buf, c->in_buf + PROTO_PREAMBLE_SIZE, c->in_len - PROTO_PREAMBLE_SIZE);
+            c->in_len -= PROTO_PREAMBLE_SIZE;
+        }
+    }
 
-            char filtered_message[(BUFFER_SIZE * 2) + 100];
-            strncpy(filtered_message, message, sizeof(filtered_message) - 1);
-            filtered_message[sizeof(filtered_message) - 1] = '\0';
-            filter_message(filtered_message);
+    if (c->proto == CONN_PROTO_FRAMES) {
+        chat_process_frames(c);
+    } else {
+        chat_process_lines(c);
+    }
+    metrics_record(METRIC_INPUT, start);
+}
 
-            add_to_history(filtered_message);
-            broadcast_message(filtered_message, client_socket);
+void chat_on_disconnect(Conn* c) {
+    if (c->state == CONN_ACTIVE) {
+        char message[BUFFER_SIZE + 100];
+        snprintf(message, sizeof(message), "[SERVER]: %s saiu do chat.\n", c->nickname);
+        LOG_INFO(message);
+        if (c->room) {
+            room_message(c->room, message, c);
+            room_leave(c);
         }
+        remove_client(c);
     }
+    conn_mark_closed(c);
+}
 
-    snprintf(message, sizeof(message), "[SERVER]: %s saiu do chat.\n", nickname);
-    LOG_INFO(message);
-    broadcast_message(message, client_socket);
+// Modo "threads": uma thread por cliente. Ela lê o socket e também envia
+// o que os remetentes deixaram na fila quando o kernel não aceitou tudo
+// (acordada pelo wake_fd da conexão).
+static void client_thread_exit(void) {
+    pthread_mutex_lock(&g_client_threads_mutex);
+    if (--g_client_threads == 0) pthread_cond_broadcast(&g_client_threads_done);
+    pthread_mutex_unlock(&g_client_threads_mutex);
+}
+
+// Acorda as threads de cliente (inclusive as que ainda não concluíram o
+// handshake) e espera até timeout_ms que todas terminem.
+// Retorna 0 se todas terminaram, -1 no prazo esgotado.
+static int stop_client_threads(int timeout_ms) {
+    if (g_client_stop_fd >= 0) {
+        uint64_t one = 1;
+        (void)!write(g_client_stop_fd, &one, sizeof(one));
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (long)(timeout_ms % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    int rc = 0;
+    pthread_mutex_lock(&g_client_threads_mutex);
+    while (g_client_threads > 0 && rc == 0) {
+        rc = pthread_cond_timedwait(&g_client_threads_done, &g_client_threads_mutex, &deadline);
+    }
+    int remaining = g_client_threads;
+    pthread_mutex_unlock(&g_client_threads_mutex);
+    return remaining == 0 ? 0 : -1;
+}
+
+void* handle_client(void* arg) {
+    int client_socket = *(int*)arg;
+    free(arg);
 
-    close(client_socket);
-    remove_client(client_socket);
+    Conn* c = conn_create(client_socket, 0);
+    if (!c) {
+        close(client_socket);
+        client_thread_exit();
+        return NULL;
+    }
+
+    // O eventfd de encerramento nunca é zerado: basta uma escrita para
+    // acordar todas as threads
+    struct pollfd fds[3] = {
+        { .fd = client_socket, .events = POLLIN },
+        { .fd = c->wake_fd, .events = POLLIN },
+        { .fd = g_client_stop_fd, .events = POLLIN },
+    };
+    for (;;) {
+        fds[0].events = POLLIN | (conn_has_output(c) ? POLLOUT : 0);
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[2].revents & POLLIN) {
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            conn_clear_wake(c);
+        }
+        if ((fds[0].revents & POLLOUT) && conn_flush(c) < 0) {
+            break;
+        }
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            uint64_t start = metrics_now();
+            ssize_t read_size = read(client_socket, c->in_buf + c->in_len, sizeof(c->in_buf) - 1 - c->in_len);
+            if (read_size <= 0) break;
+            metrics_record(METRIC_READ, start);
+            metrics_add(METRIC_BYTES_IN, (uint64_t)read_size);
+            c->in_len += (size_t)read_size;
+            chat_process_input(c);
+        }
+    }
+
+    chat_on_disconnect(c);
+    conn_unref(c);
+    client_thread_exit();
     return NULL;
 }
 
 /**
  * @brief Carrega a lista de palavras para moderação do arquivo moderador.txt.
- * As palavras são usadas como exemplo para demonstrar a funcionalidade.
+ * As palavras são compiladas em um autômato Aho-Corasick, então o custo do
+ * filtro não depende do tamanho da lista.
  */
 void load_moderator_list() {
-    FILE* file = fopen("moderador.txt", "r");
-    if (file == NULL) {
-        LOG_WARN("Arquivo moderador.txt não encontrado. O filtro de palavras não estará ativo.");
+    size_t num_words = 0;
+    ModMatcher* matcher = mod_matcher_load(MODERATION_FILE, &num_words);
+    if (matcher == NULL) {
+        LOG_AT(LOGMOD_MODERATION, WARNING, "Arquivo moderador.txt não encontrado. O filtro de palavras não estará ativo.");
         return;
     }
+    atomic_store(&moderator, matcher);
 
-    char line[100];
-    while (fgets(line, sizeof(line), file) && num_moderator_words < MAX_MODERATOR_WORDS) {
-        // Ignora linhas de comentário (que começam com #) e linhas vazias
-        if (line[0] == '#' || line[0] == '\n' || line[0] == '\r') {
-            continue;
+    if (num_words > 0) {
+        LOG_AT(LOGMOD_MODERATION, INFO, "Filtro de moderação ativado. Carregadas %zu palavras de exemplo.", num_words);
+    }
+}
+
+/**
+ * @brief Recarrega moderador.txt sem interromper as conexões.
+ *
+ * O novo autômato é construído inteiro nesta thread e publicado com uma
+ * troca atômica; o antigo só é liberado depois que todos os filtros que
+ * ainda podiam usá-lo terminaram. Se o arquivo não puder ser lido, a lista
+ * atual é mantida.
+ */
+static void reload_moderator_list(void) {
+    size_t num_words = 0;
+    ModMatcher* fresh = mod_matcher_load(MODERATION_FILE, &num_words);
+    if (fresh == NULL) {
+        LOG_AT(LOGMOD_MODERATION, WARNING, "Não foi possível recarregar moderador.txt. A lista atual foi mantida.");
+        return;
+    }
+
+    ModMatcher* old = atomic_exchange(&moderator, fresh);
+    rcu_synchronize();
+    mod_matcher_free(old);
+
+    LOG_AT(LOGMOD_MODERATION, INFO, "Lista de moderação recarregada: %zu palavras.", num_words);
+}
+
+// Aguarda SIGHUP (via signalfd) ou a gravação de moderador.txt (via inotify)
+static void* moderation_watcher(void* arg) {
+    (void)arg;
+    sigset_t hup;
+    sigemptyset(&hup);
+    sigaddset(&hup, SIGHUP);
+
+    int sig_fd = signalfd(-1, &hup, SFD_NONBLOCK | SFD_CLOEXEC);
+    int watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    // Observa o diretório: editores costumam gravar um arquivo novo e renomeá-lo
+    if (watch_fd >= 0 && inotify_add_watch(watch_fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        close(watch_fd);
+        watch_fd = -1;
+    }
+    if (watch_fd < 0) LOG_AT(LOGMOD_MODERATION, WARNING, "inotify indisponível. Use SIGHUP para recarregar a moderação.");
+
+    struct pollfd fds[3] = {
+        { .fd = g_watcher_stop_fd, .events = POLLIN },
+        { .fd = sig_fd, .events = POLLIN },
+        { .fd = watch_fd, .events = POLLIN },
+    };
+
+    for (;;) {
+        if (poll(fds, 3, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
         }
+        if (fds[0].revents) break;
 
-        // Remove o caractere de nova linha (\n ou \r) do final da linha
-        line[strcspn(line, "\r\n")] = 0;
-        
-        if (strlen(line) > 0) {
-            moderator_words[num_moderator_words] = strdup(line);
-            num_moderator_words++;
+        int reload = 0;
+        if (fds[1].revents & POLLIN) {
+            struct signalfd_siginfo info;
+            while (read(sig_fd, &info, sizeof(info)) == (ssize_t)sizeof(info)) reload = 1;
+            if (reload) LOG_AT(LOGMOD_MODERATION, INFO, "Sinal SIGHUP recebido. Recarregando a lista de moderação...");
+        }
+        if (fds[2].revents & POLLIN) {
+            char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            ssize_t n;
+            while ((n = read(watch_fd, buf, sizeof(buf))) > 0) {
+                for (char* p = buf; p < buf + n; ) {
+                    const struct inotify_event* ev = (const struct inotify_event*)p;
+                    if (ev->len && strcmp(ev->name, MODERATION_FILE) == 0) reload = 1;
+                    p += sizeof(struct inotify_event) + ev->len;
+                }
+            }
         }
+        if (reload) reload_moderator_list();
     }
-    fclose(file);
 
-    if (num_moderator_words > 0) {
-        char log_msg[100];
-        snprintf(log_msg, sizeof(log_msg), "Filtro de moderação ativado. Carregadas %d palavras de exemplo.", num_moderator_words);
-        LOG_INFO(log_msg);
+    if (sig_fd >= 0) close(sig_fd);
+    if (watch_fd >= 0) close(watch_fd);
+    return NULL;
+}
+
+static int start_moderation_watcher(void) {
+    g_watcher_stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (g_watcher_stop_fd < 0) return -1;
+    if (pthread_create(&g_watcher_thread, NULL, moderation_watcher, NULL) != 0) {
+        close(g_watcher_stop_fd);
+        g_watcher_stop_fd = -1;
+        return -1;
     }
+    return 0;
 }
 
-char* strcasestr(const char* haystack, const char* needle) {
-    if (!*needle) return (char*)haystack;
-    for (; *haystack; haystack++) {
-        if (tolower((unsigned char)*haystack) == tolower((unsigned char)*needle)) {
-            const char *h, *n;
-            for (h = haystack, n = needle; *h && *n; h++, n++) {
-                if (tolower((unsigned char)*h) != tolower((unsigned char)*n)) {
-                    break;
-                }
-            }
-            if (!*n) {
-                return (char*)haystack;
+static void stop_moderation_watcher(void) {
+    if (g_watcher_stop_fd < 0) return;
+    uint64_t one = 1;
+    (void)!write(g_watcher_stop_fd, &one, sizeof(one));
+    pthread_join(g_watcher_thread, NULL);
+    close(g_watcher_stop_fd);
+    g_watcher_stop_fd = -1;
+}
+
+// --- Listener de administração ---
+
+// Cada conexão recebe uma fotografia das métricas em texto e é fechada
+// (ex.: "nc 127.0.0.1 9000")
+static void* admin_thread(void* arg) {
+    (void)arg;
+    struct pollfd fds[2] = {
+        { .fd = g_admin_stop_fd, .events = POLLIN },
+        { .fd = g_admin_socket, .events = POLLIN },
+    };
+    char text[METRICS_TEXT_MAX];
+
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[0].revents) break;
+        if (!(fds[1].revents & POLLIN)) continue;
+
+        int fd = accept(g_admin_socket, NULL, NULL);
+        if (fd < 0) continue;
+        // Um leitor parado não pode segurar o listener
+        struct timeval timeout = { 1, 0 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        size_t len = metrics_snapshot(text, sizeof(text));
+        for (size_t off = 0; off < len; ) {
+            ssize_t n = send(fd, text + off, len - off, MSG_NOSIGNAL);
+            if (n <= 0) break;
+            off += (size_t)n;
+        }
+        close(fd);
+    }
+    return NULL;
+}
+
+// Escuta apenas na interface local: as métricas não passam pela porta do chat
+static int start_admin_listener(int port) {
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+
+    g_admin_socket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (g_admin_socket < 0) return -1;
+    int reuse = 1;
+    setsockopt(g_admin_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (bind(g_admin_socket, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(g_admin_socket, 16) < 0) {
+        close(g_admin_socket);
+        g_admin_socket = -1;
+        return -1;
+    }
+    g_admin_stop_fd = eventfd(0, EFD_CLOEXEC);
+    if (g_admin_stop_fd < 0 || pthread_create(&g_admin_thread, NULL, admin_thread, NULL) != 0) {
+        if (g_admin_stop_fd >= 0) close(g_admin_stop_fd);
+        close(g_admin_socket);
+        g_admin_stop_fd = g_admin_socket = -1;
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_admin_listener(void) {
+    if (g_admin_stop_fd < 0) return;
+    uint64_t one = 1;
+    (void)!write(g_admin_stop_fd, &one, sizeof(one));
+    pthread_join(g_admin_thread, NULL);
+    close(g_admin_stop_fd);
+    close(g_admin_socket);
+    g_admin_stop_fd = g_admin_socket = -1;
+}
+
+// --- Console do servidor ---
+
+// Lê comandos do terminal em que o servidor roda: "log" mostra os níveis
+// do log e "log <níveis>" os altera, no mesmo formato de --log-level;
+// "stats" mostra as métricas
+static void* console_thread(void* arg) {
+    (void)arg;
+    char line[256];
+    while (fgets(line, sizeof(line), stdin)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (strcmp(line, "stats") == 0) {
+            char text[METRICS_TEXT_MAX];
+            metrics_snapshot(text, sizeof(text));
+            fputs(text, stdout);
+        } else if (strncmp(line, "log", 3) == 0 && (line[3] == '\0' || line[3] == ' ')) {
+            const char* spec = line + 3 + strspn(line + 3, " ");
+            if (*spec && logger_set_levels(spec) < 0) {
+                printf("Níveis inválidos: %s\n", spec);
             }
+            char levels[256];
+            logger_format_levels(levels, sizeof(levels));
+            printf("Níveis do log: %s\n", levels);
+        } else if (line[0]) {
+            printf("Comando desconhecido. Use: log [nível | módulo=nível,...] ou stats\n");
         }
+        fflush(stdout);
     }
     return NULL;
 }
 
+// Só há console com o servidor em primeiro plano no terminal; em segundo
+// plano, ler o stdin suspenderia o processo (SIGTTIN)
+static void start_console(void) {
+    if (!isatty(STDIN_FILENO) || tcgetpgrp(STDIN_FILENO) != getpgrp()) return;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, console_thread, NULL) == 0) {
+        pthread_detach(thread);
+    }
+}
+
 /**
  * @brief Procura e censura palavras da lista de moderação em uma mensagem.
  * @param message A string da mensagem a ser filtrada.
  */
 void filter_message(char* message) {
-    for (int i = 0; i < num_moderator_words; i++) {
-        char* word_to_find = moderator_words[i];
-        size_t word_len = strlen(word_to_find);
-        char* found = strcasestr(message, word_to_find);
-        
-        while (found != NULL) {
-            // Encontrou uma palavra, substitui por '*'
-            for (size_t j = 0; j < word_len; j++) {
-                found[j] = '*';
-            }
-            // Procura pela próxima ocorrência da mesma palavra
-            found = strcasestr(found + 1, word_to_find);
-        }
-    }
+    uint64_t start = metrics_now();
+    unsigned token = rcu_read_lock();
+    mod_matcher_censor(atomic_load(&moderator), message);
+    rcu_read_unlock(token);
+    metrics_record(METRIC_FILTER, start);
 }
 
-void send_private_message(const char* message, const char* sender_nickname, const char* target_nickname, int sender_socket) {
-    int target_socket = -1;
+void send_private_message(const char* message, const char* sender_nickname, const char* target_nickname, Conn* sender) {
+    Conn* target = NULL;
     char confirmation_msg[100];
 
-    // Cópia thread-safe dos clientes conectados
-    Client local_clients[MAX_CLIENTS];
-    int local_client_count;
-    pthread_mutex_lock(&clients_mutex);
-    local_client_count = client_count;
-    memcpy(local_clients, clients, sizeof(Client) * client_count);
-    pthread_mutex_unlock(&clients_mutex);
-
-    // Busca o destinatário
-    for (int i = 0; i < local_client_count; i++) {
-        if (strcmp(local_clients[i].nickname, target_nickname) == 0) {
-            target_socket = local_clients[i].socket;
-            break;
+    // Busca o destinatário no índice de nomes (O(1))
+    target = registry_find(target_nickname);
+
+    if (target != NULL) {
+        // Aplica o filtro no texto completo, montado direto no buffer de envio
+        MsgBuf* private_message = msgbuf_printf("[Privado de %s]: %s\n", sender_nickname, message);
+        if (private_message) {
+            filter_message(private_message->data);
+            msgbuf_set_type(private_message, FRAME_PRIVATE);
+            conn_send_buf(target, private_message);
+            metrics_add(METRIC_MSG_PRIVATE, 1);
+
+            if (TSLOG_ENABLED(LOGMOD_CHAT, INFO)) {
+                uint64_t start = metrics_now();
+                LOG_INFOF("Mensagem PRIVADA para %s: %.*s", target_nickname,
+                          (int)private_message->len - 1, private_message->data);
+                metrics_record(METRIC_LOG, start);
+            }
+            msgbuf_unref(private_message);
         }
-    }
-
-    if (target_socket != -1) {
-        char private_message[BUFFER_SIZE];
-        snprintf(private_message, sizeof(private_message), "[Privado de %s]: %s\n", sender_nickname, message);
-
-        char log_msg[BUFFER_SIZE * 2];
-        snprintf(log_msg, sizeof(log_msg), "Mensagem PRIVADA de %s para %s: %s", sender_nickname, target_nickname, message);
-        LOG_INFO(log_msg);
-
-        // Aplica o filtro no texto completo antes de enviar
-        filter_message(private_message);
-
-        write(target_socket, private_message, strlen(private_message));
 
         snprintf(confirmation_msg, sizeof(confirmation_msg), "[SERVER]: Mensagem enviada para %s.\n", target_nickname);
-        write(sender_socket, confirmation_msg, strlen(confirmation_msg));
+        conn_send(sender, confirmation_msg, strlen(confirmation_msg));
     } else {
         snprintf(confirmation_msg, sizeof(confirmation_msg), "[SERVER]: Usuário '%s' não encontrado ou offline.\n", target_nickname);
-        write(sender_socket, confirmation_msg, strlen(confirmation_msg));
+        conn_send(sender, confirmation_msg, strlen(confirmation_msg));
 
-        char log_msg[BUFFER_SIZE];
-        snprintf(log_msg, sizeof(log_msg), "Tentativa de mensagem privada FALHOU: %s tentou enviar para %s (usuário não encontrado)", sender_nickname, target_nickname);
-        LOG_WARN(log_msg);
+        LOG_WARNF("Tentativa de mensagem privada FALHOU: %s tentou enviar para %s (usuário não encontrado)", sender_nickname, target_nickname);
     }
+
+    if (target) conn_unref(target);
 }
 
 void shutdown_handler(int signal) {
@@ -370,33 +970,29 @@ void shutdown_handler(int signal) {
 }
 
 
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Uso: %s <porta>\n", argv[0]);
-        return 1;
-    }
-
-    int port = atoi(argv[1]);
-    if (port <= 0 || port > 65535) {
-        fprintf(stderr, "Porta inválida: %d\n", port);
-        return 1;
-    }
-
-    // Registra o handler para o sinal SIGINT (Ctrl+C)
-    signal(SIGINT, shutdown_handler);
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Uso: %s <porta> [--mode threads|epoll|shards|uring] [--reactors N]\n"
+                    "          [--out-queue N] [--slow-policy drop-oldest|disconnect|skip]\n"
+                    "          [--history N] [--store DIR|none]\n"
+                    "          [--log-file ARQUIVO] [--log-binary ARQUIVO] [--log-rotate-mb N] [--log-rotate-secs N]\n"
+                    "          [--log-keep N] [--log-fsync never|rotate|always] [--log-flush-ms N]\n"
+                    "          [--log-level NÍVEL|MÓDULO=NÍVEL,...]\n"
+                    "          [--log-overflow block|drop-newest|drop-oldest|drop-below=NÍVEL]\n"
+                    "          [--log-thread-buffers N] [--admin-port N]\n"
+                    "Níveis: info, warning, error, off. Módulos: chat, net, moderation, history.\n", prog);
+}
 
+// Modos threads e epoll: um único socket de escuta e o laço de accept()
+// na thread principal.
+static int run_listener(int port, ServerMode mode, long num_reactors) {
     int server_socket, client_socket;
     struct sockaddr_in server_addr, client_addr;
     socklen_t client_len = sizeof(client_addr);
 
-    logger_init();
-    load_moderator_list();
-    LOG_INFO("Iniciando o servidor de chat... (Pressione Ctrl+C para encerrar)");
-
     server_socket = socket(AF_INET, SOCK_STREAM, 0);
     if (server_socket == -1) {
-        LOG_ERROR("Falha ao criar o socket.");
-        return 1;
+        LOG_AT(LOGMOD_NET, ERROR, "Falha ao criar o socket.");
+        return -1;
     }
 
     g_server_socket = server_socket;  // Atribui à variável global
@@ -409,13 +1005,30 @@ int main(int argc, char *argv[]) {
     server_addr.sin_port = htons(port);
 
     if (bind(server_socket, (struct sockaddr*)&server_addr, sizeof(server_addr)) < 0) {
-        LOG_ERROR("Bind falhou.");
+        LOG_AT(LOGMOD_NET, ERROR, "Bind falhou.");
         close(server_socket);
-        return 1;
+        return -1;
     }
 
-    LOG_INFO("Servidor escutando na porta especificada.");
-    listen(server_socket, 5);
+    LOG_AT(LOGMOD_NET, INFO, "Servidor escutando na porta especificada.");
+    listen(server_socket, SOMAXCONN);
+
+    if (mode == MODE_EPOLL) {
+        if (reactor_start((int)num_reactors, 0) < 0) {
+            LOG_AT(LOGMOD_NET, ERROR, "Falha ao iniciar o modo epoll.");
+            close(server_socket);
+            return -1;
+        }
+        LOG_AT(LOGMOD_NET, INFO, "Modo epoll ativo com %ld reactor(s).", num_reactors);
+    } else {
+        g_client_stop_fd = eventfd(0, EFD_CLOEXEC);
+        if (g_client_stop_fd < 0) {
+            LOG_AT(LOGMOD_NET, ERROR, "Falha ao criar o eventfd de encerramento dos clientes.");
+            close(server_socket);
+            return -1;
+        }
+        LOG_AT(LOGMOD_NET, INFO, "Modo threads ativo (uma thread por cliente).");
+    }
     LOG_INFO("Aguardando conexões de clientes...");
 
     while (g_server_running) {
@@ -423,15 +1036,20 @@ int main(int argc, char *argv[]) {
         if (!g_server_running) break;
 
         if (client_socket < 0) {
-            if (g_server_running) LOG_ERROR("Accept falhou.");
+            if (g_server_running) LOG_AT(LOGMOD_NET, ERROR, "Accept falhou.");
             continue;
         }
 
         char client_ip[INET_ADDRSTRLEN];
         inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
-        char log_msg[100];
-        snprintf(log_msg, sizeof(log_msg), "Nova conexão de %s:%d (socket %d)", client_ip, ntohs(client_addr.sin_port), client_socket);
-        LOG_INFO(log_msg);
+        LOG_AT(LOGMOD_NET, INFO, "Nova conexão de %s:%d (socket %d)", client_ip, ntohs(client_addr.sin_port), client_socket);
+
+        if (mode == MODE_EPOLL) {
+            if (reactor_add(client_socket) < 0) {
+                LOG_AT(LOGMOD_NET, ERROR, "Falha ao registrar o cliente no reactor.");
+            }
+            continue;
+        }
 
         pthread_t client_thread;
         int* new_socket_ptr = malloc(sizeof(int));
@@ -441,30 +1059,316 @@ int main(int argc, char *argv[]) {
         pthread_attr_init(&attr);
         pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
 
-        if (pthread_create(&client_thread, &attr, handle_client, (void*)new_socket_ptr) < 0) {
-            LOG_ERROR("Falha ao criar a thread do cliente.");
+        pthread_mutex_lock(&g_client_threads_mutex);
+        g_client_threads++;
+        pthread_mutex_unlock(&g_client_threads_mutex);
+        if (pthread_create(&client_thread, &attr, handle_client, (void*)new_socket_ptr) != 0) {
+            LOG_AT(LOGMOD_NET, ERROR, "Falha ao criar a thread do cliente.");
             free(new_socket_ptr);
             close(client_socket);
+            client_thread_exit();
         }
         pthread_attr_destroy(&attr);
     }
+    return 0;
+}
+
+// Modos shards e io_uring: cada shard/worker aceita em seu próprio socket;
+// a thread principal apenas aguarda o sinal de encerramento.
+static int run_shards(int port, ServerMode mode, long num_shards) {
+    const char* name = (mode == MODE_URING) ? "io_uring" : "shards";
+    int rc = (mode == MODE_URING) ? uring_start((int)num_shards, port)
+                                  : reactor_start((int)num_shards, port);
+    if (rc < 0) {
+        LOG_AT(LOGMOD_NET, ERROR, "Falha ao iniciar o modo %s.", name);
+        return -1;
+    }
+
+    LOG_AT(LOGMOD_NET, INFO, "Modo %s ativo com %ld shard(s) na porta %d.", name, num_shards, port);
+    LOG_INFO("Aguardando conexões de clientes...");
+
+    // O SIGINT pode ser entregue a outra thread (ex.: a do logger), por isso
+    // a flag é verificada periodicamente.
+    while (g_server_running) {
+        sleep(1);
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int port = atoi(argv[1]);
+    if (port <= 0 || port > 65535) {
+        fprintf(stderr, "Porta inválida: %d\n", port);
+        return 1;
+    }
+
+    ServerMode mode = MODE_THREADS;
+    long num_reactors = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_reactors < 1) num_reactors = 1;
+    long out_queue = 1024;
+    OutPolicy out_policy = OUT_DROP_OLDEST;
+    long history_size = HISTORY_SIZE;
+    const char* store_dir = STORE_DIR;
+    const char* log_file = NULL;
+    const char* log_binary = NULL;
+    LogFileOptions log_opts = { 0, 0, LOG_KEEP_FILES, LOG_FSYNC_NEVER };
+    long log_flush_ms = 0;
+    long admin_port = 0;
+
+    logger_name_module(LOGMOD_CHAT, "chat");
+    logger_name_module(LOGMOD_NET, "net");
+    logger_name_module(LOGMOD_MODERATION, "moderation");
+    logger_name_module(LOGMOD_HISTORY, "history");
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--mode") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "threads") == 0) {
+                mode = MODE_THREADS;
+            } else if (strcmp(value, "epoll") == 0) {
+                mode = MODE_EPOLL;
+            } else if (strcmp(value, "shards") == 0) {
+                mode = MODE_SHARDS;
+            } else if (strcmp(value, "uring") == 0) {
+                mode = MODE_URING;
+            } else {
+                fprintf(stderr, "Modo inválido: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--reactors") == 0 && i + 1 < argc) {
+            num_reactors = atol(argv[++i]);
+            if (num_reactors < 1) {
+                fprintf(stderr, "Número de reactors inválido: %ld\n", num_reactors);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--out-queue") == 0 && i + 1 < argc) {
+            out_queue = atol(argv[++i]);
+            if (out_queue < 2) {
+                fprintf(stderr, "Tamanho de fila inválido: %ld\n", out_queue);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--slow-policy") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "drop-oldest") == 0) {
+                out_policy = OUT_DROP_OLDEST;
+            } else if (strcmp(value, "disconnect") == 0) {
+                out_policy = OUT_DISCONNECT;
+            } else if (strcmp(value, "skip") == 0) {
+                out_policy = OUT_SKIP_NOTICE;
+            } else {
+                fprintf(stderr, "Política inválida: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--history") == 0 && i + 1 < argc) {
+            history_size = atol(argv[++i]);
+            if (history_size < 1 || history_size > HISTORY_MAX_SIZE) {
+                fprintf(stderr, "Tamanho de histórico inválido: %ld (1 a %d)\n", history_size, HISTORY_MAX_SIZE);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--store") == 0 && i + 1 < argc) {
+            store_dir = argv[++i];
+        } else if (strcmp(argv[i], "--log-file") == 0 && i + 1 < argc) {
+            log_file = argv[++i];
+        } else if (strcmp(argv[i], "--log-binary") == 0 && i + 1 < argc) {
+            log_binary = argv[++i];
+        } else if (strcmp(argv[i], "--log-rotate-mb") == 0 && i + 1 < argc) {
+            long mb = atol(argv[++i]);
+            if (mb < 1) {
+                fprintf(stderr, "Tamanho de rotação inválido: %ld\n", mb);
+                return 1;
+            }
+            log_opts.rotate_bytes = (size_t)mb * 1024 * 1024;
+        } else if (strcmp(argv[i], "--log-rotate-secs") == 0 && i + 1 < argc) {
+            long secs = atol(argv[++i]);
+            if (secs < 1) {
+                fprintf(stderr, "Intervalo de rotação inválido: %ld\n", secs);
+                return 1;
+            }
+            log_opts.rotate_seconds = (unsigned)secs;
+        } else if (strcmp(argv[i], "--log-keep") == 0 && i + 1 < argc) {
+            long keep = atol(argv[++i]);
+            if (keep < 0 || keep > 1000) {
+                fprintf(stderr, "Número de arquivos de log inválido: %ld\n", keep);
+                return 1;
+            }
+            log_opts.keep = (unsigned)keep;
+        } else if (strcmp(argv[i], "--log-fsync") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "never") == 0) {
+                log_opts.fsync = LOG_FSYNC_NEVER;
+            } else if (strcmp(value, "rotate") == 0) {
+                log_opts.fsync = LOG_FSYNC_ROTATE;
+            } else if (strcmp(value, "always") == 0) {
+                log_opts.fsync = LOG_FSYNC_ALWAYS;
+            } else {
+                fprintf(stderr, "Política de fsync inválida: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-level") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (logger_set_levels(value) < 0) {
+                fprintf(stderr, "Níveis de log inválidos: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-overflow") == 0 && i + 1 < argc) {
+            const char* value = argv[++i];
+            if (strcmp(value, "block") == 0) {
+                logger_set_overflow(LOG_OVERFLOW_BLOCK, INFO);
+            } else if (strcmp(value, "drop-newest") == 0) {
+                logger_set_overflow(LOG_OVERFLOW_DROP_NEWEST, INFO);
+            } else if (strcmp(value, "drop-oldest") == 0) {
+                logger_set_overflow(LOG_OVERFLOW_DROP_OLDEST, INFO);
+            } else if (strcmp(value, "drop-below=warning") == 0) {
+                logger_set_overflow(LOG_OVERFLOW_DROP_BELOW, WARNING);
+            } else if (strcmp(value, "drop-below=error") == 0) {
+                logger_set_overflow(LOG_OVERFLOW_DROP_BELOW, ERROR);
+            } else {
+                fprintf(stderr, "Política de fila do log inválida: %s\n", value);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-thread-buffers") == 0 && i + 1 < argc) {
+            long slots = atol(argv[++i]);
+            if (slots < 0 || slots > 65536 || logger_set_thread_buffers((size_t)slots) < 0) {
+                fprintf(stderr, "Tamanho de fila por thread inválido: %ld (0 ou potência de 2)\n", slots);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--admin-port") == 0 && i + 1 < argc) {
+            admin_port = atol(argv[++i]);
+            if (admin_port < 1 || admin_port > 65535 || admin_port == port) {
+                fprintf(stderr, "Porta de administração inválida: %ld\n", admin_port);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--log-flush-ms") == 0 && i + 1 < argc) {
+            log_flush_ms = atol(argv[++i]);
+            if (log_flush_ms < 0 || log_flush_ms > 60000) {
+                fprintf(stderr, "Intervalo de flush inválido: %ld\n", log_flush_ms);
+                return 1;
+            }
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    conn_set_out_policy(out_policy, (size_t)out_queue);
+    if (strcmp(store_dir, "none") == 0) store_dir = NULL;
+    if (rooms_init((size_t)history_size, store_dir) < 0) {
+        fprintf(stderr, "Falha ao criar a sala padrão (log persistente em %s): %s\n",
+                store_dir ? store_dir : "-", strerror(errno));
+        return 1;
+    }
+
+    // Registra o handler para o sinal SIGINT (Ctrl+C)
+    signal(SIGINT, shutdown_handler);
+
+    // O SIGHUP fica bloqueado em todas as threads (que herdam esta máscara)
+    // e é consumido pela thread de recarga da moderação via signalfd.
+    sigset_t hup;
+    sigemptyset(&hup);
+    sigaddset(&hup, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &hup, NULL);
+
+    if (log_file && logger_add_file_sink(log_file, &log_opts) < 0) {
+        fprintf(stderr, "Falha ao abrir o arquivo de log %s: %s\n", log_file, strerror(errno));
+        return 1;
+    }
+    LogBinaryOptions bin_opts = { log_opts.rotate_bytes, log_opts.keep, log_opts.fsync };
+    if (log_binary && logger_add_binary_sink(log_binary, &bin_opts) < 0) {
+        fprintf(stderr, "Falha ao abrir o log binário %s: %s\n", log_binary, strerror(errno));
+        return 1;
+    }
+    logger_set_flush_interval((unsigned)log_flush_ms);
+    logger_init();
+    metrics_init();
+    load_moderator_list();
+    if (start_moderation_watcher() < 0) {
+        LOG_AT(LOGMOD_MODERATION, WARNING, "Falha ao iniciar a recarga automática da lista de moderação.");
+    }
+    LOG_INFO("Iniciando o servidor de chat... (Pressione Ctrl+C para encerrar)");
+    if (admin_port > 0) {
+        if (start_admin_listener((int)admin_port) < 0) {
+            LOG_AT(LOGMOD_NET, ERROR, "Falha ao abrir a porta de administração %ld.", admin_port);
+            stop_moderation_watcher();
+            logger_destroy();
+            return 1;
+        }
+        LOG_AT(LOGMOD_NET, INFO, "Métricas disponíveis em 127.0.0.1:%ld.", admin_port);
+    }
+    start_console();
+
+    if (mode == MODE_URING && !uring_supported()) {
+        LOG_AT(LOGMOD_NET, WARNING, "io_uring indisponível (kernel sem suporte ou desativado na compilação). Usando o modo shards.");
+        mode = MODE_SHARDS;
+    }
+
+    if (mode == MODE_SHARDS || mode == MODE_URING) {
+        if (run_shards(port, mode, num_reactors) < 0) {
+            stop_admin_listener();
+            stop_moderation_watcher();
+            logger_destroy();
+            return 1;
+        }
+    } else if (run_listener(port, mode, num_reactors) < 0) {
+        stop_admin_listener();
+        stop_moderation_watcher();
+        logger_destroy();
+        return 1;
+    }
 
     LOG_INFO("Servidor: notificando todos os clientes sobre o encerramento...");
 
     const char* shutdown_msg = "[SERVER]: O servidor foi encerrado. Você será desconectado.\n";
-    broadcast_message(shutdown_msg, -1);
+    broadcast_message(shutdown_msg, NULL);
     sleep(1);
 
-    // Fecha todos os sockets de cliente restantes
-    pthread_mutex_lock(&clients_mutex);
-    for (int i = 0; i < client_count; i++) {
-        close(clients[i].socket);
+    // Encerra todos os sockets de cliente restantes; cada conexão fecha o
+    // descritor ao liberar sua última referência.
+    ClientSnapshot* snap = registry_acquire();
+    for (size_t i = 0; snap && i < snap->count; i++) {
+        shutdown(snap->conns[i]->fd, SHUT_RDWR);
+    }
+    registry_release(snap);
+
+    // Depois disso nenhuma thread de atendimento usa salas ou filtro
+    int drained = 1;
+    if (mode == MODE_URING) {
+        uring_stop();
+    } else if (mode != MODE_THREADS) {
+        reactor_stop();
+    } else if (stop_client_threads(CLIENT_DRAIN_MS) < 0) {
+        LOG_AT(LOGMOD_NET, WARNING, "Threads de cliente ainda ativas após %d ms; salas e filtro não serão liberados.",
+               CLIENT_DRAIN_MS);
+        drained = 0;
+    }
+
+    if (g_server_socket >= 0) {
+        close(g_server_socket);
+    }
+    stop_admin_listener();
+    stop_moderation_watcher();
+    if (drained) {
+        // Como na recarga: troca, espera os leitores em andamento e libera
+        ModMatcher* old = atomic_exchange(&moderator, NULL);
+        rcu_synchronize();
+        mod_matcher_free(old);
+        rooms_shutdown();
     }
-    client_count = 0;
-    pthread_mutex_unlock(&clients_mutex);
 
-    close(server_socket);
-    logger_destroy();
+    ConnOutStats out_stats;
+    conn_out_stats(&out_stats);
+    LOG_INFOF("Clientes lentos: %llu mensagens antigas descartadas, %llu desconexões, %llu ignoradas, %llu avisos.",
+              out_stats.dropped_oldest, out_stats.disconnects, out_stats.skipped, out_stats.notices);
+    LogStats log_stats;
+    logger_stats(&log_stats);
+    LOG_INFOF("Log: %llu mensagens gravadas, %llu descartadas, %llu esperas por fila cheia, pico da fila %zu/%zu.",
+              log_stats.written, log_stats.dropped, log_stats.blocked,
+              log_stats.high_water, log_stats.capacity);
+    logger_destroy_timeout(LOG_DRAIN_MS);
     printf("\nServidor finalizado com sucesso.\n");
     return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -0,0 +1,755 @@
+#define _GNU_SOURCE // pthread_setaffinity_np
+#define TSLOG_MODULE LOGMOD_NET
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "libtslog/tslog.h"
+#include "server/conn.h"
+#include "server/metrics.h"
+#include "server/uring.h"
+
+#if !defined(CHAT_NO_IO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#endif
+#endif
+
+#ifdef HAVE_IO_URING
+
+#include <linux/io_uring.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define RING_ENTRIES 4096
+#define RECV_BUFFERS 1024 // Potência de 2
+#define RECV_BUFFER_GROUP 0
+#define SEND_IOV_MAX 256 // Mensagens reunidas em um único sendmsg
+#define RECV_BATCH 4 // Leituras tratadas entre duas submissões de envios
+
+// Tipos de operação codificados nos bits baixos de user_data
+enum { TAG_RECV = 0, TAG_SEND = 1, TAG_ACCEPT = 2, TAG_WAKE = 3, TAG_MASK = 3 };
+
+// --- Acesso mínimo ao io_uring via syscalls (sem liburing) ---
+
+typedef struct {
+    int fd;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sqe_tail; // Próxima SQE livre (ainda não publicada)
+    struct io_uring_sqe* sqes;
+
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+
+    void* sq_ptr;
+    size_t sq_size;
+    void* cq_ptr;
+    size_t cq_size;
+    size_t sqes_size;
+} Ring;
+
+static int sys_io_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0);
+}
+
+static int sys_io_uring_register(int fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, nr_args);
+}
+
+static void ring_destroy(Ring* ring) {
+    if (ring->sqes) munmap(ring->sqes, ring->sqes_size);
+    if (ring->cq_ptr && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    if (ring->sq_ptr) munmap(ring->sq_ptr, ring->sq_size);
+    if (ring->fd >= 0) close(ring->fd);
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = -1;
+}
+
+static int ring_init(Ring* ring, unsigned entries) {
+    struct io_uring_params p;
+    memset(ring, 0, sizeof(*ring));
+    memset(&p, 0, sizeof(p));
+    // CQ maior que a SQ: recv/accept multishot geram várias conclusões por SQE
+    p.flags = IORING_SETUP_CQSIZE;
+    p.cq_entries = entries * 4;
+
+    ring->fd = sys_io_uring_setup(entries, &p);
+    if (ring->fd < 0) return -1;
+
+    ring->sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_size > ring->sq_size) ring->sq_size = ring->cq_size;
+        ring->cq_size = ring->sq_size;
+    }
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring->fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ptr == MAP_FAILED) {
+        ring->sq_ptr = NULL;
+        ring_destroy(ring);
+        return -1;
+    }
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cq_ptr = ring->sq_ptr;
+    } else {
+        ring->cq_ptr = mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ptr == MAP_FAILED) {
+            ring->cq_ptr = NULL;
+            ring_destroy(ring);
+            return -1;
+        }
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        ring_destroy(ring);
+        return -1;
+    }
+
+    char* sq = (char*)ring->sq_ptr;
+    char* cq = (char*)ring->cq_ptr;
+    ring->sq_head = (unsigned*)(sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    ring->sq_mask = *(unsigned*)(sq + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->sqe_tail = *ring->sq_tail;
+
+    // Mapeamento identidade entre posições do anel e SQEs
+    unsigned* array = (unsigned*)(sq + p.sq_off.array);
+    for (unsigned i = 0; i < p.sq_entries; i++) array[i] = i;
+
+    ring->cq_head = (unsigned*)(cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    ring->cq_mask = *(unsigned*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return 0;
+}
+
+// Publica as SQEs preparadas e, se wait_nr > 0, aguarda conclusões
+static int ring_submit(Ring* ring, unsigned wait_nr) {
+    unsigned to_submit = ring->sqe_tail - *ring->sq_tail;
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+
+    for (;;) {
+        int rc = sys_io_uring_enter(ring->fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0);
+        if (rc >= 0 || errno != EINTR) return rc;
+    }
+}
+
+// Indica se há uma SQE livre; com a SQ cheia, submete o lote atual antes
+static int ring_has_sqe(Ring* ring) {
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head < ring->sq_entries) return 1;
+    ring_submit(ring, 0);
+    head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    return ring->sqe_tail - head < ring->sq_entries;
+}
+
+static struct io_uring_sqe* ring_get_sqe(Ring* ring) {
+    if (!ring_has_sqe(ring)) return NULL;
+    struct io_uring_sqe* sqe = &ring->sqes[ring->sqe_tail & ring->sq_mask];
+    ring->sqe_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    return sqe;
+}
+
+// --- Anel de buffers fornecidos para recv multishot ---
+
+typedef struct {
+    struct io_uring_buf_ring* ring;
+    size_t ring_size;
+    char* pool;
+    unsigned entries;
+    uint16_t tail;
+} BufRing;
+
+static void bufring_put(BufRing* br, uint16_t bid) {
+    struct io_uring_buf* buf = &br->ring->bufs[br->tail & (br->entries - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(br->pool + (size_t)bid * BUFFER_SIZE);
+    buf->len = BUFFER_SIZE;
+    buf->bid = bid;
+    br->tail++;
+}
+
+static void bufring_publish(BufRing* br) {
+    __atomic_store_n(&br->ring->tail, br->tail, __ATOMIC_RELEASE);
+}
+
+static void bufring_destroy(BufRing* br) {
+    if (br->ring) munmap(br->ring, br->ring_size);
+    free(br->pool);
+    memset(br, 0, sizeof(*br));
+}
+
+static int bufring_init(BufRing* br, Ring* ring, unsigned entries) {
+    memset(br, 0, sizeof(*br));
+    br->entries = entries;
+    br->ring_size = entries * sizeof(struct io_uring_buf);
+    br->ring = mmap(NULL, br->ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (br->ring == MAP_FAILED) {
+        br->ring = NULL;
+        return -1;
+    }
+    br->pool = (char*)malloc((size_t)entries * BUFFER_SIZE);
+    if (!br->pool) {
+        bufring_destroy(br);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)br->ring;
+    reg.ring_entries = entries;
+    reg.bgid = RECV_BUFFER_GROUP;
+    if (sys_io_uring_register(ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        bufring_destroy(br);
+        return -1;
+    }
+
+    for (unsigned i = 0; i < entries; i++) bufring_put(br, (uint16_t)i);
+    bufring_publish(br);
+    return 0;
+}
+
+static void prep_recv_multishot(struct io_uring_sqe* sqe, int fd, uint64_t user_data) {
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = user_data;
+}
+
+// --- Workers ---
+
+typedef struct {
+    int index;
+    Ring ring;
+    BufRing bufs;
+    int listen_fd;
+    int wake_fd;
+    uint64_t wake_value;
+    pthread_t thread;
+
+    // Conexões deste worker com saída pendente (vindas de qualquer thread)
+    MpscQueue flush_queue;
+    atomic_int wake_pending;
+
+    // Envios adiados por falta de SQE ou de memória, tentados de novo na
+    // próxima volta do laço. Encadeados por flush_node, livre enquanto a
+    // conexão não está na flush_queue (flush_scheduled continua ativo).
+    MpscNode* retry;
+    size_t sends_inflight;
+
+    // Conclusões de recv ainda não tratadas (fila circular crescente)
+    struct io_uring_cqe* backlog;
+    size_t backlog_head;
+    size_t backlog_count;
+    size_t backlog_cap;
+} UringWorker;
+
+// Envio em andamento: as mensagens referenciadas ficam fixadas na fila da
+// conexão até a conclusão
+typedef struct {
+    Conn* conn;
+    struct msghdr msg;
+    struct iovec iov[SEND_IOV_MAX];
+} UringSend;
+
+static UringWorker* g_workers = NULL;
+static int g_num_workers = 0;
+static atomic_int g_uring_running;
+static _Thread_local UringWorker* tl_worker = NULL;
+
+static uint64_t make_user_data(void* ptr, unsigned tag) {
+    return (uint64_t)(uintptr_t)ptr | tag;
+}
+
+static void uring_wake(UringWorker* w) {
+    uint64_t one = 1;
+    (void)!write(w->wake_fd, &one, sizeof(one));
+}
+
+// Chamado por conn_send (com out_mutex) na primeira escrita pendente
+static void uring_flush_hook(Conn* c) {
+    UringWorker* w = (UringWorker*)c->owner;
+    conn_ref(c);
+    mpsc_push(&w->flush_queue, &c->flush_node);
+    if (tl_worker != w && atomic_exchange(&w->wake_pending, 1) == 0) {
+        uring_wake(w);
+    }
+}
+
+static void arm_accept(UringWorker* w) {
+    struct io_uring_sqe* sqe = ring_get_sqe(&w->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = w->listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_CLOEXEC | SOCK_NONBLOCK; // conn_send pode enviar direto de outras threads
+    sqe->user_data = make_user_data(w, TAG_ACCEPT);
+}
+
+static void arm_wake(UringWorker* w) {
+    struct io_uring_sqe* sqe = ring_get_sqe(&w->ring);
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = w->wake_fd;
+    sqe->addr = (uint64_t)(uintptr_t)&w->wake_value;
+    sqe->len = sizeof(w->wake_value);
+    sqe->user_data = make_user_data(w, TAG_WAKE);
+}
+
+static int arm_recv(UringWorker* w, Conn* c) {
+    struct io_uring_sqe* sqe = ring_get_sqe(&w->ring);
+    if (!sqe) return -1;
+    prep_recv_multishot(sqe, c->fd, make_user_data(c, TAG_RECV));
+    return 0;
+}
+
+// Encerra um envio sem sucesso; o fim do recv multishot conduz o
+// desligamento normal da conexão.
+static void abort_send(UringSend* op) {
+    Conn* c = op->conn;
+    c->send_inflight = 0;
+    conn_consume_output(c, 0);
+    shutdown(c->fd, SHUT_RDWR);
+    free(op);
+    conn_unref(c);
+}
+
+// Adia o envio: a conexão continua agendada (nenhum flush_hook novo) e a
+// lista guarda uma referência até a próxima tentativa
+static void defer_send(UringWorker* w, Conn* c) {
+    conn_ref(c);
+    atomic_store_explicit(&c->flush_node.next, w->retry, memory_order_relaxed);
+    w->retry = &c->flush_node;
+}
+
+// Inicia o envio de tudo o que estiver pendente na conexão: várias
+// mensagens da fila em um único sendmsg. Sem SQE livre (fan-out para
+// milhares de conexões) ou sem memória, o envio é adiado, não abortado.
+static void start_send(UringWorker* w, Conn* c) {
+    UringSend* op = (UringSend*)malloc(sizeof(UringSend));
+    if (!op || !ring_has_sqe(&w->ring)) {
+        free(op);
+        defer_send(w, c);
+        return;
+    }
+
+    size_t n = conn_peek_output(c, op->iov, SEND_IOV_MAX);
+    if (n == 0) {
+        free(op);
+        return;
+    }
+    memset(&op->msg, 0, sizeof(op->msg));
+    op->msg.msg_iov = op->iov;
+    op->msg.msg_iovlen = n;
+    op->conn = c;
+    c->send_inflight = 1;
+    conn_ref(c);
+    w->sends_inflight++;
+
+    struct io_uring_sqe* sqe = ring_get_sqe(&w->ring); // Garantida por ring_has_sqe
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = c->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&op->msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = make_user_data(op, TAG_SEND);
+}
+
+static void drain_flush_queue(UringWorker* w) {
+    atomic_store(&w->wake_pending, 0);
+
+    // Primeiro os adiados, na ordem em que foram adiados; os que falharem
+    // de novo voltam para uma lista nova
+    MpscNode* retry = NULL;
+    while (w->retry) {
+        MpscNode* node = w->retry;
+        w->retry = atomic_load_explicit(&node->next, memory_order_relaxed);
+        atomic_store_explicit(&node->next, retry, memory_order_relaxed);
+        retry = node;
+    }
+    while (retry) {
+        Conn* c = (Conn*)((char*)retry - offsetof(Conn, flush_node));
+        retry = atomic_load_explicit(&retry->next, memory_order_relaxed);
+        start_send(w, c);
+        conn_unref(c);
+    }
+
+    MpscNode* node;
+    while ((node = mpsc_pop(&w->flush_queue)) != NULL) {
+        Conn* c = (Conn*)((char*)node - offsetof(Conn, flush_node));
+        // Com um envio em andamento, a conclusão dele recolhe o restante
+        if (!c->send_inflight) start_send(w, c);
+        conn_unref(c);
+    }
+}
+
+static void handle_send(UringWorker* w, UringSend* op, int res) {
+    Conn* c = op->conn;
+    w->sends_inflight--;
+
+    if (res < 0) {
+        if (res != -EPIPE && res != -ECONNRESET) {
+            LOG_ERROR("Falha ao enviar mensagem (io_uring).");
+        }
+        abort_send(op);
+        return;
+    }
+
+    // Envio parcial ou não, o próximo sendmsg continua do ponto em que
+    // parou e inclui o que chegou enquanto este estava em voo.
+    c->send_inflight = 0;
+    conn_consume_output(c, (size_t)res);
+    free(op);
+    start_send(w, c);
+    conn_unref(c);
+}
+
+static void close_conn(Conn* c) {
+    chat_on_disconnect(c);
+    conn_unref(c); // Referência do worker (mantida pelo recv multishot)
+}
+
+static void feed_input(Conn* c, const char* data, size_t len) {
+    while (len > 0 && c->state != CONN_CLOSED) {
+        size_t space = sizeof(c->in_buf) - 1 - c->in_len;
+        size_t n = len < space ? len : space;
+        memcpy(c->in_buf + c->in_len, data, n);
+        c->in_len += n;
+        data += n;
+        len -= n;
+        chat_process_input(c);
+    }
+}
+
+static void handle_recv(UringWorker* w, Conn* c, struct io_uring_cqe* cqe) {
+    int res = cqe->res;
+
+    if (cqe->flags & IORING_CQE_F_BUFFER) {
+        uint16_t bid = (uint16_t)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+        if (res > 0) {
+            metrics_add(METRIC_BYTES_IN, (uint64_t)res);
+            feed_input(c, w->bufs.pool + (size_t)bid * BUFFER_SIZE, (size_t)res);
+        }
+        bufring_put(&w->bufs, bid);
+        bufring_publish(&w->bufs);
+    }
+
+    if (cqe->flags & IORING_CQE_F_MORE) return; // O recv multishot continua ativo
+
+    // O recv terminou: reativa se ainda faz sentido, senão encerra a conexão
+    if ((res > 0 || res == -ENOBUFS) && c->state != CONN_CLOSED && arm_recv(w, c) == 0) {
+        return;
+    }
+    close_conn(c);
+}
+
+static void handle_accept(UringWorker* w, struct io_uring_cqe* cqe) {
+    int res = cqe->res;
+
+    if (!(cqe->flags & IORING_CQE_F_MORE) && atomic_load(&g_uring_running)) {
+        arm_accept(w);
+    }
+    if (res < 0) {
+        if (res != -ECANCELED && atomic_load(&g_uring_running)) LOG_ERROR("Accept falhou.");
+        return;
+    }
+
+    struct sockaddr_in client_addr;
+    socklen_t client_len = sizeof(client_addr);
+    char client_ip[INET_ADDRSTRLEN] = "?";
+    int client_port = 0;
+    if (getpeername(res, (struct sockaddr*)&client_addr, &client_len) == 0) {
+        inet_ntop(AF_INET, &client_addr.sin_addr, client_ip, INET_ADDRSTRLEN);
+        client_port = ntohs(client_addr.sin_port);
+    }
+    LOG_INFOF("Nova conexão de %s:%d (socket %d, io_uring %d)",
+              client_ip, client_port, res, w->index);
+
+    Conn* c = conn_create(res, 1);
+    if (!c) {
+        close(res);
+        return;
+    }
+    c->owner = w;
+    c->flush_hook = uring_flush_hook;
+    if (arm_recv(w, c) < 0) {
+        LOG_ERROR("Falha ao registrar o cliente no io_uring.");
+        conn_unref(c);
+    }
+}
+
+static int backlog_push(UringWorker* w, const struct io_uring_cqe* cqe) {
+    if (w->backlog_count == w->backlog_cap) {
+        size_t new_cap = w->backlog_cap ? w->backlog_cap * 2 : RECV_BUFFERS;
+        struct io_uring_cqe* grown = (struct io_uring_cqe*)malloc(new_cap * sizeof(*grown));
+        if (!grown) return -1;
+        for (size_t i = 0; i < w->backlog_count; i++) {
+            grown[i] = w->backlog[(w->backlog_head + i) % w->backlog_cap];
+        }
+        free(w->backlog);
+        w->backlog = grown;
+        w->backlog_head = 0;
+        w->backlog_cap = new_cap;
+    }
+    w->backlog[(w->backlog_head + w->backlog_count) % w->backlog_cap] = *cqe;
+    w->backlog_count++;
+    return 0;
+}
+
+/*
+ * Esvazia a CQ. Conclusões de envio, accept e wake são tratadas na hora; as
+ * de recv entram no backlog. Como a CQ é FIFO, a conclusão de um envio pode
+ * chegar atrás de centenas de leituras de um cliente que despeja dados: se
+ * as leituras fossem tratadas antes, os broadcasts gerados estourariam a fila
+ * de saída até de clientes rápidos, cujo próximo envio só sairia depois.
+ */
+static void reap_completions(UringWorker* w) {
+    Ring* ring = &w->ring;
+    unsigned head = *ring->cq_head;
+    unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+
+    while (head != tail) {
+        struct io_uring_cqe cqe = ring->cqes[head & ring->cq_mask];
+        head++;
+        // Libera a posição antes de tratar: o tratamento pode submeter e gerar CQEs
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+        void* ptr = (void*)(uintptr_t)(cqe.user_data & ~(uint64_t)TAG_MASK);
+        switch (cqe.user_data & TAG_MASK) {
+            case TAG_RECV:
+                if (backlog_push(w, &cqe) < 0) handle_recv(w, (Conn*)ptr, &cqe);
+                break;
+            case TAG_SEND:   handle_send(w, (UringSend*)ptr, cqe.res); break;
+            case TAG_ACCEPT: handle_accept(w, &cqe); break;
+            case TAG_WAKE:
+                if (atomic_load(&g_uring_running)) arm_wake(w);
+                break;
+        }
+
+        if (head == tail) tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    }
+}
+
+// Trata até max leituras do backlog, na ordem de chegada
+static void process_backlog(UringWorker* w, size_t max) {
+    while (max-- > 0 && w->backlog_count > 0) {
+        struct io_uring_cqe cqe = w->backlog[w->backlog_head];
+        w->backlog_head = (w->backlog_head + 1) % w->backlog_cap;
+        w->backlog_count--;
+        handle_recv(w, (Conn*)(uintptr_t)(cqe.user_data & ~(uint64_t)TAG_MASK), &cqe);
+    }
+}
+
+static void* uring_thread_func(void* arg) {
+    UringWorker* w = (UringWorker*)arg;
+    tl_worker = w;
+
+    arm_wake(w);
+    arm_accept(w);
+
+    while (atomic_load(&g_uring_running)) {
+        // Todos os envios gerados pelo lote anterior saem em um único enter;
+        // só espera por conclusões quando não há leituras acumuladas.
+        // Envios adiados sem nenhum em voo (faltou memória) não têm uma
+        // conclusão que acorde o worker: tenta de novo em 1 ms.
+        drain_flush_queue(w);
+        int stalled = w->retry && w->sends_inflight == 0;
+        if (ring_submit(&w->ring, (w->backlog_count || stalled) ? 0 : 1) < 0) {
+            LOG_ERROR("io_uring_enter falhou.");
+            break;
+        }
+        if (stalled && w->backlog_count == 0) {
+            struct timespec pause = { 0, 1000000 };
+            nanosleep(&pause, NULL);
+        }
+        reap_completions(w);
+        process_backlog(w, RECV_BATCH);
+    }
+    return NULL;
+}
+
+static int open_listener(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(port);
+
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void worker_destroy(UringWorker* w) {
+    while (w->retry) {
+        Conn* c = (Conn*)((char*)w->retry - offsetof(Conn, flush_node));
+        w->retry = atomic_load_explicit(&w->retry->next, memory_order_relaxed);
+        conn_unref(c);
+    }
+    free(w->backlog);
+    bufring_destroy(&w->bufs);
+    ring_destroy(&w->ring);
+    if (w->listen_fd >= 0) close(w->listen_fd);
+    if (w->wake_fd >= 0) close(w->wake_fd);
+}
+
+static int worker_setup(UringWorker* w, int index, int port) {
+    w->index = index;
+    w->listen_fd = -1;
+    w->wake_fd = -1;
+    mpsc_init(&w->flush_queue);
+    atomic_init(&w->wake_pending, 0);
+
+    if (ring_init(&w->ring, RING_ENTRIES) < 0) return -1;
+    if (bufring_init(&w->bufs, &w->ring, RECV_BUFFERS) < 0) return -1;
+    w->wake_fd = eventfd(0, EFD_CLOEXEC);
+    w->listen_fd = open_listener(port);
+    if (w->wake_fd < 0 || w->listen_fd < 0) return -1;
+    return 0;
+}
+
+int uring_supported(void) {
+    Ring ring;
+    BufRing br;
+    int sv[2] = { -1, -1 };
+    int ok = 0;
+
+    if (ring_init(&ring, 8) < 0) return 0;
+    if (bufring_init(&br, &ring, 2) < 0) {
+        ring_destroy(&ring);
+        return 0;
+    }
+
+    // Kernels sem recv multishot rejeitam a SQE; os que o suportam também
+    // suportam accept multishot e anéis de buffers.
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0) {
+        struct io_uring_sqe* sqe = ring_get_sqe(&ring);
+        prep_recv_multishot(sqe, sv[0], 1);
+        if (ring_submit(&ring, 0) >= 0 && write(sv[1], "x", 1) == 1 && ring_submit(&ring, 1) >= 0) {
+            struct io_uring_cqe* cqe = &ring.cqes[*ring.cq_head & ring.cq_mask];
+            ok = cqe->res == 1 && (cqe->flags & IORING_CQE_F_BUFFER) && (cqe->flags & IORING_CQE_F_MORE);
+        }
+        close(sv[0]);
+        close(sv[1]);
+    }
+
+    bufring_destroy(&br);
+    ring_destroy(&ring);
+    return ok;
+}
+
+int uring_start(int num_workers, int listen_port) {
+    if (num_workers < 1) num_workers = 1;
+
+    g_workers = (UringWorker*)calloc((size_t)num_workers, sizeof(UringWorker));
+    if (!g_workers) return -1;
+    atomic_store(&g_uring_running, 1);
+
+    long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_cpus < 1) num_cpus = 1;
+
+    // Os sinais ficam com a thread principal, que trata o SIGINT
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+
+    int rc = 0;
+    for (int i = 0; i < num_workers; i++) {
+        UringWorker* w = &g_workers[i];
+        if (worker_setup(w, i, listen_port) < 0 ||
+            pthread_create(&w->thread, NULL, uring_thread_func, w) != 0) {
+            LOG_ERROR("Falha ao iniciar o worker io_uring.");
+            worker_destroy(w);
+            rc = -1;
+            break;
+        }
+        g_num_workers = i + 1;
+
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(i % num_cpus, &cpus);
+        pthread_setaffinity_np(w->thread, sizeof(cpus), &cpus);
+    }
+
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (rc < 0) uring_stop();
+    return rc;
+}
+
+void uring_stop(void) {
+    if (!g_workers) return;
+
+    atomic_store(&g_uring_running, 0);
+    for (int i = 0; i < g_num_workers; i++) {
+        uring_wake(&g_workers[i]);
+    }
+    for (int i = 0; i < g_num_workers; i++) {
+        pthread_join(g_workers[i].thread, NULL);
+        worker_destroy(&g_workers[i]);
+    }
+
+    free(g_workers);
+    g_workers = NULL;
+    g_num_workers = 0;
+}
+
+#else // !HAVE_IO_URING
+
+int uring_supported(void) {
+    return 0;
+}
+
+int uring_start(int num_workers, int listen_port) {
+    (void)num_workers;
+    (void)listen_port;
+    return -1;
+}
+
+void uring_stop(void) {
+}
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef URING_H
+#define URING_H
+
+/**
+ * @brief Verifica se o kernel suporta o backend io_uring.
+ *
+ * Testa a criação do anel, o registro de um anel de buffers fornecidos e
+ * um recv multishot real em um socketpair. Retorna 0 se o binário foi
+ * compilado sem io_uring (USE_IO_URING=0) ou se algo faltar.
+ */
+int uring_supported(void);
+
+/**
+ * @brief Inicia os workers io_uring.
+ *
+ * Cada worker tem seu próprio anel, seu socket de escuta (SO_REUSEPORT) com
+ * accept multishot e um anel de buffers registrado para recv multishot. Os
+ * envios de todas as conexões são acumulados e submetidos em lote: um
+ * broadcast para milhares de clientes custa poucas chamadas io_uring_enter.
+ * @return 0 em sucesso, -1 em falha.
+ */
+int uring_start(int num_workers, int listen_port);
+
+/**
+ * @brief Sinaliza os workers para encerrarem e aguarda o término.
+ */
+void uring_stop(void);
+
+#endif
@@ -0,0 +1,195 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "server/moderation.h"
+
+/*
+ * Benchmark do filtro de moderação em uma única thread (mensagens/s/núcleo).
+ *
+ * Compara o filtro original (strcasestr para cada palavra), o autômato
+ * Aho-Corasick sem pré-filtro e o autômato com cada implementação do
+ * pré-filtro, com a lista de exemplo (moderador.txt) e com uma lista
+ * sintética grande. O texto imita mensagens de chat já formatadas, com uma
+ * pequena fração contendo palavras proibidas.
+ *
+ * Uso: ./bench_moderation [num_mensagens] [num_palavras_sinteticas]
+ */
+
+#define MAX_MSG 512
+#define MIN_SECONDS 0.5
+
+static const char* vocab[] = {
+    "oi", "olá", "bom", "dia", "boa", "noite", "tarde", "pessoal", "galera", "tudo",
+    "bem", "e", "vocês", "alguém", "viu", "o", "jogo", "ontem", "foi", "muito",
+    "legal", "kkkk", "rs", "haha", "sim", "não", "talvez", "amanhã", "hoje", "vamos",
+    "marcar", "reunião", "às", "10h", "link", "https://exemplo.com/sala", "obrigado",
+    "valeu", "abraço", "quem", "vai", "no", "evento", "sábado", "preciso", "de",
+    "ajuda", "com", "o", "código", "compilou", "aqui", "deu", "erro", "segfault",
+    "na", "linha", "42", "servidor", "caiu", "voltou", "agora", "alguém", "online",
+    ":)", ":D", "!!", "?", "que", "isso", "demais", "top", "show", "beleza",
+};
+
+static const char* nicks[] = {
+    "ana", "bruno", "carla", "diego", "eduarda", "felipe", "gabi", "henrique", "iris", "joao",
+};
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Filtro original do servidor, antes do autômato
+static void legacy_filter(char** words, size_t count, char* message) {
+    for (size_t i = 0; i < count; i++) {
+        size_t word_len = strlen(words[i]);
+        char* found = strcasestr(message, words[i]);
+        while (found != NULL) {
+            memset(found, '*', word_len);
+            found = strcasestr(found + 1, words[i]);
+        }
+    }
+}
+
+static char* random_word(int min_len, int max_len) {
+    static const char* syllables[] = { "ka", "zu", "xo", "qui", "vre", "lon", "tri", "gha", "mup", "rez" };
+    int len = min_len + rand() % (max_len - min_len + 1);
+    char* word = (char*)malloc((size_t)max_len + 4);
+    int n = 0;
+    while (n < len) {
+        const char* s = syllables[rand() % 10];
+        for (; *s && n < len; s++) word[n++] = *s;
+    }
+    word[n] = '\0';
+    return word;
+}
+
+static char** load_words(const char* path, size_t* count) {
+    FILE* file = fopen(path, "r");
+    size_t cap = 16;
+    char** words = (char**)malloc(cap * sizeof(char*));
+    *count = 0;
+
+    if (file) {
+        char line[256];
+        while (fgets(line, sizeof(line), file)) {
+            line[strcspn(line, "\r\n")] = 0;
+            if (line[0] == '#' || line[0] == '\0') continue;
+            if (*count == cap) {
+                cap *= 2;
+                words = (char**)realloc(words, cap * sizeof(char*));
+            }
+            words[(*count)++] = strdup(line);
+        }
+        fclose(file);
+    } else {
+        static const char* fallback[] = { "morango", "banana", "abacaxi", "laranja", "uva" };
+        for (size_t i = 0; i < 5; i++) words[(*count)++] = strdup(fallback[i]);
+    }
+    return words;
+}
+
+// Gera mensagens "[nick]: texto"; cerca de 2% recebem uma palavra da lista
+static char** build_corpus(size_t num_msgs, char** words, size_t num_words) {
+    char** msgs = (char**)malloc(num_msgs * sizeof(char*));
+    size_t num_vocab = sizeof(vocab) / sizeof(vocab[0]);
+
+    for (size_t i = 0; i < num_msgs; i++) {
+        char buf[MAX_MSG];
+        int len = snprintf(buf, sizeof(buf), "[%s]: ", nicks[rand() % 10]);
+        int target = 20 + rand() % 120;
+        int banned_at = (rand() % 50 == 0) ? rand() % 8 : -1;
+
+        for (int w = 0; len < target && len < MAX_MSG - 64; w++) {
+            const char* word = (w == banned_at) ? words[rand() % num_words] : vocab[rand() % num_vocab];
+            len += snprintf(buf + len, sizeof(buf) - (size_t)len, "%s%s", w ? " " : "", word);
+        }
+        msgs[i] = strdup(buf);
+    }
+    return msgs;
+}
+
+typedef struct {
+    const char* name;
+    int legacy;
+    ModScan scan;
+} Engine;
+
+static void run_list(const char* label, char** words, size_t num_words, size_t num_msgs) {
+    char** msgs = build_corpus(num_msgs, words, num_words);
+    size_t bytes = 0;
+    for (size_t i = 0; i < num_msgs; i++) bytes += strlen(msgs[i]);
+
+    ModMatcher* matcher = mod_matcher_build((const char* const*)words, num_words);
+    ModScan best = mod_matcher_scan(matcher);
+
+    static const Engine engines[] = {
+        { "strcasestr (original)", 1, MOD_SCAN_NONE },
+        { "aho-corasick", 0, MOD_SCAN_NONE },
+        { "aho-corasick + escalar", 0, MOD_SCAN_SCALAR },
+        { "aho-corasick + sse2", 0, MOD_SCAN_SSE2 },
+        { "aho-corasick + avx2", 0, MOD_SCAN_AVX2 },
+    };
+
+    printf("\n== %s: %zu palavras, %zu mensagens (%.1f bytes/msg) ==\n",
+           label, num_words, num_msgs, (double)bytes / num_msgs);
+    printf("%-26s %14s %10s\n", "filtro", "msgs/s/núcleo", "censuradas");
+
+    char buf[MAX_MSG];
+    for (size_t e = 0; e < sizeof(engines) / sizeof(engines[0]); e++) {
+        const Engine* eng = &engines[e];
+        if (!eng->legacy && mod_matcher_set_scan(matcher, eng->scan) != 0) {
+            printf("%-26s %14s\n", eng->name, "indisponível");
+            continue;
+        }
+
+        size_t done = 0, censored = 0;
+        double start = now_seconds(), elapsed;
+        do {
+            for (size_t i = 0; i < num_msgs; i++) {
+                strcpy(buf, msgs[i]);
+                if (eng->legacy) {
+                    legacy_filter(words, num_words, buf);
+                    censored += strchr(buf, '*') != NULL;
+                } else {
+                    censored += mod_matcher_censor(matcher, buf) > 0;
+                }
+                done++;
+                // Listas grandes tornam o filtro original muito lento
+                if (eng->legacy && (done & 63) == 0 && now_seconds() - start > MIN_SECONDS) break;
+            }
+            elapsed = now_seconds() - start;
+        } while (elapsed < MIN_SECONDS);
+
+        printf("%-26s %14.0f %9.2f%%%s\n", eng->name, done / elapsed,
+               100.0 * censored / done, (!eng->legacy && eng->scan == best) ? "  (padrão)" : "");
+    }
+
+    mod_matcher_free(matcher);
+    for (size_t i = 0; i < num_msgs; i++) free(msgs[i]);
+    free(msgs);
+}
+
+int main(int argc, char* argv[]) {
+    size_t num_msgs = argc > 1 ? (size_t)strtoul(argv[1], NULL, 10) : 20000;
+    size_t num_synthetic = argc > 2 ? (size_t)strtoul(argv[2], NULL, 10) : 10000;
+    if (num_msgs == 0) num_msgs = 1;
+    if (num_synthetic == 0) num_synthetic = 1;
+    srand(1234);
+
+    size_t num_words;
+    char** words = load_words("moderador.txt", &num_words);
+    run_list("moderador.txt", words, num_words, num_msgs);
+    for (size_t i = 0; i < num_words; i++) free(words[i]);
+    free(words);
+
+    words = (char**)malloc(num_synthetic * sizeof(char*));
+    for (size_t i = 0; i < num_synthetic; i++) words[i] = random_word(5, 10);
+    run_list("lista sintética", words, num_synthetic, num_msgs);
+    for (size_t i = 0; i < num_synthetic; i++) free(words[i]);
+    free(words);
+    return 0;
+}
@@ -0,0 +1,426 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#include "common/hist.h"
+#include "libtslog/tslog.h"
+
+/*
+ * Microbenchmark da libtslog.
+ *
+ * Varre combinações de destino, função (logger_log com texto pronto ou
+ * logger_logf com formatação adiada), número de produtores e tamanho da
+ * mensagem. Cada combinação roda em um processo filho, com o logger
+ * recém-criado, e informa:
+ *   - a latência de cada chamada no produtor (p50, p99, p99.9 e máximo);
+ *   - a vazão sustentada: mensagens / tempo até a última ser entregue aos
+ *     destinos, com a política padrão (o produtor espera a fila);
+ *   - alocações de memória por mensagem (malloc, calloc, realloc e
+ *     alinhadas), contadas no mesmo intervalo;
+ *   - quantas vezes um produtor esperou por espaço na fila.
+ *
+ * Destinos: "null" descarta os lotes já formatados (custo da fila e da
+ * formatação, sem E/S), "devnull" usa o destino de arquivo em /dev/null
+ * (acrescenta as chamadas write), "file" grava um arquivo de verdade e
+ * "binary" usa o destino binário (segmentos mapeados, sem formatação).
+ *
+ * Uso: ./bench_tslog [--messages N] [--producers 1,2,4,8] [--sizes 16,128,512]
+ *          [--sinks null,devnull,file,binary] [--api log,logf]
+ *          [--thread-buffers N] [--dir DIR] [--csv ARQUIVO]
+ */
+
+#define MAX_LIST 16
+#define MAX_SIZE 1000 // Abaixo de TSLOG_LINE_MAX: nada é truncado
+
+// Histograma log-linear de common/hist.h (32 faixas por potência de 2: erro de até ~3%)
+#define HIST_SUB_BITS 5
+#define HIST_MAX_EXP 36
+#define HIST_SLOTS HIST_BUCKETS(HIST_SUB_BITS, HIST_MAX_EXP)
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long max;
+    unsigned long long buckets[HIST_SLOTS];
+} Histogram;
+
+// Resultado de uma combinação, enviado do filho ao pai por um pipe
+typedef struct {
+    int ok;
+    double p50_ns, p99_ns, p999_ns, max_ns;
+    double msgs_per_s;
+    double allocs_per_msg;
+    unsigned long long blocked;
+    unsigned long long dropped;
+} BenchResult;
+
+typedef struct {
+    const char* sink;
+    int use_logf;
+    int producers;
+    int size;
+} BenchCase;
+
+typedef struct {
+    int id;
+    const BenchCase* bc;
+    long count;
+    Histogram hist;
+    pthread_t thread;
+} Producer;
+
+static long g_messages = 200000;
+static size_t g_thread_buffers = 0;
+static const char* g_dir = "/tmp";
+static const char* g_csv = NULL;
+
+static pthread_barrier_t g_barrier;
+static double g_clock_ns; // Custo de uma leitura do relógio, incluído nas latências
+
+// --- Contagem de alocações ---
+// Substitui as funções de alocação da glibc (que encaminham para as
+// originais) e conta as chamadas, de qualquer thread, desde o início.
+
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t n, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void* __libc_memalign(size_t align, size_t size);
+extern void __libc_free(void* ptr);
+
+static atomic_ullong g_allocs;
+
+static inline void count_alloc(void) {
+    atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+}
+
+void* malloc(size_t size) {
+    count_alloc();
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+    count_alloc();
+    return __libc_calloc(n, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    count_alloc();
+    return __libc_realloc(ptr, size);
+}
+
+void* memalign(size_t align, size_t size) {
+    count_alloc();
+    return __libc_memalign(align, size);
+}
+
+void* aligned_alloc(size_t align, size_t size) {
+    count_alloc();
+    return __libc_memalign(align, size);
+}
+
+int posix_memalign(void** out, size_t align, size_t size) {
+    if (align < sizeof(void*) || (align & (align - 1)) != 0) return EINVAL;
+    count_alloc();
+    void* p = __libc_memalign(align, size);
+    if (!p) return ENOMEM;
+    *out = p;
+    return 0;
+}
+
+void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+// --- Medição ---
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static double percentile_ns(const Histogram* h, double q) {
+    return (double)hist_percentile(h->buckets, HIST_SUB_BITS, HIST_MAX_EXP, h->count, h->max, q);
+}
+
+static double measure_clock(void) {
+    uint64_t start = now_ns();
+    for (int i = 0; i < 1000000; i++) now_ns();
+    return (double)(now_ns() - start) / 1e6;
+}
+
+static int null_write(void* ctx, const char* data, size_t len) {
+    (void)ctx;
+    (void)data;
+    (void)len;
+    return 0;
+}
+
+static void* producer_thread(void* arg) {
+    Producer* p = (Producer*)arg;
+    const BenchCase* bc = p->bc;
+
+    // Mensagem do tamanho pedido: texto pronto, ou formato + argumentos que
+    // resultam no mesmo tamanho
+    char text[MAX_SIZE + 1];
+    memset(text, 'x', (size_t)bc->size);
+    text[bc->size] = '\0';
+    int prefix = snprintf(NULL, 0, "m%d t%d: ", 1000000, p->id);
+    const char* tail = text + (bc->size > prefix ? prefix : bc->size);
+
+    pthread_barrier_wait(&g_barrier);
+    for (long i = 0; i < p->count; i++) {
+        uint64_t start = now_ns();
+        if (bc->use_logf) {
+            logger_logf(INFO, "m%d t%d: %s", 1000000 + (int)(i % 1000000), p->id, tail);
+        } else {
+            logger_log(INFO, text);
+        }
+        uint64_t v = now_ns() - start;
+        p->hist.count++;
+        if (v > p->hist.max) p->hist.max = v;
+        p->hist.buckets[hist_bucket_of(v, HIST_SUB_BITS, HIST_MAX_EXP)]++;
+    }
+    return NULL;
+}
+
+static int add_sink(const char* sink, char* path, size_t path_cap) {
+    LogFileOptions file_opts = { 0, 0, 0, LOG_FSYNC_NEVER };
+    path[0] = '\0';
+    if (strcmp(sink, "null") == 0) {
+        LogSink s = { null_write, NULL, NULL, LOG_FORMAT_TEXT };
+        return logger_add_sink(&s);
+    }
+    if (strcmp(sink, "devnull") == 0) return logger_add_file_sink("/dev/null", &file_opts);
+    if (strcmp(sink, "file") == 0) {
+        snprintf(path, path_cap, "%s/bench_tslog.%d.log", g_dir, (int)getpid());
+        return logger_add_file_sink(path, &file_opts);
+    }
+    if (strcmp(sink, "binary") == 0) {
+        LogBinaryOptions bin_opts = { 0, 0, LOG_FSYNC_NEVER };
+        snprintf(path, path_cap, "%s/bench_tslog.%d.bin", g_dir, (int)getpid());
+        return logger_add_binary_sink(path, &bin_opts);
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+// Executa uma combinação (no processo filho)
+static BenchResult run_case(const BenchCase* bc) {
+    BenchResult r = { 0 };
+    char path[512];
+    if (add_sink(bc->sink, path, sizeof(path)) < 0) {
+        fprintf(stderr, "Falha ao abrir o destino %s: %s\n", bc->sink, strerror(errno));
+        return r;
+    }
+    logger_set_thread_buffers(g_thread_buffers);
+    logger_init();
+
+    Producer* producers = (Producer*)calloc((size_t)bc->producers, sizeof(Producer));
+    long total = g_messages - g_messages % bc->producers;
+    pthread_barrier_init(&g_barrier, NULL, (unsigned)bc->producers + 1);
+    for (int i = 0; i < bc->producers; i++) {
+        producers[i].id = i;
+        producers[i].bc = bc;
+        producers[i].count = total / bc->producers;
+        pthread_create(&producers[i].thread, NULL, producer_thread, &producers[i]);
+    }
+
+    pthread_barrier_wait(&g_barrier);
+    unsigned long long allocs_start = atomic_load(&g_allocs);
+    uint64_t start = now_ns();
+    for (int i = 0; i < bc->producers; i++) pthread_join(producers[i].thread, NULL);
+
+    // A vazão sustentada só termina quando os destinos receberam tudo
+    LogStats stats;
+    for (;;) {
+        logger_stats(&stats);
+        if (stats.written + stats.dropped >= (unsigned long long)total) break;
+        struct timespec ts = { 0, 200000 };
+        nanosleep(&ts, NULL);
+    }
+    double elapsed = (double)(now_ns() - start) / 1e9;
+    unsigned long long allocs = atomic_load(&g_allocs) - allocs_start;
+    logger_destroy();
+
+    Histogram all = { 0 };
+    for (int i = 0; i < bc->producers; i++) {
+        const Histogram* h = &producers[i].hist;
+        all.count += h->count;
+        if (h->max > all.max) all.max = h->max;
+        for (unsigned b = 0; b < HIST_SLOTS; b++) all.buckets[b] += h->buckets[b];
+    }
+    free(producers);
+    pthread_barrier_destroy(&g_barrier);
+    if (path[0]) unlink(path);
+
+    r.ok = 1;
+    r.p50_ns = percentile_ns(&all, 0.50);
+    r.p99_ns = percentile_ns(&all, 0.99);
+    r.p999_ns = percentile_ns(&all, 0.999);
+    r.max_ns = (double)all.max;
+    r.msgs_per_s = (double)total / elapsed;
+    r.allocs_per_msg = (double)allocs / (double)total;
+    r.blocked = stats.blocked;
+    r.dropped = stats.dropped;
+    return r;
+}
+
+// Cada combinação em um processo novo: o logger é global e os custos de
+// uma não contaminam a seguinte
+static BenchResult run_isolated(const BenchCase* bc) {
+    BenchResult r = { 0 };
+    int fds[2];
+    if (pipe(fds) < 0) return r;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        BenchResult child = run_case(bc);
+        ssize_t n = write(fds[1], &child, sizeof(child));
+        _exit(n == (ssize_t)sizeof(child) ? 0 : 1);
+    }
+    close(fds[1]);
+    if (pid > 0) {
+        if (read(fds[0], &r, sizeof(r)) != (ssize_t)sizeof(r)) r.ok = 0;
+        waitpid(pid, NULL, 0);
+    }
+    close(fds[0]);
+    return r;
+}
+
+// --- Linha de comando ---
+
+static int parse_ints(const char* arg, int* out, int min, int max) {
+    int n = 0;
+    char* end;
+    while (*arg && n < MAX_LIST) {
+        long v = strtol(arg, &end, 10);
+        if (end == arg || v < min || v > max) return -1;
+        out[n++] = (int)v;
+        arg = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',') return -1;
+    }
+    return n;
+}
+
+static int parse_names(char* arg, const char** out) {
+    int n = 0;
+    for (char* tok = strtok(arg, ","); tok && n < MAX_LIST; tok = strtok(NULL, ",")) out[n++] = tok;
+    return n;
+}
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [--messages N] [--producers 1,2,4,8] [--sizes 16,128,512]\n"
+                    "          [--sinks null,devnull,file,binary] [--api log,logf]\n"
+                    "          [--thread-buffers N] [--dir DIR] [--csv ARQUIVO]\n", prog);
+}
+
+int main(int argc, char* argv[]) {
+    int producers[MAX_LIST] = { 1, 2, 4, 8 }, num_producers = 4;
+    int sizes[MAX_LIST] = { 16, 128, 512 }, num_sizes = 3;
+    const char* sinks[MAX_LIST] = { "null", "devnull", "file", "binary" };
+    int num_sinks = 4;
+    const char* apis[MAX_LIST] = { "log", "logf" };
+    int num_apis = 2;
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        const char* opt = argv[i++];
+        char* value = argv[i];
+        int ok = 1;
+        if (strcmp(opt, "--messages") == 0) {
+            g_messages = atol(value);
+            ok = g_messages >= 1000;
+        } else if (strcmp(opt, "--producers") == 0) {
+            ok = (num_producers = parse_ints(value, producers, 1, 256)) > 0;
+        } else if (strcmp(opt, "--sizes") == 0) {
+            ok = (num_sizes = parse_ints(value, sizes, 1, MAX_SIZE)) > 0;
+        } else if (strcmp(opt, "--sinks") == 0) {
+            ok = (num_sinks = parse_names(value, sinks)) > 0;
+        } else if (strcmp(opt, "--api") == 0) {
+            ok = (num_apis = parse_names(value, apis)) > 0;
+            for (int k = 0; ok && k < num_apis; k++) {
+                ok = strcmp(apis[k], "log") == 0 || strcmp(apis[k], "logf") == 0;
+            }
+        } else if (strcmp(opt, "--thread-buffers") == 0) {
+            long slots = atol(value);
+            ok = slots >= 0 && (slots & (slots - 1)) == 0;
+            g_thread_buffers = (size_t)slots;
+        } else if (strcmp(opt, "--dir") == 0) {
+            g_dir = value;
+        } else if (strcmp(opt, "--csv") == 0) {
+            g_csv = value;
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            fprintf(stderr, "Valor inválido para %s: %s\n", opt, value);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE* csv = NULL;
+    if (g_csv) {
+        struct stat st;
+        int fresh = stat(g_csv, &st) < 0 || st.st_size == 0;
+        csv = fopen(g_csv, "a");
+        if (!csv) {
+            fprintf(stderr, "Falha ao abrir %s: %s\n", g_csv, strerror(errno));
+            return 1;
+        }
+        if (fresh) {
+            fprintf(csv, "sink,api,producers,size,messages,thread_buffers,p50_ns,p99_ns,p999_ns,max_ns,"
+                         "msgs_per_s,allocs_per_msg,blocked,dropped\n");
+        }
+    }
+
+    g_clock_ns = measure_clock();
+    printf("bench_tslog: %ld mensagens por combinação, %s, %ld núcleo(s); "
+           "latências incluem uma leitura do relógio (%.1f ns)\n",
+           g_messages, g_thread_buffers ? "filas por thread" : "fila compartilhada",
+           sysconf(_SC_NPROCESSORS_ONLN), g_clock_ns);
+    printf("%-8s %-5s %5s %6s %9s %9s %9s %10s %12s %10s %9s\n", "destino", "api", "prod", "bytes",
+           "p50 ns", "p99 ns", "p99.9 ns", "máx ns", "msgs/s", "aloc/msg", "esperas");
+
+    int failed = 0;
+    for (int s = 0; s < num_sinks; s++) {
+        for (int a = 0; a < num_apis; a++) {
+            for (int p = 0; p < num_producers; p++) {
+                for (int z = 0; z < num_sizes; z++) {
+                    BenchCase bc = { sinks[s], strcmp(apis[a], "logf") == 0, producers[p], sizes[z] };
+                    BenchResult r = run_isolated(&bc);
+                    if (!r.ok) {
+                        printf("%-8s %-5s %5d %6d   falhou\n", bc.sink, apis[a], bc.producers, bc.size);
+                        failed = 1;
+                        continue;
+                    }
+                    printf("%-8s %-5s %5d %6d %9.0f %9.0f %9.0f %10.0f %12.0f %10.4f %9llu\n",
+                           bc.sink, apis[a], bc.producers, bc.size, r.p50_ns, r.p99_ns, r.p999_ns,
+                           r.max_ns, r.msgs_per_s, r.allocs_per_msg, r.blocked);
+                    if (csv) {
+                        fprintf(csv, "%s,%s,%d,%d,%ld,%zu,%.0f,%.0f,%.0f,%.0f,%.0f,%.4f,%llu,%llu\n",
+                                bc.sink, apis[a], bc.producers, bc.size, g_messages, g_thread_buffers,
+                                r.p50_ns, r.p99_ns, r.p999_ns, r.max_ns, r.msgs_per_s,
+                                r.allocs_per_msg, r.blocked, r.dropped);
+                    }
+                }
+            }
+        }
+        fflush(stdout);
+    }
+    if (csv) fclose(csv);
+    return failed;
+}
@@ -0,0 +1,632 @@
+#define _GNU_SOURCE // memmem
+#include <errno.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "common/hist.h"
+#include "common/protocol.h"
+
+/*
+ * Gerador de carga do servidor de chat, sem interação.
+ *
+ * Abre milhares de conexões do protocolo de quadros a partir de poucas
+ * threads (cada uma com seu epoll), espera todas entrarem e envia mensagens
+ * públicas e privadas (FRAME_PRIVATE, como o /msg do client) a uma taxa
+ * total fixa, distribuída entre as conexões. A carga é de laço aberto: cada
+ * mensagem leva o horário em que *deveria* ter sido enviada, então um
+ * servidor lento aparece na latência em vez de apenas reduzir a carga.
+ *
+ * Todas as cópias recebidas pelas conexões são conferidas e entram no
+ * histograma de latência de entrega (do horário agendado até a leitura).
+ * Só contam as mensagens agendadas na janela de medição, depois do
+ * aquecimento. O relatório repete a configuração e a semente; com --csv
+ * uma linha é acrescentada a um arquivo para comparar versões do servidor.
+ *
+ * Uso: ./chat_bench [--host IP] [--port N] [--conns N] [--threads N]
+ *          [--rate MSGS/S] [--private PCT] [--size BYTES] [--rooms N]
+ *          [--duration S] [--warmup S] [--drain S] [--seed N]
+ *          [--prefix NOME] [--csv ARQUIVO]
+ */
+
+#define MAX_SERVER_PAYLOAD (16u * 1024 * 1024)
+#define MAX_TEXT 1900 // Cabe no in_buf do servidor (BUFFER_SIZE) com o quadro
+#define MARKER "#B"   // Início da etiqueta: "#B" + execução (8 hex) + horário (16 hex)
+#define MARKER_LEN (2 + 8 + 16)
+#define NICK_MAX 32
+#define JOIN_TIMEOUT_S 30
+
+// Histograma log-linear da latência (32 faixas por potência de 2: erro
+// relativo de até ~3%), até 2^36 ns (~69 s); ver common/hist.h
+#define HIST_SUB_BITS 5
+#define HIST_MAX_EXP 36
+#define HIST_SLOTS HIST_BUCKETS(HIST_SUB_BITS, HIST_MAX_EXP)
+
+typedef struct {
+    unsigned long long count;
+    unsigned long long sum;
+    unsigned long long min;
+    unsigned long long max;
+    unsigned long long buckets[HIST_SLOTS];
+} Histogram;
+
+typedef struct {
+    int fd;
+    int index;   // Índice global; o nickname é prefixo + índice
+    int room;    // Sala (0 a rooms - 1)
+    int joined;  // FRAME_ROOM recebido
+    int closed;
+    int want_out; // EPOLLOUT ativo
+    char* in;
+    size_t in_len, in_cap;
+    char* out;   // O que o kernel ainda não aceitou
+    size_t out_len, out_cap;
+} BenchConn;
+
+typedef struct {
+    int id;
+    int epfd;
+    BenchConn* conns;
+    int count;
+    int pending_joins;
+    uint64_t rng;
+    Histogram hist;
+    // Lidos pela thread principal durante o escoamento final
+    atomic_ullong expected;  // Entregas esperadas das mensagens da janela
+    atomic_ullong delivered; // Entregas recebidas das mensagens da janela
+    unsigned long long sent_public, sent_private;
+    unsigned long long bytes_in;   // Bytes dos quadros da janela
+    unsigned long long lost_conns;   // Caíram depois de entrar
+    unsigned long long send_lag_max; // Maior atraso do gerador sobre a agenda (ns)
+    pthread_t thread;
+} BenchThread;
+
+// Configuração (definida por main antes das threads)
+static const char* g_host = "127.0.0.1";
+static int g_port = 8080;
+static int g_conns = 1000;
+static int g_threads = 4;
+static double g_rate = 1000;
+static double g_private = 10;
+static int g_size = 64;
+static int g_rooms = 1;
+static double g_duration = 10;
+static double g_warmup = 2;
+static double g_drain = 5;
+static unsigned long long g_seed = 1;
+static const char* g_prefix = "bench";
+static const char* g_csv = NULL;
+
+static struct sockaddr_in g_server;
+static unsigned g_run_tag;
+static int g_room_size[1024];
+
+// Fases: as threads conectam; quando todas estiverem prontas a última
+// define os horários e todas começam a enviar
+static atomic_int g_ready;
+static atomic_int g_failed;
+static atomic_int g_stop;
+static _Atomic uint64_t g_start_ns; // Início do aquecimento
+static uint64_t g_measure_ns;       // Início da janela de medição
+static uint64_t g_end_ns;           // Fim dos envios
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*: sequência reproduzível a partir de --seed
+static uint64_t rng_next(uint64_t* s) {
+    uint64_t x = *s;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *s = x;
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+// --- Histograma ---
+
+static void hist_record(Histogram* h, uint64_t v) {
+    if (h->count == 0 || v < h->min) h->min = v;
+    if (v > h->max) h->max = v;
+    h->count++;
+    h->sum += v;
+    h->buckets[hist_bucket_of(v, HIST_SUB_BITS, HIST_MAX_EXP)]++;
+}
+
+static void hist_merge(Histogram* into, const Histogram* h) {
+    if (h->count == 0) return;
+    if (into->count == 0 || h->min < into->min) into->min = h->min;
+    if (h->max > into->max) into->max = h->max;
+    into->count += h->count;
+    into->sum += h->sum;
+    for (unsigned i = 0; i < HIST_SLOTS; i++) into->buckets[i] += h->buckets[i];
+}
+
+static double hist_percentile_us(const Histogram* h, double q) {
+    return (double)hist_percentile(h->buckets, HIST_SUB_BITS, HIST_MAX_EXP, h->count, h->max, q) / 1e3;
+}
+
+// --- Conexões ---
+
+static void conn_watch(BenchThread* t, BenchConn* c, int want_out) {
+    if (c->want_out == want_out) return;
+    struct epoll_event ev = { .events = EPOLLIN | (want_out ? EPOLLOUT : 0), .data.ptr = c };
+    epoll_ctl(t->epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    c->want_out = want_out;
+}
+
+static void conn_close(BenchThread* t, BenchConn* c) {
+    if (c->closed) return;
+    c->closed = 1;
+    if (c->joined) {
+        t->lost_conns++;
+    } else {
+        t->pending_joins--;
+    }
+    epoll_ctl(t->epfd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+}
+
+// Envia sem bloquear; o que o kernel não aceitar espera o EPOLLOUT
+static void conn_write(BenchThread* t, BenchConn* c, const char* data, size_t len) {
+    if (c->closed) return;
+    if (c->out_len == 0) {
+        ssize_t n = send(c->fd, data, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            conn_close(t, c);
+            return;
+        }
+        if (n > 0) {
+            data += n;
+            len -= (size_t)n;
+        }
+        if (len == 0) return;
+    }
+    if (c->out_len + len > c->out_cap) {
+        size_t cap = c->out_cap ? c->out_cap : 4096;
+        while (cap < c->out_len + len) cap *= 2;
+        char* grown = (char*)realloc(c->out, cap);
+        if (!grown) {
+            conn_close(t, c);
+            return;
+        }
+        c->out = grown;
+        c->out_cap = cap;
+    }
+    memcpy(c->out + c->out_len, data, len);
+    c->out_len += len;
+    conn_watch(t, c, 1);
+}
+
+static void conn_flush(BenchThread* t, BenchConn* c) {
+    size_t off = 0;
+    while (off < c->out_len) {
+        ssize_t n = send(c->fd, c->out + off, c->out_len - off, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            conn_close(t, c);
+            return;
+        }
+        off += (size_t)n;
+    }
+    memmove(c->out, c->out + off, c->out_len - off);
+    c->out_len -= off;
+    if (c->out_len == 0) conn_watch(t, c, 0);
+}
+
+static void nick_of(int index, char* out) {
+    snprintf(out, NICK_MAX, "%s%d", g_prefix, index);
+}
+
+// Preâmbulo e JOIN em uma escrita, como connect_and_join() do client
+static void conn_open(BenchThread* t, BenchConn* c) {
+    c->fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (c->fd < 0 || connect(c->fd, (struct sockaddr*)&g_server, sizeof(g_server)) < 0) {
+        if (c->fd >= 0) close(c->fd);
+        c->closed = 1;
+        t->pending_joins--;
+        return;
+    }
+    // Sem Nagle: a latência medida deve ser a do servidor
+    int one = 1;
+    setsockopt(c->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    char join[FRAME_SEQ_SIZE + NICK_MAX + 1 + 16];
+    char nick[NICK_MAX];
+    nick_of(c->index, nick);
+    size_t join_len = FRAME_SEQ_SIZE;
+    frame_put_seq((unsigned char*)join, 0);
+    memcpy(join + join_len, nick, strlen(nick));
+    join_len += strlen(nick);
+    if (g_rooms > 1) {
+        join[join_len++] = '\0';
+        join_len += (size_t)snprintf(join + join_len, sizeof(join) - join_len, "bench-%d", c->room);
+    }
+    char hello[PROTO_PREAMBLE_SIZE + FRAME_HEADER_SIZE + sizeof(join)];
+    memcpy(hello, PROTO_PREAMBLE, PROTO_PREAMBLE_SIZE);
+    size_t hello_len = PROTO_PREAMBLE_SIZE + frame_encode(hello + PROTO_PREAMBLE_SIZE, FRAME_JOIN, join, join_len);
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+    if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, c->fd, &ev) < 0) {
+        close(c->fd);
+        c->closed = 1;
+        t->pending_joins--;
+        return;
+    }
+    conn_write(t, c, hello, hello_len);
+}
+
+// Confere um quadro recebido: entradas em sala e cópias das mensagens
+// desta execução (as de outros clientes e de execuções anteriores são
+// ignoradas)
+static void on_frame(BenchThread* t, BenchConn* c, FrameType type, const char* payload, size_t len, uint64_t now) {
+    if (type == FRAME_ROOM) {
+        if (!c->joined) {
+            c->joined = 1;
+            t->pending_joins--;
+        }
+        return;
+    }
+    if (type != FRAME_PUBLIC && type != FRAME_PRIVATE) return;
+
+    const char* mark = (const char*)memmem(payload, len, MARKER, 2);
+    if (!mark || (size_t)(payload + len - mark) < MARKER_LEN) return;
+    char hex[17];
+    memcpy(hex, mark + 2, 8);
+    hex[8] = '\0';
+    if ((unsigned)strtoul(hex, NULL, 16) != g_run_tag) return;
+    memcpy(hex, mark + 10, 16);
+    hex[16] = '\0';
+    uint64_t sent = strtoull(hex, NULL, 16);
+    if (sent < g_measure_ns || sent >= g_end_ns) return; // Aquecimento
+
+    hist_record(&t->hist, now > sent ? now - sent : 0);
+    t->bytes_in += FRAME_HEADER_SIZE + len;
+    atomic_fetch_add_explicit(&t->delivered, 1, memory_order_relaxed);
+}
+
+static void conn_read(BenchThread* t, BenchConn* c) {
+    for (;;) {
+        if (c->in_len == c->in_cap) {
+            size_t cap = c->in_cap ? c->in_cap * 2 : 4096;
+            char* grown = cap <= MAX_SERVER_PAYLOAD + FRAME_HEADER_SIZE ? (char*)realloc(c->in, cap) : NULL;
+            if (!grown) {
+                conn_close(t, c);
+                return;
+            }
+            c->in = grown;
+            c->in_cap = cap;
+        }
+        ssize_t n = recv(c->fd, c->in + c->in_len, c->in_cap - c->in_len, MSG_DONTWAIT);
+        if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            conn_close(t, c);
+            return;
+        }
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        c->in_len += (size_t)n;
+
+        uint64_t now = now_ns();
+        size_t start = 0;
+        for (;;) {
+            FrameType type;
+            const char* payload;
+            size_t len;
+            long used = frame_parse(c->in + start, c->in_len - start, MAX_SERVER_PAYLOAD, &type, &payload, &len);
+            if (used == 0) break;
+            if (used < 0 || len < FRAME_SEQ_SIZE) {
+                conn_close(t, c);
+                return;
+            }
+            start += (size_t)used;
+            on_frame(t, c, type, payload + FRAME_SEQ_SIZE, len - FRAME_SEQ_SIZE, now);
+        }
+        memmove(c->in, c->in + start, c->in_len - start);
+        c->in_len -= start;
+    }
+}
+
+// Trata os eventos prontos, esperando no máximo timeout_ms
+static void poll_events(BenchThread* t, int timeout_ms) {
+    struct epoll_event events[256];
+    int n = epoll_wait(t->epfd, events, 256, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        BenchConn* c = (BenchConn*)events[i].data.ptr;
+        if (c->closed) continue;
+        if (events[i].events & EPOLLOUT) conn_flush(t, c);
+        if (!c->closed && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))) conn_read(t, c);
+    }
+}
+
+// --- Envio ---
+
+// Uma mensagem agendada para scheduled: pública na sala do remetente ou,
+// com probabilidade --private, privada para outra conexão qualquer
+static void send_one(BenchThread* t, uint64_t scheduled) {
+    BenchConn* c = &t->conns[rng_next(&t->rng) % (uint64_t)t->count];
+    if (c->closed) return;
+    int private_msg = g_conns > 1 && (double)(rng_next(&t->rng) % 10000) < g_private * 100;
+
+    char text[MAX_TEXT + 1];
+    int n = snprintf(text, sizeof(text), MARKER "%08x%016llx", g_run_tag, (unsigned long long)scheduled);
+    // Preenchimento com pontos: o filtro de moderação não altera o tamanho
+    while (n < g_size) text[n++] = '.';
+
+    char frame[FRAME_HEADER_SIZE + NICK_MAX + 1 + MAX_TEXT];
+    size_t frame_len;
+    if (private_msg) {
+        int target = (int)(rng_next(&t->rng) % (uint64_t)(g_conns - 1));
+        if (target >= c->index) target++;
+        char payload[NICK_MAX + 1 + MAX_TEXT];
+        nick_of(target, payload);
+        size_t nick_len = strlen(payload);
+        payload[nick_len] = '\0';
+        memcpy(payload + nick_len + 1, text, (size_t)n);
+        frame_len = frame_encode(frame, FRAME_PRIVATE, payload, nick_len + 1 + (size_t)n);
+    } else {
+        frame_len = frame_encode(frame, FRAME_PUBLIC, text, (size_t)n);
+    }
+    conn_write(t, c, frame, frame_len);
+    if (c->closed || scheduled < g_measure_ns) return;
+
+    if (private_msg) {
+        t->sent_private++;
+        atomic_fetch_add_explicit(&t->expected, 1, memory_order_relaxed);
+    } else {
+        t->sent_public++;
+        atomic_fetch_add_explicit(&t->expected, (unsigned long long)(g_room_size[c->room] - 1), memory_order_relaxed);
+    }
+}
+
+static void* bench_thread(void* arg) {
+    BenchThread* t = (BenchThread*)arg;
+
+    // 1. Conecta e espera todas as conexões (de todas as threads) entrarem
+    for (int i = 0; i < t->count; i++) {
+        conn_open(t, &t->conns[i]);
+        if (i % 64 == 63) poll_events(t, 0);
+    }
+    uint64_t deadline = now_ns() + (uint64_t)JOIN_TIMEOUT_S * 1000000000u;
+    while (t->pending_joins > 0 && now_ns() < deadline) poll_events(t, 10);
+    int joined = 0;
+    for (int i = 0; i < t->count; i++) joined += t->conns[i].joined;
+    atomic_fetch_add(&g_failed, t->count - joined);
+    if (atomic_fetch_add(&g_ready, 1) + 1 == g_threads) {
+        uint64_t start = now_ns() + 50000000u; // Todas as threads começam juntas
+        g_measure_ns = start + (uint64_t)(g_warmup * 1e9);
+        g_end_ns = g_measure_ns + (uint64_t)(g_duration * 1e9);
+        atomic_store(&g_start_ns, start);
+    }
+    while (atomic_load(&g_start_ns) == 0) poll_events(t, 5);
+
+    // 2. Envia na agenda da thread: as threads se alternam no intervalo
+    // global, então a taxa total é --rate
+    double interval = 1e9 * g_threads / g_rate;
+    uint64_t start = atomic_load(&g_start_ns);
+    uint64_t next_count = 0;
+    for (;;) {
+        uint64_t scheduled = start + (uint64_t)(interval * ((double)next_count + (double)t->id / g_threads));
+        if (scheduled >= g_end_ns) break;
+        uint64_t now = now_ns();
+        if (now >= scheduled) {
+            if (now - scheduled > t->send_lag_max) t->send_lag_max = now - scheduled;
+            send_one(t, scheduled);
+            // Atrasado, o laço envia em sequência; as leituras não podem parar
+            if (++next_count % 64 == 0) poll_events(t, 0);
+            continue;
+        }
+        uint64_t wait_ms = (scheduled - now) / 1000000u;
+        poll_events(t, wait_ms > 0 ? (int)wait_ms : 0);
+    }
+
+    // 3. Escoa as entregas até a thread principal encerrar
+    while (!atomic_load(&g_stop)) poll_events(t, 10);
+    return NULL;
+}
+
+// --- Relatório ---
+
+static void print_usage(const char* prog) {
+    fprintf(stderr, "Uso: %s [--host IP] [--port N] [--conns N] [--threads N]\n"
+                    "          [--rate MSGS/S] [--private PCT] [--size BYTES] [--rooms N]\n"
+                    "          [--duration S] [--warmup S] [--drain S] [--seed N]\n"
+                    "          [--prefix NOME] [--csv ARQUIVO]\n", prog);
+}
+
+static void write_csv(const Histogram* h, unsigned long long sent_public, unsigned long long sent_private,
+                      unsigned long long expected, unsigned long long delivered, unsigned long long lost,
+                      double lag_us) {
+    struct stat st;
+    int fresh = stat(g_csv, &st) < 0 || st.st_size == 0;
+    FILE* f = fopen(g_csv, "a");
+    if (!f) {
+        fprintf(stderr, "Falha ao abrir %s: %s\n", g_csv, strerror(errno));
+        return;
+    }
+    if (fresh) {
+        fprintf(f, "conns,threads,rooms,rate,private_pct,size,duration_s,warmup_s,seed,"
+                   "sent_public,sent_private,expected,delivered,lost_conns,deliveries_per_s,"
+                   "mean_us,p50_us,p90_us,p99_us,p999_us,max_us,send_lag_max_us\n");
+    }
+    fprintf(f, "%d,%d,%d,%.0f,%.1f,%d,%.1f,%.1f,%llu,%llu,%llu,%llu,%llu,%llu,%.0f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+            g_conns, g_threads, g_rooms, g_rate, g_private, g_size, g_duration, g_warmup, g_seed,
+            sent_public, sent_private, expected, delivered, lost, (double)delivered / g_duration,
+            h->count ? (double)h->sum / (double)h->count / 1e3 : 0.0,
+            hist_percentile_us(h, 0.50), hist_percentile_us(h, 0.90), hist_percentile_us(h, 0.99),
+            hist_percentile_us(h, 0.999), (double)h->max / 1e3, lag_us);
+    fclose(f);
+}
+
+int main(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char* opt = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!value) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+        if (strcmp(opt, "--host") == 0) g_host = value;
+        else if (strcmp(opt, "--port") == 0) g_port = atoi(value);
+        else if (strcmp(opt, "--conns") == 0) g_conns = atoi(value);
+        else if (strcmp(opt, "--threads") == 0) g_threads = atoi(value);
+        else if (strcmp(opt, "--rate") == 0) g_rate = atof(value);
+        else if (strcmp(opt, "--private") == 0) g_private = atof(value);
+        else if (strcmp(opt, "--size") == 0) g_size = atoi(value);
+        else if (strcmp(opt, "--rooms") == 0) g_rooms = atoi(value);
+        else if (strcmp(opt, "--duration") == 0) g_duration = atof(value);
+        else if (strcmp(opt, "--warmup") == 0) g_warmup = atof(value);
+        else if (strcmp(opt, "--drain") == 0) g_drain = atof(value);
+        else if (strcmp(opt, "--seed") == 0) g_seed = strtoull(value, NULL, 10);
+        else if (strcmp(opt, "--prefix") == 0) g_prefix = value;
+        else if (strcmp(opt, "--csv") == 0) g_csv = value;
+        else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (g_port <= 0 || g_port > 65535 || g_conns < 1 || g_threads < 1 || g_rate <= 0 ||
+        g_private < 0 || g_private > 100 || g_size < MARKER_LEN || g_size > MAX_TEXT ||
+        g_rooms < 1 || g_rooms > 1024 || g_duration <= 0 || g_warmup < 0 || g_drain < 0 ||
+        strlen(g_prefix) > NICK_MAX - 12) {
+        fprintf(stderr, "Parâmetros inválidos (tamanho de %d a %d bytes, até 1024 salas).\n", MARKER_LEN, MAX_TEXT);
+        return 1;
+    }
+    if (g_threads > g_conns) g_threads = g_conns;
+    if (inet_pton(AF_INET, g_host, &g_server.sin_addr) != 1) {
+        fprintf(stderr, "Endereço inválido: %s\n", g_host);
+        return 1;
+    }
+    g_server.sin_family = AF_INET;
+    g_server.sin_port = htons((uint16_t)g_port);
+
+    // Um descritor por conexão
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    // A etiqueta distingue as mensagens desta execução; o resto da carga
+    // depende só da semente
+    g_run_tag = (unsigned)(now_ns() ^ ((uint64_t)getpid() << 16));
+
+    BenchThread* threads = (BenchThread*)calloc((size_t)g_threads, sizeof(BenchThread));
+    BenchConn* conns = (BenchConn*)calloc((size_t)g_conns, sizeof(BenchConn));
+    if (!threads || !conns) {
+        fprintf(stderr, "Memória insuficiente.\n");
+        return 1;
+    }
+    for (int i = 0; i < g_conns; i++) {
+        conns[i].index = i;
+        conns[i].room = i % g_rooms;
+        g_room_size[conns[i].room]++;
+    }
+
+    printf("chat_bench: %s:%d, %d conexões, %d threads, %d sala(s), %.0f msgs/s (%.1f%% privadas), "
+           "%d bytes, %.1f s (+%.1f s de aquecimento), semente %llu\n",
+           g_host, g_port, g_conns, g_threads, g_rooms, g_rate, g_private, g_size,
+           g_duration, g_warmup, g_seed);
+    fflush(stdout);
+
+    uint64_t connect_start = now_ns();
+    int per_thread = g_conns / g_threads, extra = g_conns % g_threads, first = 0;
+    for (int i = 0; i < g_threads; i++) {
+        BenchThread* t = &threads[i];
+        t->id = i;
+        t->conns = conns + first;
+        t->count = per_thread + (i < extra);
+        t->pending_joins = t->count;
+        t->rng = (g_seed + 1) * 0x9E3779B97F4A7C15ull + (uint64_t)i;
+        first += t->count;
+        t->epfd = epoll_create1(EPOLL_CLOEXEC);
+        if (t->epfd < 0 || pthread_create(&t->thread, NULL, bench_thread, t) != 0) {
+            fprintf(stderr, "Falha ao iniciar a thread %d.\n", i);
+            return 1;
+        }
+    }
+
+    while (atomic_load(&g_start_ns) == 0) usleep(10000);
+    double connect_s = (double)(atomic_load(&g_start_ns) - connect_start) / 1e9 - 0.05;
+    int failed = atomic_load(&g_failed);
+    printf("Entrada: %d de %d conexões em %.2f s\n", g_conns - failed, g_conns, connect_s);
+    fflush(stdout);
+
+    // Aguarda o fim dos envios e escoa até receber tudo ou esgotar --drain
+    while (now_ns() < g_end_ns) usleep(50000);
+    uint64_t drain_end = g_end_ns + (uint64_t)(g_drain * 1e9);
+    unsigned long long expected = 0, delivered = 0;
+    for (;;) {
+        expected = delivered = 0;
+        for (int i = 0; i < g_threads; i++) {
+            expected += atomic_load(&threads[i].expected);
+            delivered += atomic_load(&threads[i].delivered);
+        }
+        if (delivered >= expected || now_ns() >= drain_end) break;
+        usleep(20000);
+    }
+    atomic_store(&g_stop, 1);
+
+    Histogram* all = (Histogram*)calloc(1, sizeof(Histogram));
+    unsigned long long sent_public = 0, sent_private = 0, bytes_in = 0, lost = 0, lag = 0;
+    for (int i = 0; i < g_threads; i++) {
+        BenchThread* t = &threads[i];
+        pthread_join(t->thread, NULL);
+        hist_merge(all, &t->hist);
+        sent_public += t->sent_public;
+        sent_private += t->sent_private;
+        bytes_in += t->bytes_in;
+        lost += t->lost_conns;
+        if (t->send_lag_max > lag) lag = t->send_lag_max;
+    }
+    expected = delivered = 0;
+    for (int i = 0; i < g_threads; i++) {
+        expected += atomic_load(&threads[i].expected);
+        delivered += atomic_load(&threads[i].delivered);
+    }
+
+    printf("Enviadas: %llu públicas, %llu privadas (%.1f msgs/s)\n",
+           sent_public, sent_private, (double)(sent_public + sent_private) / g_duration);
+    printf("Entregas: %llu de %llu esperadas (%.2f%%), %.0f entregas/s, %.2f MB/s\n",
+           delivered, expected, expected ? 100.0 * (double)delivered / (double)expected : 100.0,
+           (double)delivered / g_duration, (double)bytes_in / g_duration / 1e6);
+    printf("Latência de entrega (µs): média %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, máx %.1f\n",
+           all->count ? (double)all->sum / (double)all->count / 1e3 : 0.0,
+           hist_percentile_us(all, 0.50), hist_percentile_us(all, 0.90), hist_percentile_us(all, 0.99),
+           hist_percentile_us(all, 0.999), (double)all->max / 1e3);
+    printf("Gerador: atraso máximo sobre a agenda %.1f µs; %llu conexões perdidas\n",
+           (double)lag / 1e3, lost);
+    if (lag > 10000000u) {
+        printf("Aviso: o gerador atrasou mais de 10 ms; use mais --threads ou uma taxa menor.\n");
+    }
+    if (g_csv) write_csv(all, sent_public, sent_private, expected, delivered, lost, (double)lag / 1e3);
+
+    for (int i = 0; i < g_conns; i++) {
+        if (!conns[i].closed) close(conns[i].fd);
+        free(conns[i].in);
+        free(conns[i].out);
+    }
+    for (int i = 0; i < g_threads; i++) close(threads[i].epfd);
+    free(all);
+    free(conns);
+    free(threads);
+    return failed > 0 ? 1 : 0;
+}